@@ -0,0 +1,9 @@
+#ifndef __SIM_UCRC_H
+#define __SIM_UCRC_H
+
+#include <stdint.h>
+
+/* 软件实现,和STM32的CRC单元默认配置(CRC-32/MPEG-2,按32位字喂数据)结果一样,仿真出来的镜像可以直接烧到板上. */
+uint32_t Calculate_CRC(uint8_t *pBuf,uint32_t BufferSize);
+
+#endif
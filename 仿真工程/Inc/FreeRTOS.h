@@ -0,0 +1,30 @@
+/**
+    描述: PC仿真用的FreeRTOS替身,只提供WL_Flash用到的部分.
+    文件: FreeRTOS.h
+    注意: 时间全部走虚拟时钟(Sim_Port.c),vTaskDelay只是把虚拟时钟往前拨.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#ifndef _SIM_FREERTOS_H_
+#define _SIM_FREERTOS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t TickType_t;
+
+#define configTICK_RATE_HZ  1000
+#define portTICK_PERIOD_MS  (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(x)    ((TickType_t)(((uint64_t)(x) * configTICK_RATE_HZ) / 1000))
+
+void *pvPortMalloc(size_t xSize);
+void vPortFree(void *pv);
+
+/* 虚拟时钟,单位ns,从0开始,只有仿真的Flash操作和vTaskDelay会让它走. */
+uint64_t Sim_Clock_Now(void);
+void Sim_Clock_Advance(uint64_t ns);
+void Sim_Clock_Reset(void);
+
+#endif
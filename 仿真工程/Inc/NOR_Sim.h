@@ -0,0 +1,100 @@
+/**
+    描述: PC上仿真的NOR Flash,默认参数是N25Q128A.
+    文件: NOR_Sim.h
+    注意: 写入只能把1变0,擦除把整块变回0xFF,写入超过Page末尾会绕回Page开头,和真芯片一样.
+          每个操作按N25Q128A_xxx的典型时间和QSPI总线周期推进虚拟时钟,结果是确定的.
+          内容可以放在内存(NOR_Sim_Init),也可以放在mmap的稀疏文件里(NOR_Sim_Open),
+          两种都是取反储存,全0就是擦干净,这样文件里没写过的地方是空洞,不占磁盘.
+          NOR_Sim_PowerCut可以让第N条编程/擦除指令只做一部分位就掉电,用来测掉电恢复.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#ifndef _NOR_SIM_H_
+#define _NOR_SIM_H_
+
+#include "N25Q128.h"
+#include "WL_Flash.h"
+
+#define NOR_SIM_SYSCLK_HZ 80000000 /* 板上QSPI的输入时钟,和测试工程一样是80MHz */
+
+#define NOR_SIM_FILE_MAGIC   0x4D49534E /* "NSIM" */
+#define NOR_SIM_FILE_VERSION 1
+#define NOR_SIM_FILE_HDR     128        /* 擦除次数文件的头部大小,后面紧跟每块的擦除次数 */
+
+/* 擦除次数文件(镜像文件名 + ".cnt")的头部,保存恢复运行需要的时钟和统计. */
+typedef struct NOR_Sim_File_s
+{
+    uint32_t magic; /* NOR_SIM_FILE_MAGIC */
+    uint32_t version; /* NOR_SIM_FILE_VERSION */
+    uint32_t flash_size; /* 容量 */
+    uint32_t block_size; /* 最小擦除块大小 */
+    uint64_t clock; /* 上次保存时的虚拟时钟 */
+    uint64_t read_bytes;
+    uint64_t prog_bytes;
+    uint64_t erase_bytes;
+    uint64_t busy_ns;
+    uint32_t read_cmds;
+    uint32_t prog_cmds;
+    uint32_t erase_cmds;
+    uint32_t errors;
+} nor_sim_file_t;
+
+typedef struct NOR_Sim_s
+{
+    BSP_QSPI_Info_TypeDef info; /* 仿真的芯片参数,默认N25Q128A,初始化之后可以改(擦除大小必须是2的幂) */
+    uint32_t clock_hz; /* QSPI总线时钟 */
+    uint32_t dtr_min; /* NOR_Sim_Read大于等于这个长度时按DTR算(N25Q128A_DTR_READ_MIN),0表示只用STR.打开时clock_hz也要改成DTR的 */
+
+    uint8_t *mem; /* 储存内容,取反储存(0x00表示擦除状态) */
+    uint32_t *erase_count; /* 每个最小擦除块(info.EraseSize[0])的擦除次数 */
+    uint32_t block_count; /* 最小擦除块数量 */
+
+    uint8_t status; /* QSPI_OK/QSPI_BUSY/QSPI_SUSPENDED */
+    uint64_t busy_until; /* 芯片内部操作在虚拟时钟的这个时刻完成 */
+    uint64_t suspend_left; /* 暂停时还剩下的操作时间 */
+    uint64_t dma_until; /* 后台读(DMA)在这个时刻传完,之前总线被占着 */
+
+    uint32_t read_cmds; /* 读指令次数 */
+    uint32_t prog_cmds; /* 编程指令次数(每个Page一次) */
+    uint32_t erase_cmds; /* 擦除指令次数(不含整片擦除) */
+    uint64_t read_bytes; /* 读出的字节数 */
+    uint64_t prog_bytes; /* 编程的字节数 */
+    uint64_t erase_bytes; /* 擦除的字节数 */
+    uint64_t busy_ns; /* 芯片内部忙(编程/擦除)的总时间 */
+    uint32_t errors; /* 越界,擦除地址不对齐之类的错误次数,正常应该一直是0 */
+
+    uint32_t write_cmds; /* 编程和擦除指令的总次数,掉电测试按这个数 */
+    uint32_t cut_at; /* 第几条编程/擦除指令做到一半掉电,0表示不掉电 */
+    uint32_t cut_seed; /* 掉电时哪些位已经改了,由这个种子决定 */
+    uint32_t cut_addr; /* 掉电时那条指令的地址 */
+    uint8_t cut_op; /* 掉电时那条指令,'P'编程,'E'擦除 */
+    uint8_t dead; /* 已经掉电,之后的编程和擦除都不执行,直到NOR_Sim_PowerOn */
+
+    int fd; /* 镜像文件,内存模式是-1 */
+    int cnt_fd; /* 擦除次数文件,内存模式是-1 */
+    nor_sim_file_t *file; /* 擦除次数文件的头部,内存模式是NULL */
+} nor_sim_t;
+
+uint8_t NOR_Sim_Init(nor_sim_t *Sim, uint32_t FlashSize);
+uint8_t NOR_Sim_Open(nor_sim_t *Sim, const char *Path, uint32_t FlashSize);
+void NOR_Sim_Sync(nor_sim_t *Sim);
+void NOR_Sim_DeInit(nor_sim_t *Sim);
+
+void NOR_Sim_Read(nor_sim_t *Sim, uint32_t ReadAddr, uint8_t *pData, uint32_t Size);
+void NOR_Sim_ReadStart(nor_sim_t *Sim, uint32_t ReadAddr, uint8_t *pData, uint32_t Size);
+uint8_t NOR_Sim_ReadDone(nor_sim_t *Sim, uint8_t Wait);
+void NOR_Sim_PageProgram(nor_sim_t *Sim, uint32_t WriteAddr, const uint8_t *pData, uint32_t Size);
+void NOR_Sim_Erase(nor_sim_t *Sim, uint32_t Address, uint32_t Size);
+void NOR_Sim_Erase_Chip_Start(nor_sim_t *Sim);
+uint8_t NOR_Sim_GetStatus(nor_sim_t *Sim);
+void NOR_Sim_Suspend(nor_sim_t *Sim);
+void NOR_Sim_Resume(nor_sim_t *Sim);
+void NOR_Sim_PowerCut(nor_sim_t *Sim, uint32_t After, uint32_t Seed);
+void NOR_Sim_PowerOn(nor_sim_t *Sim);
+
+/* WL_Flash驱动接口,drv填nor_sim_t指针. */
+extern const wl_flash_ops_t NOR_Sim_WL_Ops;
+
+#endif
@@ -0,0 +1,35 @@
+/**
+    描述: PC仿真用的QSPI.h替身,让N25Q128.h在PC上也能包含,拿到N25Q128A_xxx参数和指令.
+    文件: QSPI.h
+    注意: 只有线数/地址宽度的定义,数值和STM32的CCR寄存器一样,没有任何QSPI函数.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#ifndef __SIM_QSPI_H
+#define __SIM_QSPI_H
+
+#include <stdint.h>
+
+#define QSPI_ADDRESS_8_BITS            ((uint32_t)0x00000000)
+#define QSPI_ADDRESS_16_BITS           ((uint32_t)0x00001000)
+#define QSPI_ADDRESS_24_BITS           ((uint32_t)0x00002000)
+#define QSPI_ADDRESS_32_BITS           ((uint32_t)0x00003000)
+
+#define QSPI_INSTRUCTION_NONE          ((uint32_t)0x00000000)
+#define QSPI_INSTRUCTION_1_LINE        ((uint32_t)0x00000100)
+#define QSPI_INSTRUCTION_2_LINES       ((uint32_t)0x00000200)
+#define QSPI_INSTRUCTION_4_LINES       ((uint32_t)0x00000300)
+
+#define QSPI_ADDRESS_NONE              ((uint32_t)0x00000000)
+#define QSPI_ADDRESS_1_LINE            ((uint32_t)0x00000400)
+#define QSPI_ADDRESS_2_LINES           ((uint32_t)0x00000800)
+#define QSPI_ADDRESS_4_LINES           ((uint32_t)0x00000C00)
+
+#define QSPI_DATA_NONE                 ((uint32_t)0x00000000)
+#define QSPI_DATA_1_LINE               ((uint32_t)0x01000000)
+#define QSPI_DATA_2_LINES              ((uint32_t)0x02000000)
+#define QSPI_DATA_4_LINES              ((uint32_t)0x03000000)
+
+#endif
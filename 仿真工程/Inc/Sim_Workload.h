@@ -0,0 +1,27 @@
+/**
+    描述: 仿真用的写入负载,磨损仿真和参数扫描共用.
+    文件: Sim_Workload.h
+    注意: 随机数状态由调用者保存,同一个种子每次生成的序列都一样,多线程也互不影响.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#ifndef _SIM_WORKLOAD_H_
+#define _SIM_WORKLOAD_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+    const char *name;
+    uint32_t (*next)(uint32_t *seed, uint32_t op, uint32_t sectors); /* 返回第op次操作要改写的逻辑扇区 */
+} sim_workload_t;
+
+extern const sim_workload_t Sim_Workloads[];
+extern const uint32_t Sim_Workload_Count;
+
+uint32_t Sim_Rand(uint32_t *seed);
+const sim_workload_t *Sim_Workload_Find(const char *name);
+
+#endif
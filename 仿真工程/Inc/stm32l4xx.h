@@ -0,0 +1,36 @@
+/**
+    描述: PC仿真用的stm32l4xx.h替身,只有WL_Trace.c和WL_Prof.c用到的DWT周期计数器.
+    文件: stm32l4xx.h
+    注意: CYCCNT是从虚拟时钟换算的,和板上一样32位回绕.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#ifndef _SIM_STM32L4XX_H_
+#define _SIM_STM32L4XX_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t CTRL;
+    uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+    uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk     (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+#define DWT       (Sim_DWT())
+#define CoreDebug (&Sim_CoreDebug)
+
+extern uint32_t SystemCoreClock;
+extern CoreDebug_Type Sim_CoreDebug;
+DWT_Type *Sim_DWT(void);
+
+#endif
@@ -0,0 +1,23 @@
+/**
+    描述: PC仿真用的FreeRTOS替身,只提供WL_Flash用到的部分.
+    文件: task.h
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#ifndef _SIM_TASK_H_
+#define _SIM_TASK_H_
+
+#include "FreeRTOS.h"
+
+void vTaskDelay(const TickType_t xTicksToDelay);
+TickType_t xTaskGetTickCount(void);
+
+/* 没有调度器,临界区和暂停调度都不用做什么. */
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+#define vTaskSuspendAll()
+#define xTaskResumeAll() ((void)0)
+
+#endif
@@ -0,0 +1,7 @@
+/* PC仿真用的FreeRTOS替身,WL_Flash.h会包含这个文件,但是没有用到里面的东西. */
+#ifndef _SIM_TIMERS_H_
+#define _SIM_TIMERS_H_
+
+#include "FreeRTOS.h"
+
+#endif
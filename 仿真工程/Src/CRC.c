@@ -0,0 +1,47 @@
+#include "CRC.h"
+
+/**
+  * @brief  往CRC里喂bits位数据,高位先进,和CRC单元的FeedData一样.
+  * @param  crc: 当前CRC.
+  * @param  data: 数据,右对齐.
+  * @param  bits: 8,16或者32.
+  * @retval 新的CRC
+  */
+static uint32_t CRC_Feed(uint32_t crc, uint32_t data, uint32_t bits)
+{
+    crc ^= data << (32 - bits);
+    for (uint32_t i = 0; i < bits; i++)
+    {
+        crc = (crc & 0x80000000) ? ((crc << 1) ^ 0x04C11DB7) : (crc << 1);
+    }
+    return crc;
+}
+
+uint32_t Calculate_CRC(uint8_t *pBuf,uint32_t BufferSize)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    uint32_t index = 0;
+
+    /* 和板上的Calculate_CRC一样,先按小端拼成32位字再喂. */
+    for (index = 0; index < (BufferSize / 4); index++)
+    {
+        crc = CRC_Feed(crc, (uint32_t)((pBuf[4 * index + 3] << 24) | (pBuf[4 * index + 2] << 16) | (pBuf[4 * index + 1] << 8) | pBuf[4 * index]), 32);
+    }
+
+    /* Last bytes specific handling */
+    if (BufferSize % 4 == 1)
+    {
+        crc = CRC_Feed(crc, pBuf[4 * index], 8);
+    }
+    if (BufferSize % 4 == 2)
+    {
+        crc = CRC_Feed(crc, (uint16_t)((pBuf[4 * index + 1] << 8) | pBuf[4 * index]), 16);
+    }
+    if (BufferSize % 4 == 3)
+    {
+        crc = CRC_Feed(crc, (uint16_t)((pBuf[4 * index + 1] << 8) | pBuf[4 * index]), 16);
+        crc = CRC_Feed(crc, pBuf[4 * index + 2], 8);
+    }
+
+    return crc;
+}
@@ -0,0 +1,771 @@
+/**
+    描述: PC上仿真的NOR Flash,默认参数是N25Q128A.
+    文件: NOR_Sim.c
+    注意: 时间模型 = QSPI总线周期(指令+地址+dummy+数据) + 芯片内部编程/擦除的典型时间.
+          芯片忙的时候再发指令,就当做驱动先轮询等到空闲,虚拟时钟直接拨到忙结束.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "NOR_Sim.h"
+
+/* 定义WL_FLASH_PROF时和板上驱动一样统计等忙的时间,见WL_Prof.h. */
+#ifdef WL_FLASH_PROF
+#include "WL_Prof.h"
+#else
+#define WL_PROF_BEGIN(t)
+#define WL_PROF_END(phase, t)
+#endif
+
+static uint32_t NOR_Sim_Lines(uint32_t Mode);
+static uint64_t NOR_Sim_BusTime(nor_sim_t *Sim, uint32_t AddressMode, uint32_t DummyCycles, uint32_t DataMode, uint32_t Size, uint8_t Ddr);
+static void NOR_Sim_Bus(nor_sim_t *Sim, uint32_t AddressMode, uint32_t DummyCycles, uint32_t DataMode, uint32_t Size, uint8_t Ddr);
+static void NOR_Sim_WaitReady(nor_sim_t *Sim);
+static void NOR_Sim_Busy(nor_sim_t *Sim, uint64_t ns);
+static uint8_t NOR_Sim_Check(nor_sim_t *Sim, const char *Op, uint32_t Address, uint32_t Size);
+static void NOR_Sim_Clear(nor_sim_t *Sim, uint32_t Address, uint32_t Size);
+static uint8_t NOR_Sim_Cut(nor_sim_t *Sim, uint8_t Op, uint32_t Address);
+static uint8_t NOR_Sim_CutBits(nor_sim_t *Sim);
+
+/**
+  * @brief  默认参数,和N25Q128.c里的默认参数一样.
+  * @param  Sim: 仿真Flash.
+  * @param  FlashSize: 容量,必须是最小擦除块的整数倍,超过16MB自动按4字节地址.
+  */
+static void NOR_Sim_Defaults(nor_sim_t *Sim, uint32_t FlashSize)
+{
+    memset(Sim, 0, sizeof(nor_sim_t));
+
+    Sim->info.FlashSize = FlashSize;
+    Sim->info.PageSize = N25Q128A_PAGE_SIZE;
+    Sim->info.AddressBytes = (FlashSize > N25Q128A_FLASH_SIZE) ? 4 : 3;
+    Sim->info.ReadCmd = QUAD_INOUT_FAST_READ_CMD;
+    Sim->info.ReadDummyCycles = N25Q128A_DUMMY_CYCLES_READ_QUAD;
+    Sim->info.ReadAddressMode = QSPI_ADDRESS_4_LINES;
+    Sim->info.ReadDataMode = QSPI_DATA_4_LINES;
+    Sim->info.ProgCmd = EXT_QUAD_IN_FAST_PROG_CMD;
+    Sim->info.ProgAddressMode = QSPI_ADDRESS_4_LINES;
+    Sim->info.ProgDataMode = QSPI_DATA_4_LINES;
+    Sim->info.EraseCmd[0] = SUBSECTOR_ERASE_CMD;
+    Sim->info.EraseCmd[1] = SECTOR_ERASE_CMD;
+    Sim->info.EraseSize[0] = N25Q128A_SUBSECTOR_SIZE;
+    Sim->info.EraseSize[1] = N25Q128A_SECTOR_SIZE;
+    Sim->clock_hz = NOR_SIM_SYSCLK_HZ / (N25Q128A_CLOCK_PRESCALER + 1);
+
+    Sim->block_count = FlashSize / Sim->info.EraseSize[0];
+    Sim->fd = -1;
+    Sim->cnt_fd = -1;
+    Sim->status = QSPI_OK;
+}
+
+/**
+  * @brief  初始化内存里的仿真Flash,内容全部是0xFF.
+  * @param  Sim: 仿真Flash.
+  * @param  FlashSize: 容量,必须是最小擦除块的整数倍,超过16MB自动按4字节地址.
+  * @retval QSPI_OK或者QSPI_ERROR(内存不够).
+  */
+uint8_t NOR_Sim_Init(nor_sim_t *Sim, uint32_t FlashSize)
+{
+    NOR_Sim_Defaults(Sim, FlashSize);
+
+    /* 取反储存,calloc出来就是擦干净的,出厂状态不算擦除次数. */
+    Sim->mem = (uint8_t *)calloc(FlashSize, 1);
+    Sim->erase_count = (uint32_t *)calloc(Sim->block_count, sizeof(uint32_t));
+    if ((Sim->mem == NULL) || (Sim->erase_count == NULL))
+    {
+        NOR_Sim_DeInit(Sim);
+        return QSPI_ERROR;
+    }
+    return QSPI_OK;
+}
+
+/**
+  * @brief  打开(没有就新建)文件里的仿真Flash,可以停下来以后接着跑.
+  * @param  Sim: 仿真Flash.
+  * @param  Path: 镜像文件,擦除次数和统计放在Path + ".cnt".
+  * @param  FlashSize: 容量,接着跑的时候必须和文件里的一样.
+  * @retval QSPI_OK或者QSPI_ERROR.
+  * @note   两个文件都是mmap,新建只是ftruncate出稀疏文件,打开旧文件也不读内容,和容量无关.
+  *         镜像是取反储存的,用xxd之类的工具看的时候每个字节要异或0xFF.
+  */
+uint8_t NOR_Sim_Open(nor_sim_t *Sim, const char *Path, uint32_t FlashSize)
+{
+    char cnt_path[1024];
+    size_t cnt_size;
+    struct stat st;
+    uint8_t fresh;
+
+    NOR_Sim_Defaults(Sim, FlashSize);
+    cnt_size = NOR_SIM_FILE_HDR + (size_t)Sim->block_count * sizeof(uint32_t);
+    snprintf(cnt_path, sizeof(cnt_path), "%s.cnt", Path);
+
+    Sim->fd = open(Path, O_RDWR | O_CREAT, 0644);
+    Sim->cnt_fd = open(cnt_path, O_RDWR | O_CREAT, 0644);
+    if ((Sim->fd < 0) || (Sim->cnt_fd < 0) || (fstat(Sim->cnt_fd, &st) != 0))
+    {
+        NOR_Sim_DeInit(Sim);
+        return QSPI_ERROR;
+    }
+    /* 擦除次数文件是空的就是新建,否则头部必须对得上. */
+    fresh = (st.st_size == 0);
+    if ((fresh == 0) && ((size_t)st.st_size != cnt_size))
+    {
+        fprintf(stderr, "NOR_Sim: %s does not match flash size 0x%X\n", cnt_path, (unsigned int)FlashSize);
+        NOR_Sim_DeInit(Sim);
+        return QSPI_ERROR;
+    }
+    if ((ftruncate(Sim->fd, FlashSize) != 0) || (ftruncate(Sim->cnt_fd, cnt_size) != 0))
+    {
+        NOR_Sim_DeInit(Sim);
+        return QSPI_ERROR;
+    }
+
+    Sim->mem = (uint8_t *)mmap(NULL, FlashSize, PROT_READ | PROT_WRITE, MAP_SHARED, Sim->fd, 0);
+    Sim->file = (nor_sim_file_t *)mmap(NULL, cnt_size, PROT_READ | PROT_WRITE, MAP_SHARED, Sim->cnt_fd, 0);
+    if ((Sim->mem == MAP_FAILED) || (Sim->file == MAP_FAILED))
+    {
+        Sim->mem = (Sim->mem == MAP_FAILED) ? NULL : Sim->mem;
+        Sim->file = (Sim->file == MAP_FAILED) ? NULL : Sim->file;
+        NOR_Sim_DeInit(Sim);
+        return QSPI_ERROR;
+    }
+    Sim->erase_count = (uint32_t *)((uint8_t *)Sim->file + NOR_SIM_FILE_HDR);
+
+    if (fresh)
+    {
+        Sim->file->magic = NOR_SIM_FILE_MAGIC;
+        Sim->file->version = NOR_SIM_FILE_VERSION;
+        Sim->file->flash_size = FlashSize;
+        Sim->file->block_size = Sim->info.EraseSize[0];
+    }
+    else if ((Sim->file->magic != NOR_SIM_FILE_MAGIC) || (Sim->file->version != NOR_SIM_FILE_VERSION) ||
+             (Sim->file->flash_size != FlashSize) || (Sim->file->block_size != Sim->info.EraseSize[0]))
+    {
+        fprintf(stderr, "NOR_Sim: %s header mismatch\n", cnt_path);
+        NOR_Sim_DeInit(Sim);
+        return QSPI_ERROR;
+    }
+    else
+    {
+        /* 接着上次的统计和时钟跑. */
+        Sim->read_bytes = Sim->file->read_bytes;
+        Sim->prog_bytes = Sim->file->prog_bytes;
+        Sim->erase_bytes = Sim->file->erase_bytes;
+        Sim->busy_ns = Sim->file->busy_ns;
+        Sim->read_cmds = Sim->file->read_cmds;
+        Sim->prog_cmds = Sim->file->prog_cmds;
+        Sim->erase_cmds = Sim->file->erase_cmds;
+        Sim->errors = Sim->file->errors;
+        if (Sim->file->clock > Sim_Clock_Now())
+        {
+            Sim_Clock_Advance(Sim->file->clock - Sim_Clock_Now());
+        }
+    }
+    return QSPI_OK;
+}
+
+/**
+  * @brief  把统计和时钟写到擦除次数文件的头部,内存模式什么也不做.
+  * @param  Sim: 仿真Flash.
+  * @note   镜像内容和擦除次数本来就在mmap里,进程被杀掉也不会丢,只有头部要靠这个函数.
+  */
+void NOR_Sim_Sync(nor_sim_t *Sim)
+{
+    if (Sim->file == NULL)
+    {
+        return;
+    }
+    Sim->file->clock = Sim_Clock_Now();
+    Sim->file->read_bytes = Sim->read_bytes;
+    Sim->file->prog_bytes = Sim->prog_bytes;
+    Sim->file->erase_bytes = Sim->erase_bytes;
+    Sim->file->busy_ns = Sim->busy_ns;
+    Sim->file->read_cmds = Sim->read_cmds;
+    Sim->file->prog_cmds = Sim->prog_cmds;
+    Sim->file->erase_cmds = Sim->erase_cmds;
+    Sim->file->errors = Sim->errors;
+}
+
+/**
+  * @brief  释放仿真Flash,文件模式会先NOR_Sim_Sync.
+  * @param  Sim: 仿真Flash.
+  */
+void NOR_Sim_DeInit(nor_sim_t *Sim)
+{
+    if ((Sim->fd < 0) && (Sim->cnt_fd < 0))
+    {
+        free(Sim->mem);
+        free(Sim->erase_count);
+    }
+    else
+    {
+        NOR_Sim_Sync(Sim);
+        if (Sim->mem != NULL)
+        {
+            munmap(Sim->mem, Sim->info.FlashSize);
+        }
+        if (Sim->file != NULL)
+        {
+            munmap(Sim->file, NOR_SIM_FILE_HDR + (size_t)Sim->block_count * sizeof(uint32_t));
+        }
+        if (Sim->fd >= 0)
+        {
+            close(Sim->fd);
+        }
+        if (Sim->cnt_fd >= 0)
+        {
+            close(Sim->cnt_fd);
+        }
+    }
+    Sim->mem = NULL;
+    Sim->erase_count = NULL;
+    Sim->file = NULL;
+    Sim->fd = -1;
+    Sim->cnt_fd = -1;
+}
+
+/**
+  * @brief  读数据,用info里的读模式算总线时间.
+  * @param  Sim: 仿真Flash.
+  * @param  ReadAddr: 地址.
+  * @param  pData: 读出的数据.
+  * @param  Size: 长度.
+  */
+void NOR_Sim_Read(nor_sim_t *Sim, uint32_t ReadAddr, uint8_t *pData, uint32_t Size)
+{
+    NOR_Sim_WaitReady(Sim);
+    /* 和N25Q128_WL_Read一样,大块读走DTR(mode周期也当dummy发). */
+    NOR_Sim_Bus(Sim, Sim->info.ReadAddressMode, Sim->info.ReadDummyCycles + Sim->info.ReadModeCycles, Sim->info.ReadDataMode, Size,
+                (Sim->dtr_min != 0) && (Size >= Sim->dtr_min));
+    Sim->read_cmds++;
+    if (NOR_Sim_Check(Sim, "read", ReadAddr, Size) != QSPI_OK)
+    {
+        memset(pData, 0xFF, Size);
+        return;
+    }
+    for (uint32_t i = 0; i < Size; i++)
+    {
+        pData[i] = (uint8_t)~Sim->mem[ReadAddr + i];
+    }
+    Sim->read_bytes += Size;
+}
+
+/**
+  * @brief  后台读,相当于QSPI加DMA:数据马上给出,但是总线要到传完才空闲,CPU不用等.
+  * @param  Sim: 仿真Flash.
+  * @param  ReadAddr: 地址.
+  * @param  pData: 读出的数据.
+  * @param  Size: 长度.
+  * @note   传完之前不会有人改Flash(其他指令都要等总线),所以现在拷贝和传完再拷贝一样.
+  */
+void NOR_Sim_ReadStart(nor_sim_t *Sim, uint32_t ReadAddr, uint8_t *pData, uint32_t Size)
+{
+    NOR_Sim_WaitReady(Sim);
+    if (Sim_Clock_Now() < Sim->dma_until)
+    {
+        Sim_Clock_Advance(Sim->dma_until - Sim_Clock_Now());
+    }
+    Sim->dma_until = Sim_Clock_Now() + NOR_Sim_BusTime(Sim, Sim->info.ReadAddressMode, Sim->info.ReadDummyCycles + Sim->info.ReadModeCycles, Sim->info.ReadDataMode, Size, 0);
+    Sim->read_cmds++;
+    if (NOR_Sim_Check(Sim, "read", ReadAddr, Size) != QSPI_OK)
+    {
+        memset(pData, 0xFF, Size);
+        return;
+    }
+    for (uint32_t i = 0; i < Size; i++)
+    {
+        pData[i] = (uint8_t)~Sim->mem[ReadAddr + i];
+    }
+    Sim->read_bytes += Size;
+}
+
+/**
+  * @brief  后台读传完没有.
+  * @param  Sim: 仿真Flash.
+  * @param  Wait: 不为0时等到传完.
+  * @retval QSPI_OK: 传完了, QSPI_BUSY: 还没有.
+  */
+uint8_t NOR_Sim_ReadDone(nor_sim_t *Sim, uint8_t Wait)
+{
+    if (Sim_Clock_Now() >= Sim->dma_until)
+    {
+        return QSPI_OK;
+    }
+    if (!Wait)
+    {
+        return QSPI_BUSY;
+    }
+    Sim_Clock_Advance(Sim->dma_until - Sim_Clock_Now());
+    return QSPI_OK;
+}
+
+/**
+  * @brief  Page编程,只能把1写成0.超过Page末尾的部分绕回Page开头,和真芯片一样.
+  * @param  Sim: 仿真Flash.
+  * @param  WriteAddr: 地址.
+  * @param  pData: 数据.
+  * @param  Size: 长度,不能超过一个Page.
+  */
+void NOR_Sim_PageProgram(nor_sim_t *Sim, uint32_t WriteAddr, const uint8_t *pData, uint32_t Size)
+{
+    uint32_t page_start = WriteAddr & ~(Sim->info.PageSize - 1);
+    uint32_t offset = WriteAddr - page_start;
+
+    NOR_Sim_WaitReady(Sim);
+    /* Write Enable + 编程指令. */
+    NOR_Sim_Bus(Sim, QSPI_ADDRESS_NONE, 0, QSPI_DATA_NONE, 0, 0);
+    NOR_Sim_Bus(Sim, Sim->info.ProgAddressMode, 0, Sim->info.ProgDataMode, Size, 0);
+    Sim->prog_cmds++;
+    if (Size > Sim->info.PageSize)
+    {
+        fprintf(stderr, "NOR_Sim: program 0x%08X size 0x%X over one page\n", (unsigned int)WriteAddr, (unsigned int)Size);
+        Sim->errors++;
+        return;
+    }
+    if (NOR_Sim_Check(Sim, "program", page_start, Sim->info.PageSize) != QSPI_OK)
+    {
+        return;
+    }
+    switch (NOR_Sim_Cut(Sim, 'P', WriteAddr))
+    {
+    case 1:
+        /* 编程到一半掉电,要写0的位只有一部分写上了. */
+        for (uint32_t i = 0; i < Size; i++)
+        {
+            Sim->mem[page_start + ((offset + i) & (Sim->info.PageSize - 1))] |= (uint8_t)~pData[i] & NOR_Sim_CutBits(Sim);
+        }
+        return;
+    case 2:
+        return;
+    default:
+        break;
+    }
+    for (uint32_t i = 0; i < Size; i++)
+    {
+        /* 取反储存,写0就是置1. */
+        Sim->mem[page_start + ((offset + i) & (Sim->info.PageSize - 1))] |= (uint8_t)~pData[i];
+    }
+    Sim->prog_bytes += Size;
+    /* 编程时间按字节数线性估算,整Page就是典型值. */
+    NOR_Sim_Busy(Sim, (uint64_t)N25Q128A_PAGE_PROG_TYP_TIME_US * 1000 * Size / Sim->info.PageSize);
+}
+
+/**
+  * @brief  擦除一块,大小必须是info里的擦除大小之一,地址要对齐.
+  * @param  Sim: 仿真Flash.
+  * @param  Address: 地址.
+  * @param  Size: 擦除大小.
+  */
+void NOR_Sim_Erase(nor_sim_t *Sim, uint32_t Address, uint32_t Size)
+{
+    uint8_t found = 0;
+
+    NOR_Sim_WaitReady(Sim);
+    NOR_Sim_Bus(Sim, QSPI_ADDRESS_NONE, 0, QSPI_DATA_NONE, 0, 0);
+    NOR_Sim_Bus(Sim, QSPI_ADDRESS_1_LINE, 0, QSPI_DATA_NONE, 0, 0);
+    Sim->erase_cmds++;
+    for (uint32_t i = 0; i < BSP_QSPI_ERASE_TYPES; i++)
+    {
+        if ((Sim->info.EraseSize[i] != 0) && (Sim->info.EraseSize[i] == Size))
+        {
+            found = 1;
+        }
+    }
+    if ((found == 0) || ((Address % Size) != 0))
+    {
+        fprintf(stderr, "NOR_Sim: bad erase 0x%08X size 0x%X\n", (unsigned int)Address, (unsigned int)Size);
+        Sim->errors++;
+        return;
+    }
+    if (NOR_Sim_Check(Sim, "erase", Address, Size) != QSPI_OK)
+    {
+        return;
+    }
+    switch (NOR_Sim_Cut(Sim, 'E', Address))
+    {
+    case 1:
+        /* 擦除到一半掉电,只有一部分位变回1,整块内容都不可靠了. */
+        for (uint32_t i = 0; i < Size; i++)
+        {
+            Sim->mem[Address + i] &= NOR_Sim_CutBits(Sim);
+        }
+        return;
+    case 2:
+        return;
+    default:
+        break;
+    }
+    NOR_Sim_Clear(Sim, Address, Size);
+    for (uint32_t i = 0; i < Size / Sim->info.EraseSize[0]; i++)
+    {
+        Sim->erase_count[Address / Sim->info.EraseSize[0] + i]++;
+    }
+    Sim->erase_bytes += Size;
+    /* 最小的按SubSector时间,更大的都按Sector时间. */
+    NOR_Sim_Busy(Sim, (uint64_t)((Size <= Sim->info.EraseSize[0]) ? N25Q128A_SUBSECTOR_ERASE_TYP_TIME : N25Q128A_SECTOR_ERASE_TYP_TIME) * 1000000);
+}
+
+/**
+  * @brief  开始整片擦除,不等待,和BSP_QSPI_Erase_Chip_Start一样要自己查状态.
+  * @param  Sim: 仿真Flash.
+  * @note   内容立刻变成0xFF,时间按容量从N25Q128A的典型时间折算.
+  */
+void NOR_Sim_Erase_Chip_Start(nor_sim_t *Sim)
+{
+    NOR_Sim_WaitReady(Sim);
+    NOR_Sim_Bus(Sim, QSPI_ADDRESS_NONE, 0, QSPI_DATA_NONE, 0, 0);
+    NOR_Sim_Bus(Sim, QSPI_ADDRESS_NONE, 0, QSPI_DATA_NONE, 0, 0);
+    if (Sim->dead)
+    {
+        return;
+    }
+    NOR_Sim_Clear(Sim, 0, Sim->info.FlashSize);
+    for (uint32_t i = 0; i < Sim->block_count; i++)
+    {
+        Sim->erase_count[i]++;
+    }
+    Sim->erase_bytes += Sim->info.FlashSize;
+    Sim->busy_until = Sim_Clock_Now() + (uint64_t)N25Q128A_BULK_ERASE_TYP_TIME * 1000000 / N25Q128A_FLASH_SIZE * Sim->info.FlashSize;
+    Sim->busy_ns += Sim->busy_until - Sim_Clock_Now();
+    Sim->status = QSPI_BUSY;
+}
+
+/**
+  * @brief  读状态,相当于读Flag Status Register.
+  * @param  Sim: 仿真Flash.
+  * @retval QSPI_OK, QSPI_BUSY或者QSPI_SUSPENDED.
+  */
+uint8_t NOR_Sim_GetStatus(nor_sim_t *Sim)
+{
+    NOR_Sim_Bus(Sim, QSPI_ADDRESS_NONE, 0, QSPI_DATA_1_LINE, 1, 0);
+    if ((Sim->status == QSPI_BUSY) && (Sim_Clock_Now() >= Sim->busy_until))
+    {
+        Sim->status = QSPI_OK;
+    }
+    return Sim->status;
+}
+
+/**
+  * @brief  暂停正在进行的擦除,记下剩余时间.
+  * @param  Sim: 仿真Flash.
+  */
+void NOR_Sim_Suspend(nor_sim_t *Sim)
+{
+    NOR_Sim_Bus(Sim, QSPI_ADDRESS_NONE, 0, QSPI_DATA_NONE, 0, 0);
+    if (NOR_Sim_GetStatus(Sim) == QSPI_BUSY)
+    {
+        Sim->suspend_left = Sim->busy_until - Sim_Clock_Now();
+        Sim->status = QSPI_SUSPENDED;
+    }
+}
+
+/**
+  * @brief  恢复暂停的擦除.
+  * @param  Sim: 仿真Flash.
+  */
+void NOR_Sim_Resume(nor_sim_t *Sim)
+{
+    NOR_Sim_Bus(Sim, QSPI_ADDRESS_NONE, 0, QSPI_DATA_NONE, 0, 0);
+    if (Sim->status == QSPI_SUSPENDED)
+    {
+        Sim->busy_until = Sim_Clock_Now() + Sim->suspend_left;
+        Sim->status = QSPI_BUSY;
+    }
+}
+
+/**
+  * @brief  设置掉电测试,从现在起第After条编程/擦除指令做到一半掉电.
+  * @param  Sim: 仿真Flash.
+  * @param  After: 第几条,1就是下一条.
+  * @param  Seed: 决定掉电时哪些位已经改了,同样的种子结果一样.
+  * @note   掉电之后编程和擦除都不执行(读还是正常的),相当于CPU还在跑但是Flash已经没电了.
+  */
+void NOR_Sim_PowerCut(nor_sim_t *Sim, uint32_t After, uint32_t Seed)
+{
+    Sim->cut_at = Sim->write_cmds + After;
+    Sim->cut_seed = (Seed != 0) ? Seed : 1;
+    Sim->dead = 0;
+}
+
+/**
+  * @brief  重新上电,芯片空闲,掉电测试取消.
+  * @param  Sim: 仿真Flash.
+  */
+void NOR_Sim_PowerOn(nor_sim_t *Sim)
+{
+    Sim->cut_at = 0;
+    Sim->dead = 0;
+    Sim->status = QSPI_OK;
+    Sim->busy_until = Sim_Clock_Now();
+    Sim->dma_until = Sim_Clock_Now();
+}
+
+/**
+  * @brief  数据线数.
+  * @param  Mode: QSPI_ADDRESS_x_LINE(S)或者QSPI_DATA_x_LINE(S).
+  * @retval 线数,NONE是0.
+  */
+static uint32_t NOR_Sim_Lines(uint32_t Mode)
+{
+    switch (Mode)
+    {
+    case QSPI_ADDRESS_1_LINE:
+    case QSPI_DATA_1_LINE:
+        return 1;
+    case QSPI_ADDRESS_2_LINES:
+    case QSPI_DATA_2_LINES:
+        return 2;
+    case QSPI_ADDRESS_4_LINES:
+    case QSPI_DATA_4_LINES:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+/**
+  * @brief  一条指令的总线时间(ns):单线指令 + 地址 + dummy + 数据.
+  * @param  Sim: 仿真Flash.
+  * @param  AddressMode: 地址线数,QSPI_ADDRESS_NONE表示没有地址.
+  * @param  DummyCycles: dummy周期.
+  * @param  DataMode: 数据线数,QSPI_DATA_NONE表示没有数据.
+  * @param  Size: 数据长度.
+  * @param  Ddr: 不为0时地址和数据在双沿传输(DTR),周期减半,指令和dummy不变.
+  */
+static uint64_t NOR_Sim_BusTime(nor_sim_t *Sim, uint32_t AddressMode, uint32_t DummyCycles, uint32_t DataMode, uint32_t Size, uint8_t Ddr)
+{
+    uint64_t cycles = 8 + DummyCycles;
+    uint32_t lines = NOR_Sim_Lines(AddressMode);
+
+    if (lines != 0)
+    {
+        cycles += Sim->info.AddressBytes * 8 / lines / (Ddr ? 2 : 1);
+    }
+    lines = NOR_Sim_Lines(DataMode);
+    if (lines != 0)
+    {
+        cycles += (uint64_t)Size * 8 / lines / (Ddr ? 2 : 1);
+    }
+    return cycles * 1000000000 / Sim->clock_hz;
+}
+
+/**
+  * @brief  总线传输一条指令,推进时钟.后台读还没传完的话先等它.
+  * @param  Sim: 仿真Flash.
+  * @param  AddressMode: 地址线数,QSPI_ADDRESS_NONE表示没有地址.
+  * @param  DummyCycles: dummy周期.
+  * @param  DataMode: 数据线数,QSPI_DATA_NONE表示没有数据.
+  * @param  Size: 数据长度.
+  * @param  Ddr: 不为0时按DTR算.
+  */
+static void NOR_Sim_Bus(nor_sim_t *Sim, uint32_t AddressMode, uint32_t DummyCycles, uint32_t DataMode, uint32_t Size, uint8_t Ddr)
+{
+    if (Sim_Clock_Now() < Sim->dma_until)
+    {
+        Sim_Clock_Advance(Sim->dma_until - Sim_Clock_Now());
+    }
+    Sim_Clock_Advance(NOR_Sim_BusTime(Sim, AddressMode, DummyCycles, DataMode, Size, Ddr));
+}
+
+/**
+  * @brief  芯片忙的话等到空闲,相当于驱动里的AutoPollingMemReady.
+  * @param  Sim: 仿真Flash.
+  * @note   暂停状态下允许读写其他区域,不用等.
+  */
+static void NOR_Sim_WaitReady(nor_sim_t *Sim)
+{
+    if (Sim->status == QSPI_BUSY)
+    {
+        WL_PROF_BEGIN(t);
+        if (Sim_Clock_Now() < Sim->busy_until)
+        {
+            Sim_Clock_Advance(Sim->busy_until - Sim_Clock_Now());
+        }
+        Sim->status = QSPI_OK;
+        WL_PROF_END(WL_PROF_POLL, t);
+    }
+}
+
+/**
+  * @brief  芯片内部操作,驱动会等它做完,所以直接推进时钟.
+  * @param  Sim: 仿真Flash.
+  * @param  ns: 操作时间.
+  */
+static void NOR_Sim_Busy(nor_sim_t *Sim, uint64_t ns)
+{
+    Sim->busy_ns += ns;
+    Sim->busy_until = Sim_Clock_Now() + ns;
+    Sim->status = QSPI_BUSY;
+    NOR_Sim_WaitReady(Sim);
+}
+
+/**
+  * @brief  检查地址范围.
+  * @param  Sim: 仿真Flash.
+  * @param  Op: 操作名,打印用.
+  * @param  Address: 地址.
+  * @param  Size: 长度.
+  * @retval QSPI_OK或者QSPI_ERROR.
+  */
+static uint8_t NOR_Sim_Check(nor_sim_t *Sim, const char *Op, uint32_t Address, uint32_t Size)
+{
+    if ((Address >= Sim->info.FlashSize) || (Size > Sim->info.FlashSize - Address))
+    {
+        fprintf(stderr, "NOR_Sim: %s out of range 0x%08X size 0x%X\n", Op, (unsigned int)Address, (unsigned int)Size);
+        Sim->errors++;
+        return QSPI_ERROR;
+    }
+    return QSPI_OK;
+}
+
+/**
+  * @brief  把一块变成擦除状态(取反储存就是全0).
+  * @param  Sim: 仿真Flash.
+  * @param  Address: 地址.
+  * @param  Size: 长度.
+  * @note   文件模式直接在文件上打洞,擦过的地方重新变回稀疏的,不占磁盘.
+  */
+static void NOR_Sim_Clear(nor_sim_t *Sim, uint32_t Address, uint32_t Size)
+{
+#ifdef FALLOC_FL_PUNCH_HOLE
+    if ((Sim->fd >= 0) && (fallocate(Sim->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, Address, Size) == 0))
+    {
+        return;
+    }
+#endif
+    memset(&Sim->mem[Address], 0x00, Size);
+}
+
+/**
+  * @brief  掉电测试的计数,每条编程/擦除指令调用一次.
+  * @param  Sim: 仿真Flash.
+  * @param  Op: 'P'编程,'E'擦除.
+  * @param  Address: 指令地址.
+  * @retval 0: 正常执行, 1: 这条做到一半掉电, 2: 已经掉电了,不执行.
+  */
+static uint8_t NOR_Sim_Cut(nor_sim_t *Sim, uint8_t Op, uint32_t Address)
+{
+    if (Sim->dead)
+    {
+        return 2;
+    }
+    Sim->write_cmds++;
+    if ((Sim->cut_at == 0) || (Sim->write_cmds != Sim->cut_at))
+    {
+        return 0;
+    }
+    Sim->dead = 1;
+    Sim->cut_op = Op;
+    Sim->cut_addr = Address;
+    return 1;
+}
+
+/**
+  * @brief  掉电时已经改了的位,xorshift随机数.
+  * @param  Sim: 仿真Flash.
+  * @retval 为1的位表示已经改了.
+  */
+static uint8_t NOR_Sim_CutBits(nor_sim_t *Sim)
+{
+    Sim->cut_seed ^= Sim->cut_seed << 13;
+    Sim->cut_seed ^= Sim->cut_seed >> 17;
+    Sim->cut_seed ^= Sim->cut_seed << 5;
+    return (uint8_t)(Sim->cut_seed >> 24);
+}
+
+/* 下面是WL_Flash的驱动接口,drv就是nor_sim_t. */
+
+static void NOR_Sim_WL_Read(void *drv, uint32_t addr, uint8_t *dest, uint32_t size)
+{
+    NOR_Sim_Read((nor_sim_t *)drv, addr, dest, size);
+}
+
+static void NOR_Sim_WL_Read_Start(void *drv, uint32_t addr, uint8_t *dest, uint32_t size)
+{
+    NOR_Sim_ReadStart((nor_sim_t *)drv, addr, dest, size);
+}
+
+static uint8_t NOR_Sim_WL_Read_Done(void *drv, uint8_t wait)
+{
+    return NOR_Sim_ReadDone((nor_sim_t *)drv, wait);
+}
+
+/* 和BSP_QSPI_Write一样按Page拆开写. */
+static void NOR_Sim_WL_Program(void *drv, uint32_t addr, const uint8_t *src, uint32_t size)
+{
+    nor_sim_t *Sim = (nor_sim_t *)drv;
+
+    while (size > 0)
+    {
+        uint32_t len = Sim->info.PageSize - (addr & (Sim->info.PageSize - 1));
+        if (len > size)
+        {
+            len = size;
+        }
+        NOR_Sim_PageProgram(Sim, addr, src, len);
+        addr += len;
+        src += len;
+        size -= len;
+    }
+}
+
+static void NOR_Sim_WL_Erase(void *drv, uint32_t addr, uint32_t size)
+{
+    NOR_Sim_Erase((nor_sim_t *)drv, addr, size);
+}
+
+static void NOR_Sim_WL_Erase_Chip(void *drv)
+{
+    NOR_Sim_Erase_Chip_Start((nor_sim_t *)drv);
+}
+
+static uint8_t NOR_Sim_WL_GetStatus(void *drv)
+{
+    return NOR_Sim_GetStatus((nor_sim_t *)drv);
+}
+
+static void NOR_Sim_WL_Suspend(void *drv)
+{
+    NOR_Sim_Suspend((nor_sim_t *)drv);
+}
+
+static void NOR_Sim_WL_Resume(void *drv)
+{
+    NOR_Sim_Resume((nor_sim_t *)drv);
+}
+
+static void NOR_Sim_WL_Info(void *drv, uint32_t *chip_size, uint32_t *erase_size)
+{
+    nor_sim_t *Sim = (nor_sim_t *)drv;
+
+    *chip_size = Sim->info.FlashSize;
+    for (uint32_t i = 0; i < WL_FLASH_ERASE_TYPES; i++)
+    {
+        erase_size[i] = (i < BSP_QSPI_ERASE_TYPES) ? Sim->info.EraseSize[i] : 0;
+    }
+}
+
+const wl_flash_ops_t NOR_Sim_WL_Ops =
+{
+    NOR_Sim_WL_Read,
+    NOR_Sim_WL_Program,
+    NOR_Sim_WL_Erase,
+    NOR_Sim_WL_Erase_Chip,
+    NOR_Sim_WL_GetStatus,
+    NOR_Sim_WL_Suspend,
+    NOR_Sim_WL_Resume,
+    NOR_Sim_WL_Info,
+    WL_FLASH_CAP_SUSPEND | WL_FLASH_CAP_READ_DMA,
+    N25Q128A_BULK_ERASE_TYP_TIME,
+    NOR_Sim_WL_Read_Start,
+    NOR_Sim_WL_Read_Done,
+};
@@ -0,0 +1,70 @@
+/**
+    描述: PC仿真的移植层,虚拟时钟 + FreeRTOS替身.
+    文件: Sim_Port.c
+    注意: 虚拟时钟只在仿真Flash操作和vTaskDelay时前进,所以同样的输入每次跑出来的时间都一样.
+          时钟是线程局部的,一个线程里同时只跑一个仿真就行.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stm32l4xx.h"
+
+/* 虚拟时钟,单位ns.每个线程一个,参数扫描时各个线程里的仿真互不影响. */
+static __thread uint64_t Sim_Clock;
+
+uint64_t Sim_Clock_Now(void)
+{
+    return Sim_Clock;
+}
+
+void Sim_Clock_Advance(uint64_t ns)
+{
+    Sim_Clock += ns;
+}
+
+void Sim_Clock_Reset(void)
+{
+    Sim_Clock = 0;
+}
+
+void *pvPortMalloc(size_t xSize)
+{
+    return malloc(xSize);
+}
+
+void vPortFree(void *pv)
+{
+    free(pv);
+}
+
+/**
+  * @brief  没有调度器,延时就是直接把虚拟时钟往前拨.
+  * @param  xTicksToDelay: 延时的Tick数.
+  */
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+    Sim_Clock_Advance((uint64_t)xTicksToDelay * portTICK_PERIOD_MS * 1000000);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(Sim_Clock / (portTICK_PERIOD_MS * 1000000));
+}
+
+uint32_t SystemCoreClock = 80000000;
+CoreDebug_Type Sim_CoreDebug;
+
+/**
+  * @brief  DWT替身,CYCCNT按SystemCoreClock从虚拟时钟换算,写进去的值不起作用.
+  */
+DWT_Type *Sim_DWT(void)
+{
+    static __thread DWT_Type Dwt;
+
+    Dwt.CYCCNT = (uint32_t)(Sim_Clock * (SystemCoreClock / 1000000) / 1000);
+    return &Dwt;
+}
@@ -0,0 +1,91 @@
+/**
+    描述: 仿真用的写入负载,磨损仿真和参数扫描共用.
+    文件: Sim_Workload.c
+    注意: hotspot(90%写到10%的扇区), uniform(均匀随机), seqlog(顺序循环日志), fat(数据+FAT表+目录反复改写).
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <string.h>
+#include "Sim_Workload.h"
+
+/**
+  * @brief  xorshift随机数.
+  * @param  seed: 随机数状态,不能是0.
+  * @retval 随机数
+  */
+uint32_t Sim_Rand(uint32_t *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+static uint32_t Sim_Workload_HotSpot(uint32_t *seed, uint32_t op, uint32_t sectors)
+{
+    uint32_t hot = (sectors + 9) / 10;
+    (void)op;
+    if ((Sim_Rand(seed) % 10) != 0)
+    {
+        return Sim_Rand(seed) % hot;
+    }
+    return Sim_Rand(seed) % sectors;
+}
+
+static uint32_t Sim_Workload_Uniform(uint32_t *seed, uint32_t op, uint32_t sectors)
+{
+    (void)op;
+    return Sim_Rand(seed) % sectors;
+}
+
+static uint32_t Sim_Workload_SeqLog(uint32_t *seed, uint32_t op, uint32_t sectors)
+{
+    (void)seed;
+    return op % sectors;
+}
+
+/* 扇区0是FAT表,扇区1是目录,后面是数据.每写一个数据扇区改一次FAT,每4个数据扇区改一次目录,至少要3个扇区. */
+static uint32_t Sim_Workload_Fat(uint32_t *seed, uint32_t op, uint32_t sectors)
+{
+    uint32_t round = op / 9;
+    uint32_t step = op % 9;
+    (void)seed;
+    if ((step % 2) == 1)
+    {
+        return 0;
+    }
+    if (step == 8)
+    {
+        return 1;
+    }
+    return 2 + (round * 4 + step / 2) % (sectors - 2);
+}
+
+const sim_workload_t Sim_Workloads[] =
+{
+    { "hotspot", Sim_Workload_HotSpot },
+    { "uniform", Sim_Workload_Uniform },
+    { "seqlog", Sim_Workload_SeqLog },
+    { "fat", Sim_Workload_Fat },
+};
+
+const uint32_t Sim_Workload_Count = sizeof(Sim_Workloads) / sizeof(Sim_Workloads[0]);
+
+/**
+  * @brief  按名字找负载.
+  * @param  name: 负载名.
+  * @retval 负载,没有就是NULL.
+  */
+const sim_workload_t *Sim_Workload_Find(const char *name)
+{
+    for (uint32_t i = 0; i < Sim_Workload_Count; i++)
+    {
+        if (strcmp(Sim_Workloads[i].name, name) == 0)
+        {
+            return &Sim_Workloads[i];
+        }
+    }
+    return NULL;
+}
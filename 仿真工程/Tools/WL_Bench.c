@@ -0,0 +1,206 @@
+/**
+    描述: 在仿真Flash上跑WL_Bench,时间是虚拟时钟,和板上的结果可以直接对比.
+    文件: WL_Bench.c
+    用法: wl_bench [-s 区域大小] [-n 每项次数] [-C 行大小,组数,每组行数] [-w 写缓冲大小] [-R 块大小,块数,流数] [-p 处理时间] [-t 丢弃位图sector数] [-D 0|1] [-c 写入次数] [-r 读取次数] > bench.csv
+          默认区域1MB,和测试工程里定义WL_FLASH_BENCH时一样.
+          -C: 打开读缓存,比如-C 256,16,4就是16组每组4行,每行256字节.
+          -w: 打开写缓冲,一般是编程页大小256.
+          -R: 打开顺序预读,比如-R 4096,2,1就是一个流,往前读两块4KB.
+          -p: 流式读测试里每块512字节处理多少us,默认50.
+          -t: 留几个sector存丢弃位图(cfg.trim_sectors),比如-t 2,打开WL_Flash_Discard,才有fs两行.
+          -D: QSPI时钟降到DTR允许的40MHz(N25Q128A_CLOCK_PRESCALER_DTR),-D 1大块读走DTR,-D 0还是STR,
+              和不加-D(STR 80MHz)对比就是N25Q128A_DTR_ENABLE的收益.
+          -c: 不跑WL_Bench,只测WL_Flash_Write本身用的CPU时间(真实时间,不是虚拟时钟),
+              加不加-DWL_FLASH_NO_STATS各编一次对比,就是统计计数的开销.
+          -r: 不跑WL_Bench,只测16字节顺序WL_Flash_Read用的CPU时间,主要是地址换算和仿真Flash的拷贝.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "NOR_Sim.h"
+#include "WL_Bench.h"
+
+static nor_sim_t Sim;
+static wl_flash_t W;
+static wl_bench_t Bench;
+static uint8_t Buf[16 * 1024];
+
+static void Bench_Out(const char *line)
+{
+    puts(line);
+}
+
+/* 消费者处理数据,CPU在忙,Flash和DMA照样走,所以只推进虚拟时钟. */
+static void Bench_Work(uint32_t us)
+{
+    Sim_Clock_Advance((uint64_t)us * 1000);
+}
+
+static uint64_t Bench_Cpu_Ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+  * @brief  按Sector写count次256字节,每个Sector先擦再写满,擦除不算时间.
+  *         仿真Flash的拷贝也算在里面,所以这是偏保守的写路径时间.
+  *         机器上别的进程干扰很大,取写满一个Sector最快的那次来算,不取平均.
+  */
+static void Bench_Cpu(uint32_t count)
+{
+    uint32_t per = W.cfg.sector_size / 256;
+    uint64_t best = ~(uint64_t)0, start, t;
+    wl_flash_stats_t stats;
+    uint8_t on;
+
+    WL_Flash_Config(&W);
+    WL_Flash_Format(&W, NULL);
+    for (uint32_t i = 0; i < count; i += per)
+    {
+        uint32_t addr = (i * 256) % W.flash_size;
+        WL_Flash_Erase_Range(&W, addr, W.cfg.sector_size);
+        start = Bench_Cpu_Ns();
+        for (uint32_t j = 0; j < per; j++)
+        {
+            WL_Flash_Write(&W, addr + j * 256, Buf, 256);
+        }
+        t = Bench_Cpu_Ns() - start;
+        best = (t < best) ? t : best;
+    }
+    on = WL_Flash_GetStats(&W, &stats, 0);
+    printf("stats %s, %u writes x 256 bytes, %.1f ns/write, %llu program bytes counted\n", on ? "on" : "off",
+           (unsigned int)count, (double)best / per, (unsigned long long)stats.flash_program);
+}
+
+/**
+  * @brief  按16字节顺序读count次,一次读完一个Sector算一批,取最快的一批.
+  *         这是日志回放,解析文件这种最常见的热路径,每次读都要换算一次地址.
+  */
+static void Bench_Cpu_Read(uint32_t count)
+{
+    uint32_t per = W.cfg.sector_size / 16;
+    uint64_t best = ~(uint64_t)0, start, t;
+
+    WL_Flash_Config(&W);
+    WL_Flash_Format(&W, NULL);
+    for (uint32_t i = 0; i < count; i += per)
+    {
+        uint32_t addr = ((i / per) * W.cfg.sector_size) % W.flash_size;
+        start = Bench_Cpu_Ns();
+        for (uint32_t j = 0; j < per; j++)
+        {
+            WL_Flash_Read(&W, addr + j * 16, Buf, 16);
+        }
+        t = Bench_Cpu_Ns() - start;
+        best = (t < best) ? t : best;
+    }
+    printf("%u reads x 16 bytes, %.1f ns/read\n", (unsigned int)count, (double)best / per);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t area = 0x00100000, cpu = 0, cpu_read = 0;
+    int opt, dtr = -1;
+
+    Bench.work_us = 50;
+    while ((opt = getopt(argc, argv, "s:n:C:w:R:p:t:D:c:r:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            area = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            Bench.iterations = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'C':
+            if (sscanf(optarg, "%u,%u,%u", &W.cache_line_size, &W.cache_sets, &W.cache_ways) != 3)
+            {
+                fprintf(stderr, "-C line_size,sets,ways\n");
+                return 1;
+            }
+            break;
+        case 'w':
+            W.wb_size = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'R':
+            if (sscanf(optarg, "%u,%u,%u", &W.ra_size, &W.ra_depth, &W.ra_streams) != 3)
+            {
+                fprintf(stderr, "-R block_size,depth,streams\n");
+                return 1;
+            }
+            break;
+        case 'p':
+            Bench.work_us = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            W.cfg.trim_sectors = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'D':
+            dtr = (int)strtol(optarg, NULL, 0);
+            break;
+        case 'c':
+            cpu = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            cpu_read = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s area] [-n iterations] [-C line,sets,ways] [-w wb_size] [-R size,depth,streams] [-p work_us] [-t trim_sectors] [-D 0|1] [-c cpu_writes] [-r cpu_reads]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Sim_Clock_Reset();
+    if (NOR_Sim_Init(&Sim, N25Q128A_FLASH_SIZE) != QSPI_OK)
+    {
+        fprintf(stderr, "flash init failed\n");
+        return 1;
+    }
+    if (dtr >= 0)
+    {
+        Sim.clock_hz = NOR_SIM_SYSCLK_HZ / (N25Q128A_CLOCK_PRESCALER_DTR + 1);
+        Sim.dtr_min = dtr ? N25Q128A_DTR_READ_MIN : 0;
+    }
+    W.cfg.start_addr = 0x00000000;
+    W.cfg.full_mem_size = area;
+    W.cfg.page_size = Sim.info.EraseSize[0];
+    W.cfg.sector_size = Sim.info.EraseSize[0];
+    W.cfg.wr_size = 0x00000010;
+    W.cfg.version = 0x00000001;
+    W.cfg.temp_buff_size = 0x00000020;
+    W.ops = &NOR_Sim_WL_Ops;
+    W.drv = &Sim;
+
+    if ((cpu != 0) || (cpu_read != 0))
+    {
+        if (cpu != 0)
+        {
+            Bench_Cpu(cpu);
+        }
+        else
+        {
+            Bench_Cpu_Read(cpu_read);
+        }
+        NOR_Sim_DeInit(&Sim);
+        return 0;
+    }
+
+    Bench.now_ns = Sim_Clock_Now;
+    Bench.out = Bench_Out;
+    Bench.work = Bench_Work;
+    Bench.buf = Buf;
+    Bench.buf_size = sizeof(Buf);
+    WL_Bench_Run(&Bench, &W);
+
+    NOR_Sim_DeInit(&Sim);
+    return Sim.errors != 0;
+}
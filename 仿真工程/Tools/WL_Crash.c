@@ -0,0 +1,356 @@
+/**
+    描述: 掉电测试.在每条(或者每隔几条)Flash编程/擦除指令的中间掉电,重新挂载后检查数据,记录恢复时间.
+    文件: WL_Crash.c
+    用法: wl_crash [-s 区域大小] [-n 写入次数] [-k 间隔] [-p 恢复后再写几次] [-S 种子] [-o 每个掉电点的CSV] [-m] [-u] [-t]
+          负载是随机挑一个Sector,擦掉再写满,和平时用法一样.区域默认256KB,pos很快就会转一圈,
+          两份state重写的过程也能测到.
+          判断标准: 掉电时正在改的那个Sector内容不管,其他Sector必须和掉电前一样,
+          重新挂载后再写几次也必须都对(pos错了的话马上就会读错).
+          -m: 不擦,用WL_Flash_Program整个Sector写新内容(经过dummy合并),掉电时正在改的Sector也要检查,
+              只能是旧的或者新的.
+          -u: 起点是旧版16位state格式的Flash,每次都从挂载(迁移)开始,迁移中途也会掉电.
+          -t: 一个Page两个sector,留2个sector存丢弃位图,负载按Page擦写,写满以后每个Page的后一半先丢弃.
+              配合-m时WL_Flash_Program同时盖住丢弃的sector和要擦的sector,新内容不能读成0xFF.
+          区域超过16MB时仿真Flash用4字节地址,比如-s 0x10000000测256MB.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "NOR_Sim.h"
+#include "WL_Flash.h"
+#include "CRC.h"
+#include "Sim_Workload.h"
+
+static nor_sim_t Sim;
+static wl_flash_t W;
+static uint32_t Area = 0x00040000;
+static int Merge = 0; /* -m */
+static int Upgrade = 0; /* -u */
+static int Trim = 0; /* -t */
+static uint32_t Unit; /* 负载擦写的单位,cfg.page_size */
+
+/* 旧版16位字段的state,和WL_Flash.c里的wl_state_v1_t一样. */
+typedef struct
+{
+    uint16_t pos;
+    uint16_t max_pos;
+    uint16_t move_count;
+    uint16_t block_size;
+    uint8_t version;
+    uint32_t crc;
+} crash_state_v1_t;
+
+/**
+  * @brief  重新挂载,和上电一样从Flash里恢复.
+  */
+static void Crash_Mount(void)
+{
+    W.cfg.start_addr = 0x00000000;
+    W.cfg.full_mem_size = Area;
+    W.cfg.page_size = Sim.info.EraseSize[0] * (Trim ? 2 : 1);
+    W.cfg.sector_size = Sim.info.EraseSize[0];
+    W.cfg.wr_size = 0x00000010;
+    W.cfg.version = 0x00000001;
+    W.cfg.temp_buff_size = 0x00000020;
+    W.cfg.trim_sectors = Trim ? 2 : 0;
+    W.ops = &NOR_Sim_WL_Ops;
+    W.drv = &Sim;
+    WL_Flash_Config(&W);
+}
+
+/**
+  * @brief  把两份state改写成旧版16位格式(头部加pos个坐标),和旧固件写出来的一样,数据区不动.
+  * @retval 0: 正常, 1: 区域太大,16位放不下.
+  */
+static int Crash_Downgrade(void)
+{
+    crash_state_v1_t old;
+    uint32_t addr[2] = { W.addr_state1, W.addr_state2 };
+    uint8_t used = 0x00;
+
+    if (W.state.max_pos > 0xFFFF)
+    {
+        return 1;
+    }
+    memset(&old, 0, sizeof(old));
+    old.pos = (uint16_t)W.state.pos;
+    old.max_pos = (uint16_t)W.state.max_pos;
+    old.move_count = (uint16_t)W.state.move_count;
+    old.block_size = (uint16_t)W.state.block_size;
+    old.version = W.state.version;
+    old.crc = Calculate_CRC((uint8_t *)&old, sizeof(old) - sizeof(uint32_t));
+    for (uint32_t c = 0; c < 2; c++)
+    {
+        for (uint32_t a = 0; a < W.state_size; a += Sim.info.EraseSize[0])
+        {
+            NOR_Sim_Erase(&Sim, addr[c] + a, Sim.info.EraseSize[0]);
+        }
+        NOR_Sim_PageProgram(&Sim, addr[c], (const uint8_t *)&old, sizeof(old));
+        for (uint32_t i = 0; i < W.state.pos; i++)
+        {
+            NOR_Sim_PageProgram(&Sim, addr[c] + sizeof(old) + i * W.cfg.wr_size, &used, 1);
+        }
+    }
+    return 0;
+}
+
+/* 第gen次写到sector的内容,-t时第0次的后一半已经丢弃了,读出来是0xFF. */
+static void Crash_Pattern(uint8_t *buf, uint32_t sector, uint32_t gen)
+{
+    for (uint32_t j = 0; j < Unit; j++)
+    {
+        buf[j] = (Trim && (gen == 0) && (j >= W.cfg.sector_size)) ? 0xFF : (uint8_t)((sector * 131) ^ (gen * 17) ^ j ^ (j >> 8));
+    }
+}
+
+/* 擦掉再写满一个Sector(-t时是一个Page). */
+static void Crash_Write(uint8_t *buf, uint32_t sector, uint32_t gen)
+{
+    Crash_Pattern(buf, sector, gen);
+    if (Merge)
+    {
+        WL_Flash_Program(&W, sector * Unit, buf, Unit);
+        return;
+    }
+    WL_Flash_Erase_Range(&W, sector * Unit, Unit);
+    WL_Flash_Write(&W, sector * Unit, buf, Unit);
+}
+
+/**
+  * @brief  对比所有Sector.
+  * @param  gen: 每个Sector应该是第几次写的内容.
+  * @param  skip: 不检查的Sector(掉电时正在改的),不跳过就传0xFFFFFFFF.
+  * @retval 第一个不对的Sector,都对返回0xFFFFFFFF.
+  */
+static uint32_t Crash_Verify(const uint32_t *gen, uint32_t sectors, uint32_t skip)
+{
+    static uint8_t expect[0x10000], got[0x10000];
+
+    for (uint32_t s = 0; s < sectors; s++)
+    {
+        if (s == skip)
+        {
+            continue;
+        }
+        Crash_Pattern(expect, s, gen[s]);
+        WL_Flash_Read(&W, s * Unit, got, Unit);
+        if (memcmp(expect, got, Unit) != 0)
+        {
+            return s;
+        }
+    }
+    return 0xFFFFFFFF;
+}
+
+static int Crash_Cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t ops = 100, step = 1, post = 4, seed = 1, sectors, total_cmds, cuts = 0, fails = 0;
+    uint8_t *base, *buf;
+    uint32_t *gen, *base_gen;
+    uint64_t *rec_ns;
+    FILE *csv = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:n:k:p:S:o:mut")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            Area = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            ops = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'k':
+            step = (uint32_t)strtoul(optarg, NULL, 0);
+            step = (step == 0) ? 1 : step;
+            break;
+        case 'p':
+            post = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'S':
+            seed = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            csv = fopen(optarg, "w");
+            break;
+        case 'm':
+            Merge = 1;
+            break;
+        case 'u':
+            Upgrade = 1;
+            break;
+        case 't':
+            Trim = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s area] [-n ops] [-k step] [-p post_ops] [-S seed] [-o cuts.csv] [-m] [-u] [-t]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    /* 只用区域大小的Flash,镜像小,每个掉电点恢复一次很快. */
+    if (NOR_Sim_Init(&Sim, Area) != QSPI_OK)
+    {
+        fprintf(stderr, "flash init failed\n");
+        return 1;
+    }
+    Crash_Mount();
+    WL_Flash_Format(&W, NULL);
+    Unit = W.cfg.page_size;
+    sectors = W.flash_size / Unit;
+    buf = (uint8_t *)malloc(Unit);
+    gen = (uint32_t *)calloc(sectors, sizeof(uint32_t));
+    base_gen = (uint32_t *)calloc(sectors, sizeof(uint32_t));
+    /* -u的话多写一遍,pos转过一圈,旧格式里move_count也不是0. */
+    for (uint32_t s = 0; s < sectors * (Upgrade ? 2 : 1); s++)
+    {
+        Crash_Write(buf, s % sectors, 0);
+    }
+    for (uint32_t s = 0; Trim && (s < sectors); s++)
+    {
+        if (!WL_Flash_Discard(&W, s * Unit + W.cfg.sector_size, W.cfg.sector_size))
+        {
+            fprintf(stderr, "no room for the discard map\n");
+            return 1;
+        }
+    }
+    if (Upgrade && (Crash_Downgrade() != 0))
+    {
+        fprintf(stderr, "area too large for the 16-bit state format\n");
+        return 1;
+    }
+    base = (uint8_t *)malloc(Area);
+    memcpy(base, Sim.mem, Area);
+
+    /* 先完整跑一遍,看一共有多少条编程/擦除指令.-u的话挂载时的迁移也算在里面. */
+    {
+        uint32_t r = seed;
+        uint32_t start = Sim.write_cmds;
+        if (Upgrade)
+        {
+            uint32_t pos = W.state.pos, move_count = W.state.move_count;
+            Crash_Mount();
+            if ((W.state.pos != pos) || (W.state.move_count != move_count) || (Crash_Verify(gen, sectors, 0xFFFFFFFF) != 0xFFFFFFFF))
+            {
+                printf("16-bit state migration failed: pos %u/%u move_count %u/%u\n", (unsigned int)W.state.pos, (unsigned int)pos,
+                       (unsigned int)W.state.move_count, (unsigned int)move_count);
+                return 1;
+            }
+            printf("migrated 16-bit state: pos %u move_count %u, all sectors ok\n", (unsigned int)pos, (unsigned int)move_count);
+        }
+        for (uint32_t i = 0; i < ops; i++)
+        {
+            Crash_Write(buf, Sim_Rand(&r) % sectors, i + 1);
+        }
+        total_cmds = Sim.write_cmds - start;
+    }
+    rec_ns = (uint64_t *)malloc(sizeof(uint64_t) * (total_cmds / step + 1));
+    if (csv != NULL)
+    {
+        fprintf(csv, "cut,op,addr,wl_op,sector,recovery_us,result\n");
+    }
+
+    for (uint32_t cut = 1; cut <= total_cmds; cut += step)
+    {
+        uint32_t r = seed, i, sector = 0, bad;
+        uint64_t t;
+
+        /* 每个掉电点都从同一个起点开始,负载也一样. */
+        memcpy(Sim.mem, base, Area);
+        memcpy(gen, base_gen, sizeof(uint32_t) * sectors);
+        NOR_Sim_PowerOn(&Sim);
+        if (!Upgrade)
+        {
+            Crash_Mount();
+        }
+        NOR_Sim_PowerCut(&Sim, cut, seed * 2654435761u + cut);
+        if (Upgrade)
+        {
+            Crash_Mount();
+        }
+        for (i = 0; i < ops; i++)
+        {
+            sector = Sim_Rand(&r) % sectors;
+            Crash_Write(buf, sector, i + 1);
+            if (Sim.dead)
+            {
+                break;
+            }
+            gen[sector] = i + 1;
+        }
+
+        /* 重新上电,挂载时间就是恢复时间. */
+        NOR_Sim_PowerOn(&Sim);
+        t = Sim_Clock_Now();
+        Crash_Mount();
+        rec_ns[cuts] = Sim_Clock_Now() - t;
+        bad = Crash_Verify(gen, sectors, sector);
+        /* 合并写是原子的,掉电的Sector要么还是旧的,要么已经是新的. */
+        if (Merge && (bad == 0xFFFFFFFF) && (i < ops))
+        {
+            uint32_t old = gen[sector];
+            gen[sector] = i + 1;
+            if (Crash_Verify(gen, sectors, 0xFFFFFFFF) != 0xFFFFFFFF)
+            {
+                gen[sector] = old;
+                bad = Crash_Verify(gen, sectors, 0xFFFFFFFF);
+            }
+        }
+
+        /* 恢复以后接着写,掉电的Sector也重新写一次. */
+        for (uint32_t j = 0; (j < post) && (bad == 0xFFFFFFFF); j++)
+        {
+            uint32_t s = (j == 0) ? sector : (Sim_Rand(&r) % sectors);
+            Crash_Write(buf, s, ops + 1 + j);
+            gen[s] = ops + 1 + j;
+            bad = Crash_Verify(gen, sectors, 0xFFFFFFFF);
+        }
+        if (bad != 0xFFFFFFFF)
+        {
+            if (fails < 10)
+            {
+                printf("cut %u (%c 0x%08X, op %u sector %u): sector %u wrong after recovery, pos %u move_count %u\n",
+                       (unsigned int)cut, Sim.cut_op, (unsigned int)Sim.cut_addr, (unsigned int)i, (unsigned int)sector,
+                       (unsigned int)bad, (unsigned int)W.state.pos, (unsigned int)W.state.move_count);
+            }
+            fails++;
+        }
+        if (csv != NULL)
+        {
+            fprintf(csv, "%u,%c,%u,%u,%u,%.3f,%s\n", (unsigned int)cut, Sim.cut_op, (unsigned int)Sim.cut_addr, (unsigned int)i,
+                    (unsigned int)sector, rec_ns[cuts] / 1e3, (bad == 0xFFFFFFFF) ? "ok" : "fail");
+        }
+        cuts++;
+    }
+
+    qsort(rec_ns, cuts, sizeof(uint64_t), Crash_Cmp);
+    printf("area 0x%X, %u sectors, max_pos %u, %u ops, %u flash writes/erases\n", (unsigned int)Area, (unsigned int)sectors,
+           (unsigned int)W.state.max_pos, (unsigned int)ops, (unsigned int)total_cmds);
+    printf("%u power cuts, %u failed\n", (unsigned int)cuts, (unsigned int)fails);
+    printf("recovery time: p50 %.1f us, p99 %.1f us, max %.1f us\n", rec_ns[(cuts - 1) / 2] / 1e3,
+           rec_ns[(cuts * 99 + 99) / 100 - 1] / 1e3, rec_ns[cuts - 1] / 1e3);
+
+    if (csv != NULL)
+    {
+        fclose(csv);
+    }
+    free(rec_ns);
+    free(base);
+    free(gen);
+    free(base_gen);
+    free(buf);
+    NOR_Sim_DeInit(&Sim);
+    return fails != 0;
+}
@@ -0,0 +1,664 @@
+/**
+    描述: FatFs跑在WL_Disk上的速度测试.工程里没有FatFs,这里照FatFs(R0.12c,FAT32,单FAT,非TINY)
+          的做法模拟它发给diskio的读写:一个扇区的窗口(fs->win)放FAT/目录/FSInfo,
+          每个文件一个扇区的缓冲(fp->buf),整扇区的f_read/f_write直接多扇区读写,
+          f_sync/f_close写回缓冲,改目录项,写FSInfo,最后CTRL_SYNC;f_unlink按连续的簇发CTRL_TRIM.
+    文件: WL_Fat.c
+    用法: wl_fat [-s 区域大小] [-n 文件数] [-k 每个文件KB] [-w 每次f_write字节] [-r 日志记录数] [-l 每条记录字节] [-t 丢弃位图sector数] [-p Page大小] [-a]
+          一次跑两遍,disk是WL_Disk(合并缓冲,同一个Flash sector里的几个扇区只写回一次),
+          sector是每个扇区单独WL_Flash_Update(没有合并缓冲的diskio就是这样),每遍都是一片新的Flash.
+          阶段: mkfs,create(建文件,每次f_write几KB,写完f_close),append(日志,每条f_write之后f_sync),
+          read(读回所有文件并校验),rewrite(打开文件从头重写一遍),unlink(删掉create的文件),recreate(再建一遍),
+          remount(重新挂载WL_Flash之后全部再校验一遍).
+          -t 留几个sector存丢弃位图,删文件的CTRL_TRIM才有用,recreate阶段挪dummy的复制会少.
+          -p 挪dummy的Page大小(cfg.page_size),默认和sector一样4K,比如-p 0x2000一个Page两个sector,
+             丢弃只丢了Page的一半时另一半的数据也要挪过去.
+          -a WL_Disk写回用WL_Flash_Program(atomic),sector也改成每个扇区单独WL_Flash_Program.
+          速度按虚拟时钟算,erase是擦除指令数,program是编程的KB数.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "NOR_Sim.h"
+#include "WL_Flash.h"
+#include "WL_Disk.h"
+
+#define SS WL_DISK_SECTOR_SIZE
+#define FAT_CLUSTER 8 /* 每簇扇区数,f_mkfs按GET_BLOCK_SIZE取4K */
+#define FAT_RESERVED 8 /* 保留区,引导扇区和FSInfo,按4K对齐 */
+#define FAT_EOC 0x0FFFFFFF
+#define FAT_MAX_FILES (FAT_CLUSTER * SS / 32 - 1) /* 根目录只有一个簇 */
+
+typedef struct
+{
+    uint32_t start; /* 第一个簇 */
+    uint32_t size;
+    uint32_t dir; /* 目录项序号 */
+    uint32_t seed; /* 内容由这个决定 */
+} fat_file_t;
+
+typedef struct
+{
+    nor_sim_t sim;
+    wl_flash_t flash;
+    wl_disk_t disk;
+    int merge; /* 1: WL_Disk, 0: 每个扇区WL_Flash_Update */
+    uint32_t area;
+    uint32_t trim;
+    uint32_t page; /* cfg.page_size,0和sector一样 */
+
+    uint32_t fat_start; /* FAT区第一个扇区 */
+    uint32_t data_start; /* 簇2的第一个扇区 */
+    uint32_t clusters; /* 数据区一共多少簇 */
+    uint32_t last_clst; /* 分配簇时从这里往后找,和FatFs的last_clst一样 */
+    uint8_t *used; /* 簇有没有用,代替FatFs找空簇时读的FAT(找的时候的读不计) */
+
+    uint8_t win[SS]; /* fs->win */
+    uint32_t winsect;
+    uint8_t wflag;
+
+    uint8_t buf[SS]; /* fp->buf */
+    uint32_t sect;
+    uint8_t dirty;
+    uint32_t clust; /* 当前簇 */
+
+    fat_file_t file[FAT_MAX_FILES + 1];
+} fat_sim_t;
+
+static fat_sim_t Fs;
+
+/* 文件第off个字节的内容. */
+static uint8_t Fat_Pattern(const fat_file_t *f, uint32_t off)
+{
+    uint32_t x = (f->seed + off / 4) * 2654435761u;
+    return (uint8_t)(x >> (8 * (off & 3)));
+}
+
+static void Disk_Read(uint32_t sector, uint8_t *buf, uint32_t count)
+{
+    if (Fs.merge)
+    {
+        WL_Disk_Read(&Fs.disk, sector, buf, count);
+    }
+    else
+    {
+        WL_Flash_Read(&Fs.flash, sector * SS, buf, count * SS);
+    }
+}
+
+static void Disk_Write(uint32_t sector, const uint8_t *buf, uint32_t count)
+{
+    if (Fs.merge)
+    {
+        WL_Disk_Write(&Fs.disk, sector, buf, count);
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (Fs.disk.atomic)
+        {
+            WL_Flash_Program(&Fs.flash, (sector + i) * SS, &buf[i * SS], SS);
+        }
+        else
+        {
+            WL_Flash_Update(&Fs.flash, (sector + i) * SS, &buf[i * SS], SS);
+        }
+    }
+}
+
+static void Disk_Sync(void)
+{
+    if (Fs.merge)
+    {
+        WL_Disk_Sync(&Fs.disk);
+    }
+    else
+    {
+        WL_Flash_Sync(&Fs.flash);
+    }
+}
+
+static void Disk_Trim(uint32_t sector, uint32_t count)
+{
+    if (Fs.merge)
+    {
+        WL_Disk_Trim(&Fs.disk, sector, count);
+    }
+    else
+    {
+        WL_Flash_Discard(&Fs.flash, sector * SS, count * SS);
+    }
+}
+
+/* FatFs的sync_window/move_window. */
+static void Fat_SyncWindow(void)
+{
+    if (Fs.wflag)
+    {
+        Disk_Write(Fs.winsect, Fs.win, 1);
+        Fs.wflag = 0;
+    }
+}
+
+static void Fat_MoveWindow(uint32_t sector)
+{
+    if (sector != Fs.winsect)
+    {
+        Fat_SyncWindow();
+        Disk_Read(sector, Fs.win, 1);
+        Fs.winsect = sector;
+    }
+}
+
+static uint32_t Fat_Get(uint32_t clst)
+{
+    uint8_t *p;
+
+    Fat_MoveWindow(Fs.fat_start + clst / (SS / 4));
+    p = &Fs.win[(clst % (SS / 4)) * 4];
+    return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24)) & 0x0FFFFFFF;
+}
+
+static void Fat_Put(uint32_t clst, uint32_t val)
+{
+    uint8_t *p;
+
+    Fat_MoveWindow(Fs.fat_start + clst / (SS / 4));
+    p = &Fs.win[(clst % (SS / 4)) * 4];
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8);
+    p[2] = (uint8_t)(val >> 16);
+    p[3] = (uint8_t)(val >> 24);
+    Fs.wflag = 1;
+    Fs.used[clst] = (val != 0);
+}
+
+/* FatFs的create_chain,prev为0是新链. */
+static uint32_t Fat_Create(uint32_t prev)
+{
+    uint32_t c = Fs.last_clst;
+
+    do
+    {
+        c = (c + 1 < Fs.clusters + 2) ? (c + 1) : 2;
+        if (c == Fs.last_clst)
+        {
+            fprintf(stderr, "disk full\n");
+            exit(1);
+        }
+    } while (Fs.used[c]);
+    Fat_Put(c, FAT_EOC);
+    if (prev != 0)
+    {
+        Fat_Put(prev, c);
+    }
+    Fs.last_clst = c;
+    return c;
+}
+
+/* FatFs的sync_fs: 窗口写回,FSInfo写回(FAT32改过空簇数就要写),CTRL_SYNC. */
+static void Fat_SyncFs(void)
+{
+    Fat_SyncWindow();
+    memset(Fs.win, 0, SS);
+    memcpy(Fs.win, "RRaA", 4);
+    memcpy(&Fs.win[484], "rrAa", 4);
+    memcpy(&Fs.win[492], &Fs.last_clst, 4);
+    Fs.win[510] = 0x55;
+    Fs.win[511] = 0xAA;
+    Fs.winsect = 1;
+    Disk_Write(1, Fs.win, 1);
+    Disk_Sync();
+}
+
+/* 改目录项(文件名,第一个簇,大小),del删掉. */
+static void Fat_Dir(const fat_file_t *f, int del)
+{
+    uint32_t index = f->dir + 1; /* 第0项是卷标 */
+    uint8_t *p;
+
+    Fat_MoveWindow(Fs.data_start + index / (SS / 32));
+    p = &Fs.win[(index % (SS / 32)) * 32];
+    if (del)
+    {
+        p[0] = 0xE5;
+    }
+    else
+    {
+        snprintf((char *)p, 12, "F%07u", (unsigned int)f->dir);
+        p[11] = 0x20;
+        p[20] = (uint8_t)(f->start >> 16);
+        p[21] = (uint8_t)(f->start >> 24);
+        p[26] = (uint8_t)f->start;
+        p[27] = (uint8_t)(f->start >> 8);
+        memcpy(&p[28], &f->size, 4);
+    }
+    Fs.wflag = 1;
+}
+
+static uint32_t Fat_Sector(uint32_t clst)
+{
+    return Fs.data_start + (clst - 2) * FAT_CLUSTER;
+}
+
+/* f_lseek到pos(不超过文件大小)再f_write. */
+static void Fat_Write(fat_file_t *f, uint32_t pos, uint32_t len)
+{
+    static uint8_t data[64 * 1024];
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        data[i] = Fat_Pattern(f, pos + i);
+    }
+    for (uint32_t done = 0; done < len;)
+    {
+        uint32_t p = pos + done, n;
+
+        if ((p % SS) == 0)
+        {
+            uint32_t csect = (p / SS) % FAT_CLUSTER;
+
+            if (csect == 0)
+            {
+                /* 簇已经有了就顺着链走,到末尾了再分配. */
+                if (p < f->size)
+                {
+                    Fs.clust = (p == 0) ? f->start : Fat_Get(Fs.clust);
+                }
+                else
+                {
+                    Fs.clust = Fat_Create((p == 0) ? 0 : Fs.clust);
+                    f->start = (p == 0) ? Fs.clust : f->start;
+                }
+            }
+            if (Fs.dirty)
+            {
+                Disk_Write(Fs.sect, Fs.buf, 1);
+                Fs.dirty = 0;
+            }
+            /* 整扇区直接写,最多到簇的末尾. */
+            n = (len - done) / SS;
+            n = (n < FAT_CLUSTER - csect) ? n : (FAT_CLUSTER - csect);
+            Fs.sect = Fat_Sector(Fs.clust) + csect;
+            if (n > 0)
+            {
+                Disk_Write(Fs.sect, &data[done], n);
+                done += n * SS;
+                f->size = (p + n * SS > f->size) ? (p + n * SS) : f->size;
+                continue;
+            }
+            /* 不满一个扇区,文件里原来有内容的要先读出来. */
+            if (p < f->size)
+            {
+                Disk_Read(Fs.sect, Fs.buf, 1);
+            }
+        }
+        n = SS - p % SS;
+        n = (n < len - done) ? n : (len - done);
+        memcpy(&Fs.buf[p % SS], &data[done], n);
+        Fs.dirty = 1;
+        done += n;
+        f->size = (p + n > f->size) ? (p + n) : f->size;
+    }
+}
+
+/* f_sync,f_close一样. */
+static void Fat_Sync(fat_file_t *f)
+{
+    if (Fs.dirty)
+    {
+        Disk_Write(Fs.sect, Fs.buf, 1);
+        Fs.dirty = 0;
+    }
+    Fat_Dir(f, 0);
+    Fat_SyncFs();
+}
+
+/* f_open新建+f_write若干次+f_close. */
+static void Fat_Create_File(fat_file_t *f, uint32_t size, uint32_t chunk)
+{
+    f->size = 0;
+    f->start = 0;
+    Fs.dirty = 0;
+    Fat_Dir(f, 0);
+    for (uint32_t done = 0; done < size; done += chunk)
+    {
+        Fat_Write(f, done, (chunk < size - done) ? chunk : (size - done));
+    }
+    Fat_Sync(f);
+}
+
+/* 打开已有的文件从头整个重写一遍(内容换了),文件大小不变. */
+static void Fat_Rewrite_File(fat_file_t *f, uint32_t chunk)
+{
+    f->seed += 1000003;
+    Fs.dirty = 0;
+    for (uint32_t done = 0; done < f->size; done += chunk)
+    {
+        Fat_Write(f, done, (chunk < f->size - done) ? chunk : (f->size - done));
+    }
+    Fat_Sync(f);
+}
+
+/* f_read整个文件,每次chunk字节(扇区的整数倍),返回不对的字节数. */
+static uint32_t Fat_Read(const fat_file_t *f, uint32_t chunk)
+{
+    static uint8_t data[64 * 1024 + SS];
+    uint32_t clst = f->start, bad = 0;
+
+    for (uint32_t pos = 0; pos < f->size;)
+    {
+        uint32_t n = (chunk < f->size - pos) ? chunk : (f->size - pos);
+
+        /* 一个簇里连着的扇区一次读,跨簇的时候查FAT;最后不满一个扇区的FatFs读到fp->buf,读的量一样. */
+        for (uint32_t off = 0; off < n;)
+        {
+            uint32_t csect = ((pos + off) / SS) % FAT_CLUSTER;
+            uint32_t cnt = (n - off + SS - 1) / SS;
+
+            if ((pos + off > 0) && (csect == 0))
+            {
+                clst = Fat_Get(clst);
+            }
+            cnt = (cnt < FAT_CLUSTER - csect) ? cnt : (FAT_CLUSTER - csect);
+            Disk_Read(Fat_Sector(clst) + csect, &data[off], cnt);
+            off += cnt * SS;
+        }
+        for (uint32_t i = 0; i < n; i++)
+        {
+            bad += (data[i] != Fat_Pattern(f, pos + i)) ? 1 : 0;
+        }
+        pos += n;
+    }
+    return bad;
+}
+
+/* f_unlink: 删目录项,按链把FAT清0,连续的簇一起CTRL_TRIM,最后sync_fs. */
+static void Fat_Unlink(fat_file_t *f)
+{
+    uint32_t clst = f->start, scl = clst, ecl = clst;
+
+    Fat_Dir(f, 1);
+    while ((clst >= 2) && (clst < FAT_EOC - 7))
+    {
+        uint32_t nxt = Fat_Get(clst);
+
+        Fat_Put(clst, 0);
+        if (nxt == ecl + 1)
+        {
+            ecl = nxt;
+        }
+        else
+        {
+            Disk_Trim(Fat_Sector(scl), (ecl - scl + 1) * FAT_CLUSTER);
+            scl = ecl = nxt;
+        }
+        clst = nxt;
+    }
+    f->start = 0;
+    f->size = 0;
+    Fat_SyncFs();
+}
+
+/* f_mkfs: 整个卷TRIM,写引导扇区和FSInfo(各有备份),FAT清0,根目录清0. */
+static void Fat_Mkfs(void)
+{
+    static uint8_t zero[FAT_CLUSTER * SS];
+    uint32_t volume = Fs.flash.flash_size / SS, fatsz;
+
+    fatsz = ((volume - FAT_RESERVED) / FAT_CLUSTER + 2) * 4;
+    fatsz = ((fatsz + SS - 1) / SS + FAT_CLUSTER - 1) / FAT_CLUSTER * FAT_CLUSTER;
+    Fs.fat_start = FAT_RESERVED;
+    Fs.data_start = FAT_RESERVED + fatsz;
+    Fs.clusters = (volume - Fs.data_start) / FAT_CLUSTER;
+    Fs.used = (uint8_t *)calloc(Fs.clusters + 2, 1);
+    Fs.last_clst = 2;
+    Fs.used[2] = 1; /* 根目录 */
+
+    Disk_Trim(0, volume);
+    memset(Fs.win, 0, SS);
+    Fs.win[0] = 0xEB;
+    Fs.win[1] = 0x58;
+    Fs.win[2] = 0x90;
+    memcpy(&Fs.win[3], "MSDOS5.0", 8);
+    memcpy(&Fs.win[82], "FAT32   ", 8);
+    Fs.win[510] = 0x55;
+    Fs.win[511] = 0xAA;
+    Disk_Write(0, Fs.win, 1);
+    Disk_Write(6, Fs.win, 1);
+    memset(Fs.win, 0, SS);
+    memcpy(Fs.win, "RRaA", 4);
+    memcpy(&Fs.win[484], "rrAa", 4);
+    Fs.win[510] = 0x55;
+    Fs.win[511] = 0xAA;
+    Disk_Write(1, Fs.win, 1);
+    Disk_Write(7, Fs.win, 1);
+    for (uint32_t s = 0; s < fatsz; s += FAT_CLUSTER)
+    {
+        memset(zero, 0, sizeof(zero));
+        if (s == 0)
+        {
+            uint32_t media[3] = {0x0FFFFFF8, FAT_EOC, FAT_EOC};
+            memcpy(zero, media, sizeof(media));
+        }
+        Disk_Write(Fs.fat_start + s, zero, FAT_CLUSTER);
+    }
+    memset(zero, 0, sizeof(zero));
+    Disk_Write(Fs.data_start, zero, FAT_CLUSTER);
+    Disk_Sync();
+    Fs.winsect = 0xFFFFFFFF;
+    Fs.wflag = 0;
+}
+
+/* 挂载WL_Flash,和重新上电一样从Flash恢复,缓冲区用上次申请的. */
+static void Fat_Mount(void)
+{
+    Fs.flash.cfg.start_addr = 0x00000000;
+    Fs.flash.cfg.full_mem_size = Fs.area;
+    Fs.flash.cfg.page_size = (Fs.page != 0) ? Fs.page : Fs.sim.info.EraseSize[0];
+    Fs.flash.cfg.sector_size = Fs.sim.info.EraseSize[0];
+    Fs.flash.cfg.wr_size = 0x00000010;
+    Fs.flash.cfg.version = 0x00000001;
+    Fs.flash.cfg.temp_buff_size = 0x00000020;
+    Fs.flash.cfg.trim_sectors = Fs.trim;
+    Fs.flash.ops = &NOR_Sim_WL_Ops;
+    Fs.flash.drv = &Fs.sim;
+    WL_Flash_Config(&Fs.flash);
+    if (Fs.merge && !WL_Disk_Init(&Fs.disk, &Fs.flash))
+    {
+        fprintf(stderr, "WL_Disk_Init failed\n");
+        exit(1);
+    }
+    Fs.winsect = 0xFFFFFFFF;
+    Fs.wflag = 0;
+}
+
+typedef struct
+{
+    uint64_t ns;
+    uint32_t erase;
+    uint64_t prog;
+    uint64_t reloc;
+} fat_mark_t;
+
+static void Fat_Mark(fat_mark_t *m)
+{
+    wl_flash_stats_t st;
+
+    WL_Flash_GetStats(&Fs.flash, &st, 0);
+    m->ns = Sim_Clock_Now();
+    m->erase = Fs.sim.erase_cmds;
+    m->prog = Fs.sim.prog_bytes;
+    m->reloc = st.reloc;
+}
+
+static void Fat_Report(const char *phase, const fat_mark_t *m, uint64_t bytes)
+{
+    fat_mark_t now;
+    double sec;
+
+    Fat_Mark(&now);
+    sec = (double)(now.ns - m->ns) / 1e9;
+    printf("%-9s %-6s %8.1f %10.1f %8u %10.1f %9.1f\n", phase, Fs.merge ? "disk" : "sector",
+           sec * 1000.0, ((bytes != 0) && (sec > 0)) ? (double)bytes / 1024.0 / sec : 0.0, (unsigned int)(now.erase - m->erase),
+           (double)(now.prog - m->prog) / 1024.0, (double)(now.reloc - m->reloc) / 1024.0);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t area = 0x00400000, files = 16, file_kb = 64, chunk = 4096, records = 1000, rec_len = 64, trim = 0, page = 0;
+    uint8_t atomic = 0;
+    int opt, failed = 0;
+
+    while ((opt = getopt(argc, argv, "s:n:k:w:r:l:t:p:a")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            area = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            files = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'k':
+            file_kb = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'w':
+            chunk = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            records = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            rec_len = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            trim = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            page = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'a':
+            atomic = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s area] [-n files] [-k file_kb] [-w write_chunk] [-r records] [-l record_len] [-t trim_sectors] [-p page_size] [-a]\n", argv[0]);
+            return 1;
+        }
+    }
+    if ((files == 0) || (files > FAT_MAX_FILES - 1) || (chunk == 0) || (chunk > 64 * 1024) || (rec_len == 0) || (rec_len > 64 * 1024))
+    {
+        fprintf(stderr, "files 1..%u, write_chunk and record_len 1..65536\n", (unsigned int)(FAT_MAX_FILES - 1));
+        return 1;
+    }
+
+    printf("area %u KB, %u files x %u KB, f_write %u B, log %u x %u B, trim_sectors %u", (unsigned int)(area / 1024),
+           (unsigned int)files, (unsigned int)file_kb, (unsigned int)chunk, (unsigned int)records, (unsigned int)rec_len,
+           (unsigned int)trim);
+    if (page != 0)
+    {
+        printf(", page %u KB", (unsigned int)(page / 1024));
+    }
+    printf("%s\n", atomic ? ", atomic" : "");
+    printf("phase     diskio     ms       KB/s    erase  prog KB   reloc KB\n");
+    for (int pass = 1; pass >= 0; pass--)
+    {
+        fat_mark_t m;
+        fat_file_t *log;
+        uint32_t bad = 0;
+        uint64_t total = 0;
+
+        Sim_Clock_Reset();
+        if (NOR_Sim_Init(&Fs.sim, area) != QSPI_OK)
+        {
+            fprintf(stderr, "flash init failed\n");
+            return 1;
+        }
+        Fs.merge = pass;
+        Fs.area = area;
+        Fs.trim = trim;
+        Fs.page = page;
+        Fs.disk.atomic = atomic;
+        Fat_Mount();
+        for (uint32_t i = 0; i <= files; i++)
+        {
+            Fs.file[i].dir = i;
+            Fs.file[i].seed = i * 7919 + 1;
+            Fs.file[i].start = 0;
+            Fs.file[i].size = 0;
+        }
+        log = &Fs.file[files];
+
+        Fat_Mark(&m);
+        Fat_Mkfs();
+        Fat_Report("mkfs", &m, 0);
+
+        Fat_Mark(&m);
+        for (uint32_t i = 0; i < files; i++)
+        {
+            Fat_Create_File(&Fs.file[i], file_kb * 1024, chunk);
+        }
+        Fat_Report("create", &m, (uint64_t)files * file_kb * 1024);
+
+        Fat_Mark(&m);
+        Fs.dirty = 0;
+        for (uint32_t i = 0; i < records; i++)
+        {
+            Fat_Write(log, log->size, rec_len);
+            Fat_Sync(log);
+        }
+        Fat_Report("append", &m, (uint64_t)records * rec_len);
+
+        Fat_Mark(&m);
+        for (uint32_t i = 0; i <= files; i++)
+        {
+            bad += Fat_Read(&Fs.file[i], 4096);
+            total += Fs.file[i].size;
+        }
+        Fat_Report("read", &m, total);
+
+        Fat_Mark(&m);
+        for (uint32_t i = 0; i < files; i++)
+        {
+            Fat_Rewrite_File(&Fs.file[i], chunk);
+        }
+        Fat_Report("rewrite", &m, (uint64_t)files * file_kb * 1024);
+
+        Fat_Mark(&m);
+        for (uint32_t i = 0; i < files; i++)
+        {
+            Fat_Unlink(&Fs.file[i]);
+        }
+        Fat_Report("unlink", &m, 0);
+
+        Fat_Mark(&m);
+        for (uint32_t i = 0; i < files; i++)
+        {
+            Fs.file[i].seed += 1000003; /* 删掉的目录项FatFs会再用 */
+            Fat_Create_File(&Fs.file[i], file_kb * 1024, chunk);
+        }
+        Fat_Report("recreate", &m, (uint64_t)files * file_kb * 1024);
+
+        Fat_Mount();
+        Fat_Mark(&m);
+        for (uint32_t i = 0; i <= files; i++)
+        {
+            bad += Fat_Read(&Fs.file[i], 4096);
+        }
+        Fat_Report("remount", &m, total);
+
+        if (bad != 0)
+        {
+            printf("%s: %u bytes read back wrong\n", Fs.merge ? "disk" : "sector", (unsigned int)bad);
+            failed = 1;
+        }
+        free(Fs.used);
+        NOR_Sim_DeInit(&Fs.sim);
+    }
+    return failed;
+}
@@ -0,0 +1,260 @@
+/**
+    描述: 解读板上WL_Prof导出的耗时直方图,打印每个阶段的次数,总时间,平均,p50/p99/最大延时和分布.
+    文件: WL_Prof.c
+    用法: wl_prof [-v] 导出文件
+          wl_prof -g 导出文件 [-s 区域大小] [-n 次数] [-w 负载]    (编译时要定义WL_FLASH_PROF)
+          p50/p99是从直方图估出来的,取所在桶的上界(不超过最大值),所以偏大,最多差一倍.
+          -v 打印每个阶段的直方图.
+          -g 不读文件,在仿真Flash上跑一段负载(每次擦一个Sector,写满,再读回来),把结果存成和板上一样的文件,
+             然后打印报告.编译时要加上测试工程的WL_Prof.c和-DWL_FLASH_PROF(见README).
+             仿真里只有Flash操作会让虚拟时钟走,所以translate这种纯计算的阶段全是0.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "NOR_Sim.h"
+#include "WL_Flash.h"
+#include "WL_Prof.h"
+#include "Sim_Workload.h"
+
+static const char *Prof_Name[WL_PROF_PHASES] =
+{
+    "translate",
+    "flash read",
+    "flash program",
+    "flash erase",
+    "relocate",
+    "marker/state",
+    "poll",
+    "WL_Flash_Read",
+    "WL_Flash_Write",
+    "WL_Flash_Erase_Range",
+    "cache hit",
+    "cache miss",
+    "prefetch wait",
+};
+
+/**
+  * @brief  从直方图估计分位数,取所在桶的上界.
+  * @param  q: 千分位,500就是p50.
+  * @retval 周期数.
+  */
+static uint64_t Prof_Quantile(const wl_prof_hist_t *hist, uint32_t q)
+{
+    uint64_t want = ((uint64_t)hist->count * q + 999) / 1000, seen = 0;
+
+    for (uint32_t i = 0; i < WL_PROF_BUCKETS; i++)
+    {
+        seen += hist->bucket[i];
+        if (seen >= want)
+        {
+            uint64_t upper = ((uint64_t)2 << i) - 1;
+            return (upper < hist->max) ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+/**
+  * @brief  打印报告.
+  * @param  verbose: 不为0时打印直方图.
+  */
+static void Prof_Report(const wl_prof_buf_t *buf, int verbose)
+{
+    double us = 1e6 / buf->clock_hz;
+
+    printf("clock %u Hz, phases nest (relocate contains erase/program, erase contains poll), so they do not add up\n",
+           (unsigned int)buf->clock_hz);
+    printf("%-21s %9s %12s %10s %10s %10s %12s\n", "phase", "count", "total_ms", "mean_us", "p50_us", "p99_us", "max_us");
+    for (uint32_t p = 0; p < WL_PROF_PHASES; p++)
+    {
+        const wl_prof_hist_t *hist = &buf->hist[p];
+        if (hist->count == 0)
+        {
+            continue;
+        }
+        printf("%-21s %9u %12.3f %10.3f %10.3f %10.3f %12.3f\n", Prof_Name[p], (unsigned int)hist->count,
+               hist->total * us / 1000, (double)hist->total / hist->count * us, Prof_Quantile(hist, 500) * us,
+               Prof_Quantile(hist, 990) * us, hist->max * us);
+    }
+    if (!verbose)
+    {
+        return;
+    }
+    for (uint32_t p = 0; p < WL_PROF_PHASES; p++)
+    {
+        const wl_prof_hist_t *hist = &buf->hist[p];
+        uint32_t peak = 0;
+        if (hist->count == 0)
+        {
+            continue;
+        }
+        printf("\n%s\n", Prof_Name[p]);
+        for (uint32_t i = 0; i < WL_PROF_BUCKETS; i++)
+        {
+            peak = (hist->bucket[i] > peak) ? hist->bucket[i] : peak;
+        }
+        for (uint32_t i = 0; i < WL_PROF_BUCKETS; i++)
+        {
+            if (hist->bucket[i] == 0)
+            {
+                continue;
+            }
+            /* 桶的范围,第0个桶从0开始. */
+            printf("  %12.3f - %12.3f us %9u ", ((i == 0) ? 0 : ((uint64_t)1 << i)) * us, (((uint64_t)2 << i) - 1) * us,
+                   (unsigned int)hist->bucket[i]);
+            for (uint32_t k = 0; k < (hist->bucket[i] * 40 + peak - 1) / peak; k++)
+            {
+                putchar('#');
+            }
+            putchar('\n');
+        }
+    }
+}
+
+#ifdef WL_FLASH_PROF
+/**
+  * @brief  在仿真Flash上跑负载,生成和板上一样的直方图.
+  * @param  area: 磨损平衡区域大小.
+  * @param  ops: 擦写多少个Sector.
+  * @param  load: 负载.
+  * @retval 0: 成功.
+  */
+static int Prof_Generate(uint32_t area, uint32_t ops, const sim_workload_t *load)
+{
+    nor_sim_t Sim;
+    wl_flash_t W;
+    uint8_t *buf;
+    uint32_t sectors, seed = 1;
+
+    Sim_Clock_Reset();
+    if (NOR_Sim_Init(&Sim, area) != QSPI_OK)
+    {
+        fprintf(stderr, "flash init failed\n");
+        return 1;
+    }
+    memset(&W, 0, sizeof(W));
+    W.cfg.start_addr = 0x00000000;
+    W.cfg.full_mem_size = area;
+    W.cfg.page_size = Sim.info.EraseSize[0];
+    W.cfg.sector_size = Sim.info.EraseSize[0];
+    W.cfg.wr_size = 0x00000010;
+    W.cfg.version = 0x00000001;
+    W.cfg.temp_buff_size = 0x00000020;
+    W.ops = &NOR_Sim_WL_Ops;
+    W.drv = &Sim;
+    WL_Flash_Config(&W);
+    WL_Flash_Format(&W, NULL);
+    sectors = W.flash_size / W.cfg.sector_size;
+    buf = (uint8_t *)malloc(W.cfg.sector_size);
+    memset(buf, 0x5A, W.cfg.sector_size);
+
+    /* 挂载和格式化不算. */
+    WL_Prof_Init();
+    for (uint32_t i = 0; i < ops; i++)
+    {
+        uint32_t addr = load->next(&seed, i, sectors) * W.cfg.sector_size;
+        WL_Flash_Erase_Range(&W, addr, W.cfg.sector_size);
+        WL_Flash_Write(&W, addr, buf, W.cfg.sector_size);
+        WL_Flash_Read(&W, addr, buf, W.cfg.sector_size);
+    }
+
+    free(buf);
+    vPortFree(W.temp_buff);
+    NOR_Sim_DeInit(&Sim);
+    return 0;
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    static wl_prof_buf_t buf;
+    uint32_t area = 0x00100000, ops = 1000;
+    const char *gen = NULL, *load = "uniform";
+    int verbose = 0, opt;
+    FILE *f;
+
+    while ((opt = getopt(argc, argv, "vg:s:n:w:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'v':
+            verbose = 1;
+            break;
+        case 'g':
+            gen = optarg;
+            break;
+        case 's':
+            area = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            ops = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'w':
+            load = optarg;
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (gen != NULL)
+    {
+#ifdef WL_FLASH_PROF
+        const sim_workload_t *w = Sim_Workload_Find(load);
+        if (w == NULL)
+        {
+            fprintf(stderr, "unknown workload %s\n", load);
+            return 1;
+        }
+        if (Prof_Generate(area, ops, w) != 0)
+        {
+            return 1;
+        }
+        buf = WL_Prof_Buf;
+        f = fopen(gen, "wb");
+        if ((f == NULL) || (fwrite(&buf, sizeof(buf), 1, f) != 1))
+        {
+            fprintf(stderr, "%s: write failed\n", gen);
+            return 1;
+        }
+        fclose(f);
+#else
+        (void)area;
+        (void)ops;
+        (void)load;
+        fprintf(stderr, "-g needs -DWL_FLASH_PROF and WL_Prof.c from the test project\n");
+        return 1;
+#endif
+    }
+    else
+    {
+        if (optind != argc - 1)
+        {
+            fprintf(stderr, "usage: %s [-v] dump.bin\n       %s -g dump.bin [-s area] [-n ops] [-w workload]\n", argv[0], argv[0]);
+            return 1;
+        }
+        f = fopen(argv[optind], "rb");
+        if ((f == NULL) || (fread(&buf, sizeof(buf), 1, f) != 1))
+        {
+            fprintf(stderr, "%s: cannot read\n", argv[optind]);
+            return 1;
+        }
+        fclose(f);
+        if ((buf.magic != WL_PROF_MAGIC) || (buf.version != WL_PROF_VERSION) || (buf.phases != WL_PROF_PHASES) ||
+            (buf.buckets != WL_PROF_BUCKETS) || (buf.clock_hz == 0))
+        {
+            fprintf(stderr, "%s: not a WL_Prof dump\n", argv[optind]);
+            return 1;
+        }
+    }
+
+    Prof_Report(&buf, verbose);
+    return 0;
+}
@@ -0,0 +1,308 @@
+/**
+    描述: 把板上WL_Trace记下来的访问记录在仿真Flash上回放,对比每种操作的延时,统计擦除次数.
+    文件: WL_Replay.c
+    用法: wl_replay 记录文件 [-s 容量] [-i 镜像文件] [-t 丢弃位图sector数] [-C 行大小,组数,每组行数] [-w 写缓冲大小] [-R 块大小,块数,流数] [-r]
+          默认回放WL_Flash_xxx这一层的调用,走PC上的WL_Flash.c,可以看改了算法以后的效果.
+          -r 直接回放驱动层的读写擦,不经过WL_Flash,和板上当时的Flash操作一模一样.
+          -i 在已有的仿真镜像上回放(见NOR_Sim_Open),不给就是一片新的Flash.
+          -t 和板上一样留几个sector存丢弃位图(cfg.trim_sectors),记录里的WL_Flash_Discard才有用,
+             不给的话丢弃全部忽略,两次对比就是丢弃省下的挪dummy复制量.
+          -C/-w/-R 和板上一样打开读缓存,写缓冲和顺序预读(参数和wl_bench一样),记录里没有这些配置,不给就是都不开.
+          WL_Flash_xxx里面嵌套的WL_Flash_xxx(WL_Flash_Update里的WL_Flash_Write,写缓冲满了的WL_Flash_Sync)
+          不单独回放,外层的调用自己会做.记录里没有数据,WL_Flash_Update/WL_Flash_Program每次按内容变了算,
+          写的是记录的序号,所以每次都要改写,是最坏情况.
+          两次操作之间的空闲时间按记录里的时间戳推进虚拟时钟.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "NOR_Sim.h"
+#include "WL_Flash.h"
+#include "WL_Trace.h"
+
+#define REPLAY_OPS 0x20 /* 操作类型的个数上限 */
+
+typedef struct
+{
+    uint32_t count;
+    uint64_t rec_ns; /* 板上的总延时 */
+    uint64_t rec_max;
+    uint64_t sim_ns; /* 仿真的总延时 */
+    uint64_t sim_max;
+} replay_stat_t;
+
+static const char *Replay_Name(uint8_t op)
+{
+    switch (op)
+    {
+    case WL_TRACE_WL_READ:       return "WL_Flash_Read";
+    case WL_TRACE_WL_WRITE:      return "WL_Flash_Write";
+    case WL_TRACE_WL_ERASE:      return "WL_Flash_Erase_Range";
+    case WL_TRACE_WL_FORMAT:     return "WL_Flash_Format";
+    case WL_TRACE_WL_DISCARD:    return "WL_Flash_Discard";
+    case WL_TRACE_WL_PROGRAM:    return "WL_Flash_Program";
+    case WL_TRACE_WL_UPDATE:     return "WL_Flash_Update";
+    case WL_TRACE_WL_SYNC:       return "WL_Flash_Sync";
+    case WL_TRACE_FLASH_READ:    return "flash read";
+    case WL_TRACE_FLASH_PROGRAM: return "flash program";
+    case WL_TRACE_FLASH_ERASE:   return "flash erase";
+    case WL_TRACE_FLASH_CHIP:    return "flash chip erase";
+    default:                     return "?";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    nor_sim_t Sim;
+    wl_flash_t W;
+    wl_trace_hdr_t hdr;
+    wl_trace_rec_t *rec;
+    replay_stat_t stat[REPLAY_OPS];
+    uint32_t size = N25Q128A_FLASH_SIZE, n, first, last_time = 0, trim = 0;
+    const char *image = NULL;
+    int raw = 0, opt;
+    uint8_t *buf;
+    uint64_t now = 0, start_time = 0, idle_from = 0, sim_start = 0;
+    uint8_t pending = 0, have_end = 0;
+    uint32_t depth = 0;
+    uint32_t max_count = 0, used_blocks = 0;
+    uint64_t sum = 0;
+    FILE *f;
+
+    memset(&W, 0, sizeof(W));
+    while ((opt = getopt(argc, argv, "s:i:t:C:w:R:r")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            size = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            image = optarg;
+            break;
+        case 't':
+            trim = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'C':
+            if (sscanf(optarg, "%u,%u,%u", &W.cache_line_size, &W.cache_sets, &W.cache_ways) != 3)
+            {
+                optind = argc;
+            }
+            break;
+        case 'w':
+            W.wb_size = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'R':
+            if (sscanf(optarg, "%u,%u,%u", &W.ra_size, &W.ra_depth, &W.ra_streams) != 3)
+            {
+                optind = argc;
+            }
+            break;
+        case 'r':
+            raw = 1;
+            break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, "usage: %s trace.bin [-s size] [-i image] [-t trim_sectors] [-C line,sets,ways] [-w wb_size] [-R size,depth,streams] [-r]\n", argv[0]);
+        return 1;
+    }
+
+    /* 读记录文件,整个就是WL_Trace_Buf. */
+    f = fopen(argv[optind], "rb");
+    if ((f == NULL) || (fread(&hdr, sizeof(hdr), 1, f) != 1) || (hdr.magic != WL_TRACE_MAGIC) ||
+        (hdr.version != WL_TRACE_VERSION) || (hdr.rec_size != sizeof(wl_trace_rec_t)) || (hdr.clock_hz == 0))
+    {
+        fprintf(stderr, "%s: not a WL_Trace dump\n", argv[optind]);
+        return 1;
+    }
+    rec = (wl_trace_rec_t *)malloc(sizeof(wl_trace_rec_t) * hdr.capacity);
+    if ((rec == NULL) || (fread(rec, sizeof(wl_trace_rec_t), hdr.capacity, f) != hdr.capacity))
+    {
+        fprintf(stderr, "%s: truncated\n", argv[optind]);
+        return 1;
+    }
+    fclose(f);
+    /* 覆盖过的话,最旧的一条在head. */
+    n = (hdr.total < hdr.capacity) ? hdr.total : hdr.capacity;
+    first = (hdr.total > hdr.capacity) ? hdr.head : 0;
+
+    Sim_Clock_Reset();
+    if (((image != NULL) ? NOR_Sim_Open(&Sim, image, size) : NOR_Sim_Init(&Sim, size)) != QSPI_OK)
+    {
+        fprintf(stderr, "flash init failed\n");
+        return 1;
+    }
+    W.cfg.start_addr = 0x00000000;
+    W.cfg.full_mem_size = Sim.info.FlashSize;
+    W.cfg.page_size = Sim.info.EraseSize[0];
+    W.cfg.sector_size = Sim.info.EraseSize[0];
+    W.cfg.wr_size = 0x00000010;
+    W.cfg.version = 0x00000001;
+    W.cfg.temp_buff_size = 0x00000020;
+    W.cfg.trim_sectors = trim;
+    W.ops = &NOR_Sim_WL_Ops;
+    W.drv = &Sim;
+    if (!raw)
+    {
+        WL_Flash_Config(&W);
+    }
+    memset(stat, 0, sizeof(stat));
+    buf = (uint8_t *)malloc(size);
+    memset(buf, 0x5A, size);
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        wl_trace_rec_t *r = &rec[(first + i) % hdr.capacity];
+        uint8_t op = r->op & ~WL_TRACE_DONE;
+        uint8_t wl_op = (op < WL_TRACE_FLASH_READ);
+
+        /* CYCCNT只有32位,按相邻两条的差值累加成64位时间. */
+        now += (i == 0) ? 0 : (uint32_t)(r->time - last_time);
+        last_time = r->time;
+        if ((op >= REPLAY_OPS) || (wl_op == raw))
+        {
+            continue;
+        }
+        if ((r->op & WL_TRACE_DONE) != 0)
+        {
+            if (depth != 0)
+            {
+                depth--;
+                continue;
+            }
+            /* 开头被覆盖掉的操作只有结束记录,跳过. */
+            if (pending == op)
+            {
+                uint64_t rec_ns = (now - start_time) * 1000000000 / hdr.clock_hz;
+                stat[op].rec_ns += rec_ns;
+                stat[op].rec_max = (rec_ns > stat[op].rec_max) ? rec_ns : stat[op].rec_max;
+                idle_from = now;
+                have_end = 1;
+            }
+            pending = 0;
+            continue;
+        }
+        /* 外层的WL操作还没结束,这是它里面调的,回放外层的时候会做. */
+        if (wl_op && (pending != 0))
+        {
+            depth++;
+            continue;
+        }
+
+        /* 空闲时间照搬,时钟拨到和板上一样的间隔. */
+        if (have_end)
+        {
+            Sim_Clock_Advance((now - idle_from) * 1000000000 / hdr.clock_hz);
+        }
+        start_time = now;
+        pending = op;
+        sim_start = Sim_Clock_Now();
+        if ((uint64_t)r->addr + r->size > size)
+        {
+            fprintf(stderr, "record %u: 0x%08X + 0x%X out of range, use -s\n", (unsigned int)i, (unsigned int)r->addr, (unsigned int)r->size);
+            pending = 0;
+            continue;
+        }
+        switch (op)
+        {
+        case WL_TRACE_WL_READ:
+            WL_Flash_Read(&W, r->addr, buf, r->size);
+            break;
+        case WL_TRACE_WL_WRITE:
+            WL_Flash_Write(&W, r->addr, buf, r->size);
+            break;
+        case WL_TRACE_WL_ERASE:
+            WL_Flash_Erase_Range(&W, r->addr, r->size);
+            break;
+        case WL_TRACE_WL_FORMAT:
+            WL_Flash_Format(&W, NULL);
+            break;
+        case WL_TRACE_WL_DISCARD:
+            WL_Flash_Discard(&W, r->addr, r->size);
+            break;
+        case WL_TRACE_WL_PROGRAM:
+        case WL_TRACE_WL_UPDATE:
+            memset(buf, (uint8_t)i, r->size);
+            if (op == WL_TRACE_WL_PROGRAM)
+            {
+                WL_Flash_Program(&W, r->addr, buf, r->size);
+            }
+            else
+            {
+                WL_Flash_Update(&W, r->addr, buf, r->size);
+            }
+            break;
+        case WL_TRACE_WL_SYNC:
+            WL_Flash_Sync(&W);
+            break;
+        case WL_TRACE_FLASH_READ:
+            NOR_Sim_WL_Ops.read(&Sim, r->addr, buf, r->size);
+            break;
+        case WL_TRACE_FLASH_PROGRAM:
+            NOR_Sim_WL_Ops.program(&Sim, r->addr, buf, r->size);
+            break;
+        case WL_TRACE_FLASH_ERASE:
+            NOR_Sim_WL_Ops.erase(&Sim, r->addr, r->size);
+            break;
+        case WL_TRACE_FLASH_CHIP:
+            /* 板上是发了指令再查状态,这里直接等做完. */
+            NOR_Sim_Erase_Chip_Start(&Sim);
+            while (NOR_Sim_GetStatus(&Sim) == QSPI_BUSY)
+            {
+                vTaskDelay(1);
+            }
+            break;
+        default:
+            break;
+        }
+        stat[op].count++;
+        stat[op].sim_ns += Sim_Clock_Now() - sim_start;
+        stat[op].sim_max = ((Sim_Clock_Now() - sim_start) > stat[op].sim_max) ? (Sim_Clock_Now() - sim_start) : stat[op].sim_max;
+    }
+
+    printf("%u records (%u dropped), %.3f s on target, %.3f s simulated\n", (unsigned int)n,
+           (unsigned int)(hdr.total - n), (double)now / hdr.clock_hz, Sim_Clock_Now() / 1e9);
+    printf("%-22s %8s %12s %12s %12s %12s\n", "op", "count", "target avg", "sim avg", "target max", "sim max");
+    for (uint32_t op = 0; op < REPLAY_OPS; op++)
+    {
+        if (stat[op].count == 0)
+        {
+            continue;
+        }
+        printf("%-22s %8u %10.1fus %10.1fus %10.1fus %10.1fus\n", Replay_Name((uint8_t)op), (unsigned int)stat[op].count,
+               stat[op].rec_ns / 1e3 / stat[op].count, stat[op].sim_ns / 1e3 / stat[op].count,
+               stat[op].rec_max / 1e3, stat[op].sim_max / 1e3);
+    }
+    for (uint32_t i = 0; i < Sim.block_count; i++)
+    {
+        max_count = (Sim.erase_count[i] > max_count) ? Sim.erase_count[i] : max_count;
+        used_blocks += (Sim.erase_count[i] != 0);
+        sum += Sim.erase_count[i];
+    }
+    printf("erases: %llu total, max %u per block, %u of %u blocks touched, flash errors %u\n",
+           (unsigned long long)sum, (unsigned int)max_count, (unsigned int)used_blocks,
+           (unsigned int)Sim.block_count, (unsigned int)Sim.errors);
+    if (!raw)
+    {
+        wl_flash_stats_t st;
+        /* 定义WL_FLASH_NO_STATS时全是0. */
+        WL_Flash_GetStats(&W, &st, 0);
+        printf("relocation: %llu KB copied, %llu KB skipped as discarded\n",
+               (unsigned long long)(st.reloc / 1024), (unsigned long long)(st.discard_skipped / 1024));
+    }
+
+    free(buf);
+    free(rec);
+    NOR_Sim_DeInit(&Sim);
+    return Sim.errors != 0;
+}
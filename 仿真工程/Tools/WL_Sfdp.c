@@ -0,0 +1,142 @@
+/**
+    描述: SFDP解析测试.拿几颗Flash实际读出来的SFDP跑BSP_QSPI_Parse_SFDP和BSP_QSPI_Select_Prog,和手算的结果对比.
+    文件: WL_Sfdp.c
+    用法: wl_sfdp
+          N25Q128A和W25Q128JV是芯片上读出来的(只留头和基本参数表前9个DWORD,和BSP_QSPI_Read_SPDF读的一样),
+          还有一颗只支持1-1-1的2MB Flash,和一个签名不对的表(应该不解析,参数不变).
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "N25Q128.h"
+
+typedef struct
+{
+    const char *name;
+    uint8_t manufacturer;            /* 0x9F读到的厂商ID */
+    BSP_QSPI_SFDP_TypeDef sfdp;
+    uint8_t ret;                     /* BSP_QSPI_Parse_SFDP应该返回的 */
+    uint8_t dtr;                     /* DtrRead应该是 */
+    BSP_QSPI_Info_TypeDef expect;
+} sfdp_case_t;
+
+/* BSP_QSPI_Info的默认值,和N25Q128.c一样. */
+#define SFDP_DEFAULT_INFO \
+    { N25Q128A_FLASH_SIZE, N25Q128A_PAGE_SIZE, 3, QUAD_INOUT_FAST_READ_CMD, N25Q128A_DUMMY_CYCLES_READ_QUAD, 0, \
+      QSPI_ADDRESS_4_LINES, QSPI_DATA_4_LINES, EXT_QUAD_IN_FAST_PROG_CMD, QSPI_ADDRESS_4_LINES, QSPI_DATA_4_LINES, \
+      { SUBSECTOR_ERASE_CMD, SECTOR_ERASE_CMD, 0, 0 }, { N25Q128A_SUBSECTOR_SIZE, N25Q128A_SECTOR_SIZE, 0, 0 } }
+
+static const sfdp_case_t Sfdp_Cases[] =
+{
+    {
+        /* 1-4-4是EB,等待9周期+mode 1周期(4线只有4位,凑不成交替字节,驱动里还是当dummy).SFDP里没写DTR,是Micron就算支持. */
+        "N25Q128A", 0x20,
+        { BSP_QSPI_SFDP_SIGNATURE, 0x0100, 0x00, 0xFF, 0x00, 0x00, 0x01, 9, 0x000030,
+          { 0xFFF120E5, 0x07FFFFFF, 0x6B27EB29, 0xBB273B27, 0xFFFFFFFF, 0xFFFFFFFF, 0xBB27FFFF, 0xEB29FFFF, 0xD810200C } },
+        QSPI_OK, 1,
+        { 0x01000000, N25Q128A_PAGE_SIZE, 3, 0xEB, 9, 1, QSPI_ADDRESS_4_LINES, QSPI_DATA_4_LINES,
+          EXT_QUAD_IN_FAST_PROG_CMD, QSPI_ADDRESS_4_LINES, QSPI_DATA_4_LINES, { 0x20, 0xD8, 0, 0 }, { 0x1000, 0x10000, 0, 0 } }
+    },
+    {
+        /* 1-4-4是EB,等待4周期+mode 2周期(正好一个交替字节);擦除4K/32K/64K;0x12在W25Q上不是4线编程;SFDP里写了DTR. */
+        "W25Q128JV", 0xEF,
+        { BSP_QSPI_SFDP_SIGNATURE, 0x0105, 0x00, 0xFF, 0x00, 0x05, 0x01, 16, 0x000080,
+          { 0xFFF920E5, 0x07FFFFFF, 0x6B08EB44, 0xBB423B08, 0xFFFFFFFE, 0x0000FFFF, 0xEB40FFFF, 0x520F200C, 0x0000D810 } },
+        QSPI_OK, 1,
+        { 0x01000000, N25Q128A_PAGE_SIZE, 3, 0xEB, 4, 2, QSPI_ADDRESS_4_LINES, QSPI_DATA_4_LINES,
+          PAGE_PROG_CMD, QSPI_ADDRESS_1_LINE, QSPI_DATA_1_LINE, { 0x20, 0x52, 0xD8, 0 }, { 0x1000, 0x8000, 0x10000, 0 } }
+    },
+    {
+        /* 快速读写都没有,只能用1-1-1的0x0B. */
+        "1-1-1 only", 0x1F,
+        { BSP_QSPI_SFDP_SIGNATURE, 0x0100, 0x00, 0xFF, 0x00, 0x00, 0x01, 9, 0x000030,
+          { 0xFF8020E5, 0x00FFFFFF, 0x00000000, 0x00000000, 0xFFFFFFEE, 0xFFFFFFFF, 0x0000FFFF, 0x520F200C, 0xFF00D810 } },
+        QSPI_OK, 0,
+        { 0x00200000, N25Q128A_PAGE_SIZE, 3, FAST_READ_CMD, N25Q128A_DUMMY_CYCLES_READ, 0, QSPI_ADDRESS_1_LINE, QSPI_DATA_1_LINE,
+          PAGE_PROG_CMD, QSPI_ADDRESS_1_LINE, QSPI_DATA_1_LINE, { 0x20, 0x52, 0xD8, 0 }, { 0x1000, 0x8000, 0x10000, 0 } }
+    },
+    {
+        /* 没有SFDP读出来全是FF,读参数保持默认,编程指令还是按厂商ID选,不是Micron不用DTR. */
+        "no SFDP", 0xC2,
+        { 0xFFFFFFFF, 0xFFFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFFFFFF,
+          { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF } },
+        QSPI_NOT_SUPPORTED, 0,
+        { N25Q128A_FLASH_SIZE, N25Q128A_PAGE_SIZE, 3, QUAD_INOUT_FAST_READ_CMD, N25Q128A_DUMMY_CYCLES_READ_QUAD, 0,
+          QSPI_ADDRESS_4_LINES, QSPI_DATA_4_LINES, PAGE_PROG_CMD, QSPI_ADDRESS_1_LINE, QSPI_DATA_1_LINE,
+          { SUBSECTOR_ERASE_CMD, SECTOR_ERASE_CMD, 0, 0 }, { N25Q128A_SUBSECTOR_SIZE, N25Q128A_SECTOR_SIZE, 0, 0 } }
+    },
+};
+
+#define SFDP_COUNT(x) (sizeof(x) / sizeof((x)[0]))
+
+/* 线数换成1/2/4,打印用. */
+static unsigned int Sfdp_Lines(uint32_t mode)
+{
+    return (mode == QSPI_ADDRESS_4_LINES) || (mode == QSPI_DATA_4_LINES) ? 4 :
+           ((mode == QSPI_ADDRESS_2_LINES) || (mode == QSPI_DATA_2_LINES) ? 2 : 1);
+}
+
+/* 逐项对比,不对的打印出来. */
+static int Sfdp_Check(const char *what, uint32_t got, uint32_t expect)
+{
+    if (got != expect)
+    {
+        printf("    %s: got 0x%X, expect 0x%X\n", what, (unsigned int)got, (unsigned int)expect);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+
+    for (uint32_t c = 0; c < SFDP_COUNT(Sfdp_Cases); c++)
+    {
+        const sfdp_case_t *t = &Sfdp_Cases[c];
+        BSP_QSPI_Info_TypeDef info = SFDP_DEFAULT_INFO;
+        uint8_t ret;
+        int bad = 0;
+
+        ret = BSP_QSPI_Parse_SFDP(&t->sfdp, &info);
+        BSP_QSPI_Select_Prog(t->manufacturer, &info);
+
+        printf("%-10s size %5uK addr %u | read 0x%02X 1-%u-%u dummy %u mode %u dtr %u | prog 0x%02X 1-%u-%u | erase",
+               t->name, (unsigned int)(info.FlashSize >> 10), (unsigned int)info.AddressBytes, (unsigned int)info.ReadCmd,
+               Sfdp_Lines(info.ReadAddressMode), Sfdp_Lines(info.ReadDataMode), (unsigned int)info.ReadDummyCycles,
+               (unsigned int)info.ReadModeCycles, (unsigned int)info.DtrRead, (unsigned int)info.ProgCmd, Sfdp_Lines(info.ProgAddressMode),
+               Sfdp_Lines(info.ProgDataMode));
+        for (uint32_t i = 0; (i < BSP_QSPI_ERASE_TYPES) && (info.EraseSize[i] != 0); i++)
+        {
+            printf(" %uK/0x%02X", (unsigned int)(info.EraseSize[i] >> 10), (unsigned int)info.EraseCmd[i]);
+        }
+        printf("\n");
+
+        bad += Sfdp_Check("return", ret, t->ret);
+        bad += Sfdp_Check("FlashSize", info.FlashSize, t->expect.FlashSize);
+        bad += Sfdp_Check("PageSize", info.PageSize, t->expect.PageSize);
+        bad += Sfdp_Check("AddressBytes", info.AddressBytes, t->expect.AddressBytes);
+        bad += Sfdp_Check("ReadCmd", info.ReadCmd, t->expect.ReadCmd);
+        bad += Sfdp_Check("ReadDummyCycles", info.ReadDummyCycles, t->expect.ReadDummyCycles);
+        bad += Sfdp_Check("ReadModeCycles", info.ReadModeCycles, t->expect.ReadModeCycles);
+        bad += Sfdp_Check("ReadAddressMode", info.ReadAddressMode, t->expect.ReadAddressMode);
+        bad += Sfdp_Check("ReadDataMode", info.ReadDataMode, t->expect.ReadDataMode);
+        bad += Sfdp_Check("ProgCmd", info.ProgCmd, t->expect.ProgCmd);
+        bad += Sfdp_Check("ProgAddressMode", info.ProgAddressMode, t->expect.ProgAddressMode);
+        bad += Sfdp_Check("ProgDataMode", info.ProgDataMode, t->expect.ProgDataMode);
+        bad += Sfdp_Check("Manufacturer", info.Manufacturer, t->manufacturer);
+        bad += Sfdp_Check("DtrRead", info.DtrRead, t->dtr);
+        for (uint32_t i = 0; i < BSP_QSPI_ERASE_TYPES; i++)
+        {
+            bad += Sfdp_Check("EraseSize", info.EraseSize[i], t->expect.EraseSize[i]);
+            bad += Sfdp_Check("EraseCmd", info.EraseCmd[i], t->expect.EraseCmd[i]);
+        }
+        fails += (bad != 0);
+    }
+
+    printf("%u tables, %d failed\n", (unsigned int)SFDP_COUNT(Sfdp_Cases), fails);
+    return fails != 0;
+}
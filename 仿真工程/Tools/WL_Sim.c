@@ -0,0 +1,99 @@
+/**
+    描述: PC仿真主程序,和测试工程的MWL_Main做一样的事情,最后打印虚拟时钟下的速度和擦除次数.
+    文件: WL_Sim.c
+    用法: wl_sim [循环次数] [镜像文件] [容量]
+          给了镜像文件就放在mmap文件里,停下来再用同样的参数运行就接着跑.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NOR_Sim.h"
+#include "WL_Flash.h"
+
+nor_sim_t Sim;
+wl_flash_t MWL_Flash;
+
+uint8_t pBuf[12 * 1024];
+uint8_t aBuf[12 * 1024];
+
+int main(int argc, char *argv[])
+{
+    uint32_t loops = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 1000;
+    uint64_t erase_ns = 0, write_ns = 0, read_ns = 0, t;
+    uint32_t max_count = 0, min_count = 0xFFFFFFFF, bad = 0;
+    uint32_t size = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 0) : N25Q128A_FLASH_SIZE;
+    uint8_t ret = (argc > 2) ? NOR_Sim_Open(&Sim, argv[2], size) : NOR_Sim_Init(&Sim, size);
+
+    if (ret != QSPI_OK)
+    {
+        printf("flash init failed\n");
+        return 1;
+    }
+
+    MWL_Flash.cfg.start_addr = 0x00000000;
+    MWL_Flash.cfg.full_mem_size = Sim.info.FlashSize;
+    MWL_Flash.cfg.page_size = Sim.info.EraseSize[0];
+    MWL_Flash.cfg.sector_size = Sim.info.EraseSize[0];
+    MWL_Flash.cfg.wr_size = 0x00000010;
+    MWL_Flash.cfg.version = 0x00000001;
+    MWL_Flash.cfg.temp_buff_size = 0x00000020;
+    MWL_Flash.ops = &NOR_Sim_WL_Ops;
+    MWL_Flash.drv = &Sim;
+
+    WL_Flash_Config(&MWL_Flash);
+
+    for (uint32_t i = 0; i < 5 * 1024; i++)
+    {
+        pBuf[i] = 0xFF & i;
+    }
+
+    for (uint32_t i = 0; i < loops; i++)
+    {
+        pBuf[0] = pBuf[0] + 5;
+
+        t = Sim_Clock_Now();
+        WL_Flash_Erase_Range(&MWL_Flash, 0x00000000, 12 * 1024);
+        erase_ns += Sim_Clock_Now() - t;
+
+        t = Sim_Clock_Now();
+        WL_Flash_Write(&MWL_Flash, 0x00000000, pBuf, 12 * 1024);
+        write_ns += Sim_Clock_Now() - t;
+
+        t = Sim_Clock_Now();
+        WL_Flash_Read(&MWL_Flash, 0x00000000, aBuf, 12 * 1024);
+        read_ns += Sim_Clock_Now() - t;
+
+        if (memcmp(pBuf, aBuf, sizeof(aBuf)) != 0)
+        {
+            bad++;
+        }
+        /* 文件模式时不时存一下时钟和统计,中途被杀掉也能接着跑. */
+        if ((i % 1000) == 999)
+        {
+            NOR_Sim_Sync(&Sim);
+        }
+    }
+
+    for (uint32_t i = 0; i < Sim.block_count; i++)
+    {
+        max_count = (Sim.erase_count[i] > max_count) ? Sim.erase_count[i] : max_count;
+        min_count = (Sim.erase_count[i] < min_count) ? Sim.erase_count[i] : min_count;
+    }
+
+    printf("loops         : %u (mismatch %u, flash errors %u)\n", (unsigned int)loops, (unsigned int)bad, (unsigned int)Sim.errors);
+    printf("virtual time  : %.3f s\n", Sim_Clock_Now() / 1e9);
+    printf("erase 12K     : %.3f ms/op\n", loops ? erase_ns / 1e6 / loops : 0.0);
+    printf("write 12K     : %.1f KB/s\n", write_ns ? 12.0 * loops / (write_ns / 1e9) : 0.0);
+    printf("read 12K      : %.1f KB/s\n", read_ns ? 12.0 * loops / (read_ns / 1e9) : 0.0);
+    printf("flash cmds    : read %u, program %u, erase %u\n", (unsigned int)Sim.read_cmds, (unsigned int)Sim.prog_cmds, (unsigned int)Sim.erase_cmds);
+    printf("erase count   : min %u, max %u, pos %u, move_count %u\n", (unsigned int)min_count, (unsigned int)max_count,
+           (unsigned int)MWL_Flash.state.pos, (unsigned int)MWL_Flash.state.move_count);
+
+    ret = (bad != 0) || (Sim.errors != 0);
+    NOR_Sim_DeInit(&Sim);
+    return ret;
+}
@@ -0,0 +1,347 @@
+/**
+    描述: 参数扫描,把一组配置 x 负载分给所有CPU核同时跑磨损仿真,输出CSV或者JSON表.
+    文件: WL_Sweep.c
+    用法: wl_sweep [-j 线程数] [-e 仿真寿命] [-s 种子] [-f csv|json] [-o 输出文件]
+          扫描的容量,缓冲大小,冗余比例,Page/sector大小在下面的表里改.
+          挪dummy是每擦一个sector挪一次,没有可调的频率,所以不扫这一项.
+          每个任务的种子只和总种子,任务序号有关,结果按任务序号输出,所以和线程数,调度顺序都没有关系.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "NOR_Sim.h"
+#include "WL_Flash.h"
+#include "Sim_Workload.h"
+
+#define SWEEP_RATED_CYCLES 100000 /* N25Q128A的擦写寿命 */
+#define SWEEP_MAX_THREADS  256
+
+/* 扫描的参数,任务数 = 各个表长度的乘积 x 负载数. */
+static const uint32_t Sweep_Sizes[] = { 0x00020000, 0x00040000, 0x00080000 }; /* full_mem_size */
+static const uint32_t Sweep_Buffers[] = { 0x00000020, 0x00000100, 0x00001000 }; /* temp_buff_size */
+static const uint32_t Sweep_Spare[] = { 0, 50 }; /* 负载不用的逻辑空间(%),就是冗余比例 */
+/* page_size,sector_size.sector_size不能比page_size大,而且要是芯片的擦除大小(N25Q128A是4K和64K),64K的话最小的区域放不下. */
+static const uint32_t Sweep_Geometry[][2] =
+{
+    { 0x00001000, 0x00001000 }, { 0x00002000, 0x00001000 }, { 0x00004000, 0x00001000 }
+};
+
+#define SWEEP_COUNT(x) (sizeof(x) / sizeof((x)[0]))
+
+typedef struct
+{
+    /* 输入 */
+    wl_config_t cfg;
+    const sim_workload_t *load;
+    uint32_t spare;
+    uint32_t seed;
+    /* 输出 */
+    uint32_t ops; /* 到达寿命前的用户改写次数 */
+    double lifetime_gb; /* 按100K寿命折算的写入量 */
+    double write_kbs; /* 虚拟时钟下的改写速度(擦+写) */
+    double wa_erase; /* 擦除写放大 */
+    double wa_prog; /* 编程写放大 */
+    double wear_ratio; /* 平均/最大擦除次数 */
+    uint32_t errors; /* 读回不对或者仿真Flash报错 */
+} sweep_job_t;
+
+/* 每个线程一个任务队列,自己从尾部取,空了就从别人头部偷. */
+typedef struct
+{
+    pthread_mutex_t lock;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t *jobs;
+} sweep_queue_t;
+
+static sweep_job_t *Sweep_Jobs;
+static uint32_t Sweep_JobCount;
+static sweep_queue_t Sweep_Queues[SWEEP_MAX_THREADS];
+static uint32_t Sweep_Threads;
+static uint32_t Sweep_Endurance = 500;
+
+/* 结果汇总,只用来打印进度,结果本身写在各自的任务里. */
+static pthread_mutex_t Sweep_SinkLock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t Sweep_Done;
+
+/**
+  * @brief  从一个种子派生出每个任务自己的种子(splitmix),保证不是0.
+  * @param  seed: 总种子.
+  * @param  index: 任务序号.
+  * @retval 任务种子
+  */
+static uint32_t Sweep_Seed(uint32_t seed, uint32_t index)
+{
+    uint64_t z = ((uint64_t)seed << 32) + (index + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return ((uint32_t)z != 0) ? (uint32_t)z : 1;
+}
+
+/**
+  * @brief  跑一个任务,直到第一个块到达寿命.
+  * @param  job: 任务.
+  */
+static void Sweep_Run(sweep_job_t *job)
+{
+    nor_sim_t Sim;
+    wl_flash_t W;
+    uint8_t *buf, *check;
+    uint32_t sectors, used, max_count = 0, op = 0;
+    uint32_t seed = job->seed;
+    uint64_t sum = 0, busy_ns = 0, t;
+
+    Sim_Clock_Reset();
+    if (NOR_Sim_Init(&Sim, job->cfg.full_mem_size) != QSPI_OK)
+    {
+        job->errors = 1;
+        return;
+    }
+    memset(&W, 0, sizeof(W));
+    W.cfg = job->cfg;
+    W.ops = &NOR_Sim_WL_Ops;
+    W.drv = &Sim;
+    WL_Flash_Config(&W);
+
+    sectors = W.flash_size / W.cfg.sector_size;
+    used = sectors * (100 - job->spare) / 100;
+    used = (used < 3) ? 3 : used;
+    buf = (uint8_t *)malloc(W.cfg.sector_size);
+    check = (uint8_t *)malloc(W.cfg.sector_size);
+    Sim.erase_bytes = 0;
+    Sim.prog_bytes = 0;
+
+    /* 仿真Flash报错(比如擦除大小不对,擦不动)就停下,不然永远到不了寿命. */
+    while ((max_count < Sweep_Endurance) && (Sim.errors == 0))
+    {
+        uint32_t s = job->load->next(&seed, op, used);
+        for (uint32_t i = 0; i < W.cfg.sector_size; i++)
+        {
+            buf[i] = (uint8_t)(Sim_Rand(&seed) >> 24);
+        }
+        t = Sim_Clock_Now();
+        WL_Flash_Erase_Range(&W, s * W.cfg.sector_size, W.cfg.sector_size);
+        WL_Flash_Write(&W, s * W.cfg.sector_size, buf, W.cfg.sector_size);
+        busy_ns += Sim_Clock_Now() - t;
+        op++;
+        if ((op % 1024) == 0)
+        {
+            WL_Flash_Read(&W, s * W.cfg.sector_size, check, W.cfg.sector_size);
+            job->errors += (memcmp(check, buf, W.cfg.sector_size) != 0);
+        }
+        for (uint32_t i = 0; i < Sim.block_count; i++)
+        {
+            max_count = (Sim.erase_count[i] > max_count) ? Sim.erase_count[i] : max_count;
+        }
+    }
+
+    for (uint32_t i = 0; i < Sim.block_count; i++)
+    {
+        sum += Sim.erase_count[i];
+    }
+    job->ops = op;
+    job->lifetime_gb = (double)op * W.cfg.sector_size * SWEEP_RATED_CYCLES / Sweep_Endurance / 1e9;
+    job->write_kbs = (double)op * W.cfg.sector_size / 1024 / (busy_ns / 1e9);
+    job->wa_erase = (double)Sim.erase_bytes / ((double)op * W.cfg.sector_size);
+    job->wa_prog = (double)Sim.prog_bytes / ((double)op * W.cfg.sector_size);
+    job->wear_ratio = (double)sum / Sim.block_count / max_count;
+    job->errors += Sim.errors;
+
+    free(buf);
+    free(check);
+    free(W.temp_buff);
+    NOR_Sim_DeInit(&Sim);
+}
+
+/**
+  * @brief  取一个任务,先取自己队列的尾部,空了按顺序偷别的队列的头部.
+  * @param  self: 线程序号.
+  * @param  job: 取到的任务序号.
+  * @retval 1: 取到了, 0: 全部做完了.
+  */
+static int Sweep_Take(uint32_t self, uint32_t *job)
+{
+    for (uint32_t k = 0; k < Sweep_Threads; k++)
+    {
+        sweep_queue_t *q = &Sweep_Queues[(self + k) % Sweep_Threads];
+        int found = 0;
+        pthread_mutex_lock(&q->lock);
+        if (q->head < q->tail)
+        {
+            *job = (k == 0) ? q->jobs[--q->tail] : q->jobs[q->head++];
+            found = 1;
+        }
+        pthread_mutex_unlock(&q->lock);
+        if (found)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *Sweep_Worker(void *arg)
+{
+    uint32_t self = (uint32_t)(uintptr_t)arg;
+    uint32_t job;
+
+    while (Sweep_Take(self, &job))
+    {
+        Sweep_Run(&Sweep_Jobs[job]);
+        pthread_mutex_lock(&Sweep_SinkLock);
+        Sweep_Done++;
+        fprintf(stderr, "\r%u/%u", (unsigned int)Sweep_Done, (unsigned int)Sweep_JobCount);
+        pthread_mutex_unlock(&Sweep_SinkLock);
+    }
+    return NULL;
+}
+
+static void Sweep_Print(FILE *out, int json)
+{
+    if (json)
+    {
+        fprintf(out, "[\n");
+    }
+    else
+    {
+        fprintf(out, "size,page_size,sector_size,temp_buff_size,wr_size,spare_pct,workload,seed,ops,lifetime_gb,write_kbs,wa_erase,wa_program,wear_ratio,errors\n");
+    }
+    for (uint32_t i = 0; i < Sweep_JobCount; i++)
+    {
+        sweep_job_t *j = &Sweep_Jobs[i];
+        if (json)
+        {
+            fprintf(out, "  {\"size\": %u, \"page_size\": %u, \"sector_size\": %u, \"temp_buff_size\": %u, \"wr_size\": %u, \"spare_pct\": %u, "
+                         "\"workload\": \"%s\", \"seed\": %u, \"ops\": %u, \"lifetime_gb\": %.3f, \"write_kbs\": %.2f, "
+                         "\"wa_erase\": %.4f, \"wa_program\": %.4f, \"wear_ratio\": %.4f, \"errors\": %u}%s\n",
+                    (unsigned int)j->cfg.full_mem_size, (unsigned int)j->cfg.page_size, (unsigned int)j->cfg.sector_size,
+                    (unsigned int)j->cfg.temp_buff_size,
+                    (unsigned int)j->cfg.wr_size, (unsigned int)j->spare, j->load->name, (unsigned int)j->seed, (unsigned int)j->ops,
+                    j->lifetime_gb, j->write_kbs, j->wa_erase, j->wa_prog, j->wear_ratio, (unsigned int)j->errors,
+                    (i + 1 < Sweep_JobCount) ? "," : "");
+        }
+        else
+        {
+            fprintf(out, "%u,%u,%u,%u,%u,%u,%s,%u,%u,%.3f,%.2f,%.4f,%.4f,%.4f,%u\n",
+                    (unsigned int)j->cfg.full_mem_size, (unsigned int)j->cfg.page_size, (unsigned int)j->cfg.sector_size,
+                    (unsigned int)j->cfg.temp_buff_size,
+                    (unsigned int)j->cfg.wr_size, (unsigned int)j->spare, j->load->name, (unsigned int)j->seed, (unsigned int)j->ops,
+                    j->lifetime_gb, j->write_kbs, j->wa_erase, j->wa_prog, j->wear_ratio, (unsigned int)j->errors);
+        }
+    }
+    if (json)
+    {
+        fprintf(out, "]\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[SWEEP_MAX_THREADS];
+    uint32_t seed = 1;
+    int json = 0, opt, ret = 0;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    FILE *out = stdout;
+
+    Sweep_Threads = (cores > 0) ? (uint32_t)cores : 1;
+    while ((opt = getopt(argc, argv, "j:e:s:f:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            Sweep_Threads = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'e':
+            Sweep_Endurance = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            json = (strcmp(optarg, "json") == 0);
+            break;
+        case 'o':
+            out = fopen(optarg, "w");
+            if (out == NULL)
+            {
+                perror(optarg);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-j threads] [-e endurance] [-s seed] [-f csv|json] [-o file]\n", argv[0]);
+            return 1;
+        }
+    }
+    Sweep_Threads = (Sweep_Threads == 0) ? 1 : ((Sweep_Threads > SWEEP_MAX_THREADS) ? SWEEP_MAX_THREADS : Sweep_Threads);
+    Sweep_Endurance = (Sweep_Endurance == 0) ? 1 : Sweep_Endurance;
+
+    /* 生成任务表. */
+    Sweep_JobCount = SWEEP_COUNT(Sweep_Geometry) * SWEEP_COUNT(Sweep_Sizes) * SWEEP_COUNT(Sweep_Buffers) * SWEEP_COUNT(Sweep_Spare) *
+                     Sim_Workload_Count;
+    Sweep_Jobs = (sweep_job_t *)calloc(Sweep_JobCount, sizeof(sweep_job_t));
+    for (uint32_t i = 0; i < Sweep_JobCount; i++)
+    {
+        uint32_t n = i;
+        sweep_job_t *j = &Sweep_Jobs[i];
+        j->load = &Sim_Workloads[n % Sim_Workload_Count];
+        n /= Sim_Workload_Count;
+        j->spare = Sweep_Spare[n % SWEEP_COUNT(Sweep_Spare)];
+        n /= SWEEP_COUNT(Sweep_Spare);
+        j->cfg.temp_buff_size = Sweep_Buffers[n % SWEEP_COUNT(Sweep_Buffers)];
+        n /= SWEEP_COUNT(Sweep_Buffers);
+        j->cfg.full_mem_size = Sweep_Sizes[n % SWEEP_COUNT(Sweep_Sizes)];
+        n /= SWEEP_COUNT(Sweep_Sizes);
+        /* Page/sector放在最外层,前面的任务序号(种子)和只扫4K的时候一样. */
+        j->cfg.page_size = Sweep_Geometry[n][0];
+        j->cfg.sector_size = Sweep_Geometry[n][1];
+        j->cfg.start_addr = 0x00000000;
+        j->cfg.wr_size = 0x00000010;
+        j->cfg.version = 0x00000001;
+        j->seed = Sweep_Seed(seed, i);
+    }
+
+    /* 轮流分到各个队列里,任务大小差别很大,靠偷任务来平衡. */
+    for (uint32_t t = 0; t < Sweep_Threads; t++)
+    {
+        pthread_mutex_init(&Sweep_Queues[t].lock, NULL);
+        Sweep_Queues[t].jobs = (uint32_t *)malloc(sizeof(uint32_t) * (Sweep_JobCount / Sweep_Threads + 1));
+    }
+    for (uint32_t i = 0; i < Sweep_JobCount; i++)
+    {
+        sweep_queue_t *q = &Sweep_Queues[i % Sweep_Threads];
+        q->jobs[q->tail++] = i;
+    }
+    for (uint32_t t = 0; t < Sweep_Threads; t++)
+    {
+        pthread_create(&threads[t], NULL, Sweep_Worker, (void *)(uintptr_t)t);
+    }
+    for (uint32_t t = 0; t < Sweep_Threads; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    fprintf(stderr, "\n");
+
+    Sweep_Print(out, json);
+    for (uint32_t i = 0; i < Sweep_JobCount; i++)
+    {
+        ret |= (Sweep_Jobs[i].errors != 0);
+    }
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    for (uint32_t t = 0; t < Sweep_Threads; t++)
+    {
+        free(Sweep_Queues[t].jobs);
+    }
+    free(Sweep_Jobs);
+    return ret;
+}
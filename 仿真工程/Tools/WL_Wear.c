@@ -0,0 +1,181 @@
+/**
+    描述: 磨损分布仿真,用几种典型负载一直写,直到第一个块到达擦写寿命,然后统计擦除次数分布,写放大和预计寿命.
+    文件: WL_Wear.c
+    用法: wl_wear [仿真寿命] [负载名] [配置序号]
+          仿真寿命默认1000次,结果按N25Q128A的100000次寿命线性折算(磨损和擦除次数成正比).
+          负载见Sim_Workload.c.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NOR_Sim.h"
+#include "WL_Flash.h"
+#include "Sim_Workload.h"
+
+#define WEAR_RATED_CYCLES   100000 /* N25Q128A的擦写寿命 */
+#define WEAR_EEPROM_CYCLES  1000000 /* README里对比的EEPROM寿命 */
+#define WEAR_HIST_BUCKETS   10
+
+/* 容量越小跑得越快,各种配置只改变冗余区大小和可轮换的块数. */
+static const wl_config_t Wear_Configs[] =
+{
+    /* start_addr, full_mem_size, page_size, sector_size, wr_size, version, temp_buff_size, wear_sectors, trim_sectors, crc */
+    { 0x00000000, 0x00020000, 0x00001000, 0x00001000, 0x00000010, 0x00000001, 0x00000020, 0, 0, 0 },
+    { 0x00000000, 0x00040000, 0x00001000, 0x00001000, 0x00000010, 0x00000001, 0x00000020, 0, 0, 0 },
+    { 0x00000000, 0x00040000, 0x00001000, 0x00001000, 0x00000001, 0x00000001, 0x00000100, 0, 0, 0 },
+    { 0x00000000, 0x00080000, 0x00001000, 0x00001000, 0x00000010, 0x00000001, 0x00000020, 0, 0, 0 },
+    /* 开擦除次数统计,和仿真Flash记的对比. */
+    { 0x00000000, 0x00040000, 0x00001000, 0x00001000, 0x00000010, 0x00000001, 0x00000020, 2, 0, 0 },
+};
+
+#define WEAR_COUNT(x) (sizeof(x) / sizeof((x)[0]))
+
+static uint8_t Wear_Buf[0x1000];
+
+/**
+  * @brief  用一种负载跑一个配置,直到第一个块到达寿命.
+  * @param  cfg: 磨损平衡配置.
+  * @param  load: 负载.
+  * @param  endurance: 仿真寿命.
+  * @retval 0: 正常, 1: 仿真Flash报错或者读回不对.
+  */
+static int Wear_Run(const wl_config_t *cfg, const sim_workload_t *load, uint32_t endurance)
+{
+    nor_sim_t Sim;
+    wl_flash_t W;
+    uint32_t *user_count;
+    uint32_t sectors, max_count = 0, hot_user = 0, op = 0, bad = 0;
+    uint32_t hist[WEAR_HIST_BUCKETS] = { 0 };
+    uint64_t sum = 0;
+    uint32_t seed = 2463534242u;
+    double scale;
+
+    Sim_Clock_Reset();
+    if (NOR_Sim_Init(&Sim, cfg->full_mem_size) != QSPI_OK)
+    {
+        return 1;
+    }
+    memset(&W, 0, sizeof(W));
+    W.cfg = *cfg;
+    W.ops = &NOR_Sim_WL_Ops;
+    W.drv = &Sim;
+    WL_Flash_Config(&W);
+
+    sectors = W.flash_size / W.cfg.sector_size;
+    user_count = (uint32_t *)calloc(sectors, sizeof(uint32_t));
+    /* 格式化的写入不算用户写入. */
+    Sim.erase_bytes = 0;
+    Sim.prog_bytes = 0;
+
+    while (max_count < endurance)
+    {
+        uint32_t s = load->next(&seed, op, sectors);
+        for (uint32_t i = 0; i < W.cfg.sector_size; i++)
+        {
+            Wear_Buf[i] = (uint8_t)(Sim_Rand(&seed) >> 24);
+        }
+        WL_Flash_Erase_Range(&W, s * W.cfg.sector_size, W.cfg.sector_size);
+        WL_Flash_Write(&W, s * W.cfg.sector_size, Wear_Buf, W.cfg.sector_size);
+        user_count[s]++;
+        op++;
+
+        /* 隔一段抽查一次读回来对不对. */
+        if ((op % 1024) == 0)
+        {
+            static uint8_t check[sizeof(Wear_Buf)];
+            WL_Flash_Read(&W, s * W.cfg.sector_size, check, W.cfg.sector_size);
+            bad += (memcmp(check, Wear_Buf, W.cfg.sector_size) != 0);
+        }
+        for (uint32_t i = 0; i < Sim.block_count; i++)
+        {
+            max_count = (Sim.erase_count[i] > max_count) ? Sim.erase_count[i] : max_count;
+        }
+    }
+
+    for (uint32_t i = 0; i < sectors; i++)
+    {
+        hot_user = (user_count[i] > hot_user) ? user_count[i] : hot_user;
+    }
+    for (uint32_t i = 0; i < Sim.block_count; i++)
+    {
+        uint32_t b = (uint32_t)((uint64_t)Sim.erase_count[i] * WEAR_HIST_BUCKETS / (endurance + 1));
+        hist[b]++;
+        sum += Sim.erase_count[i];
+    }
+    scale = (double)WEAR_RATED_CYCLES / endurance;
+
+    printf("%-8s size %4uK wr %2u buf %3u | ops %u, WA erase %.2f program %.2f, avg/max wear %.2f\n",
+           load->name, (unsigned int)(cfg->full_mem_size >> 10), (unsigned int)cfg->wr_size, (unsigned int)cfg->temp_buff_size,
+           (unsigned int)op, (double)Sim.erase_bytes / ((double)op * W.cfg.sector_size),
+           (double)Sim.prog_bytes / ((double)op * W.cfg.sector_size), (double)sum / Sim.block_count / max_count);
+    printf("         @%u cycles: %.2f GB written, hottest sector rewritten %.0f times (%s %u EEPROM)\n",
+           (unsigned int)WEAR_RATED_CYCLES, (double)op * W.cfg.sector_size * scale / 1e9,
+           hot_user * scale, (hot_user * scale >= WEAR_EEPROM_CYCLES) ? ">=" : "<",
+           (unsigned int)WEAR_EEPROM_CYCLES);
+    printf("         wear histogram (%% of endurance):");
+    for (uint32_t i = 0; i < WEAR_HIST_BUCKETS; i++)
+    {
+        printf(" %u", (unsigned int)hist[i]);
+    }
+    printf("%s\n", ((bad != 0) || (Sim.errors != 0)) ? "  ** DATA/FLASH ERROR **" : "");
+
+    /* 开了统计的话,重新挂载读回来,应该和仿真Flash记的一模一样. */
+    if (W.wear_count != NULL)
+    {
+        wl_wear_stats_t stats;
+        uint32_t diff = 0;
+
+        WL_Flash_FlushWear(&W);
+        memset(W.wear_count, 0, W.wear_blocks * sizeof(uint32_t));
+        WL_Flash_Config(&W);
+        WL_Flash_GetWearStats(&W, &stats);
+        for (uint32_t i = 0; i < W.wear_blocks; i++)
+        {
+            diff += (W.wear_count[i] != Sim.erase_count[i]);
+        }
+        printf("         wear stats: min %u max %u mean %u, %.1f%% life used, %llu page erases left, %u pages differ from flash\n",
+               (unsigned int)stats.min, (unsigned int)stats.max, (unsigned int)stats.mean, stats.life_used / 10.0,
+               (unsigned long long)stats.remaining, (unsigned int)diff);
+        bad += diff;
+        vPortFree(W.wear_count);
+    }
+
+    free(user_count);
+    free(W.temp_buff);
+    NOR_Sim_DeInit(&Sim);
+    return (bad != 0) || (Sim.errors != 0);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t endurance = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 1000;
+    const char *only = (argc > 2) ? argv[2] : NULL;
+    int cfg_only = (argc > 3) ? atoi(argv[3]) : -1;
+    int ret = 0;
+
+    if ((endurance == 0) || (endurance > WEAR_RATED_CYCLES))
+    {
+        printf("endurance must be 1..%u\n", (unsigned int)WEAR_RATED_CYCLES);
+        return 1;
+    }
+    for (uint32_t c = 0; c < WEAR_COUNT(Wear_Configs); c++)
+    {
+        if ((cfg_only >= 0) && ((uint32_t)cfg_only != c))
+        {
+            continue;
+        }
+        for (uint32_t l = 0; l < Sim_Workload_Count; l++)
+        {
+            if ((only != NULL) && (strcmp(only, "all") != 0) && (strcmp(only, Sim_Workloads[l].name) != 0))
+            {
+                continue;
+            }
+            ret |= Wear_Run(&Wear_Configs[c], &Sim_Workloads[l], endurance);
+        }
+    }
+    return ret;
+}
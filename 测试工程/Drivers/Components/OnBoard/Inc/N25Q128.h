@@ -45,9 +45,26 @@ extern "C" {
 #define N25Q128A_DUMMY_CYCLES_READ           8
 #define N25Q128A_DUMMY_CYCLES_READ_QUAD      10
 
+    /**
+      * @brief  N25Q128A DTR(DDR) Configuration
+      *         DTR读时地址和数据在时钟双沿传输,同一时钟下数据阶段时间减半.
+      *         N25Q128A的DTR最高54MHz,80MHz系统时钟下要2分频到40MHz,整条总线都降到40MHz,
+      *         仿真(wl_bench -D 1对比不加-D)大块读和STR 80MHz差不多,编程擦除的指令还慢了,所以默认关闭,
+      *         只有QSPI时钟本身受限(低于54MHz)时打开才有收益.
+      *         打开以后也只有BSP_QSPI_Info.DtrRead(Micron,或者SFDP说支持DTR)的芯片才走DTR读.
+      */
+#define N25Q128A_DTR_ENABLE                  0
+#define N25Q128A_CLOCK_PRESCALER             0         /* STR: 80MHz / (0 + 1) = 80MHz */
+#define N25Q128A_CLOCK_PRESCALER_DTR         1         /* DTR: 80MHz / (1 + 1) = 40MHz */
+#define N25Q128A_DTR_READ_MIN                256       /* WL驱动接口里大于等于这个长度的读取才走DTR */
+
 #define N25Q128A_BULK_ERASE_MAX_TIME         250000
+#define N25Q128A_BULK_ERASE_TYP_TIME         170000
 #define N25Q128A_SECTOR_ERASE_MAX_TIME       3000
 #define N25Q128A_SUBSECTOR_ERASE_MAX_TIME    800
+#define N25Q128A_SECTOR_ERASE_TYP_TIME       700
+#define N25Q128A_SUBSECTOR_ERASE_TYP_TIME    250
+#define N25Q128A_PAGE_PROG_TYP_TIME_US       500       /* 单位是us,上面的时间单位都是ms */
 
     /**
       * @brief  N25Q128A Commands
@@ -70,6 +87,16 @@ extern "C" {
 #define QUAD_OUT_FAST_READ_CMD               0x6B
 #define QUAD_INOUT_FAST_READ_CMD             0xEB
 
+#define DTR_FAST_READ_CMD                    0x0D
+#define DTR_DUAL_OUT_FAST_READ_CMD           0x3D
+#define DTR_DUAL_INOUT_FAST_READ_CMD         0xBD
+#define DTR_QUAD_OUT_FAST_READ_CMD           0x6D
+#define DTR_QUAD_INOUT_FAST_READ_CMD         0xED
+
+    /* Address Mode Operations */
+#define ENTER_4_BYTE_ADDR_MODE_CMD           0xB7
+#define EXIT_4_BYTE_ADDR_MODE_CMD            0xE9
+
     /* Write Operations */
 #define WRITE_ENABLE_CMD                     0x06
 #define WRITE_DISABLE_CMD                    0x04
@@ -193,6 +220,32 @@ typedef struct
     uint32_t dwData[9];
 } BSP_QSPI_SFDP_TypeDef;
 
+#define BSP_QSPI_SFDP_SIGNATURE  0x50444653 /* "SFDP" */
+#define BSP_QSPI_ERASE_TYPES     4          /* SFDP最多描述4种擦除 */
+#define BSP_QSPI_MICRON_ID       0x20       /* JEDEC厂商ID,Micron(N25Q系列) */
+
+/**
+	* @brief  Flash参数描述,默认是N25Q128A,BSP_QSPI_Init读到SFDP后按SFDP更新.
+	*/
+typedef struct
+{
+    uint32_t FlashSize;                          /*!< 容量(Byte) */
+    uint32_t PageSize;                           /*!< 编程页大小 */
+    uint8_t  AddressBytes;                       /*!< 地址字节数,3或4 */
+    uint8_t  ReadCmd;                            /*!< 读指令,按最快的模式选 */
+    uint8_t  ReadDummyCycles;                    /*!< 读指令的dummy周期(不含mode周期) */
+    uint8_t  ReadModeCycles;                     /*!< 读指令的mode周期,按全1的交替字节发 */
+    uint32_t ReadAddressMode;                    /*!< 读指令地址线数,QSPI_ADDRESS_x_LINE(S) */
+    uint32_t ReadDataMode;                       /*!< 读指令数据线数,QSPI_DATA_x_LINE(S) */
+    uint8_t  ProgCmd;                            /*!< 编程指令 */
+    uint32_t ProgAddressMode;                    /*!< 编程指令地址线数 */
+    uint32_t ProgDataMode;                       /*!< 编程指令数据线数 */
+    uint8_t  EraseCmd[BSP_QSPI_ERASE_TYPES];     /*!< 擦除指令,和EraseSize一一对应 */
+    uint32_t EraseSize[BSP_QSPI_ERASE_TYPES];    /*!< 擦除大小,从小到大排列,0表示没有 */
+    uint8_t  Manufacturer;                       /*!< JEDEC厂商ID,BSP_QSPI_Select_Prog填,Micron专有的指令要看这个 */
+    uint8_t  DtrRead;                            /*!< 支持DTR读(SFDP里有,或者是Micron),N25Q128A_DTR_ENABLE打开时才用 */
+} BSP_QSPI_Info_TypeDef;
+
 /** @defgroup N25Q128A_Exported_Functions
 	* @{
 	*/
@@ -206,24 +259,39 @@ void BSP_QSPI_AutoPollingMemReady(void);
 void BSP_QSPI_ResetMemory(void);
 void BSP_QSPI_WriteEnable(void);
 void BSP_QSPI_DummyCyclesCfg(void);
+void BSP_QSPI_Enter4ByteAddressMode(void);
 
 /* Basic Function */
 void		BSP_QSPI_Read        (uint8_t *pData, uint32_t ReadAddr, uint32_t Size);
+void		BSP_QSPI_Read_DTR    (uint8_t *pData, uint32_t ReadAddr, uint32_t Size);
+void		BSP_QSPI_Read_DMA    (uint8_t *pData, uint32_t ReadAddr, uint32_t Size);
+uint8_t BSP_QSPI_Read_DMA_Done(void);
 void    BSP_QSPI_Write       (uint8_t *pData, uint32_t WriteAddr, uint32_t Size);
 void    BSP_QSPI_Erase_Block (uint32_t BlockAddress);
 void 		BSP_QSPI_Erase_Sector(uint32_t Sector);
 void 		BSP_QSPI_Erase_Chip  (void);
+void 		BSP_QSPI_Erase_Chip_Start(void);
+void 		BSP_QSPI_Erase       (uint32_t Address, uint32_t Size);
 uint8_t BSP_QSPI_GetStatus   (void);
+void 		BSP_QSPI_SuspendErase(void);
+void 		BSP_QSPI_ResumeErase (void);
 void 		BSP_QSPI_EnableMemoryMappedMode(void);
 
 /* Misc Function */
 void		BSP_QSPI_RDID(BSP_QSPI_ID_TypeDef *pID);
 void BSP_QSPI_Read_SPDF(BSP_QSPI_SFDP_TypeDef *pID);
+uint8_t BSP_QSPI_Parse_SFDP(const BSP_QSPI_SFDP_TypeDef *pSFDP, BSP_QSPI_Info_TypeDef *pInfo);
+void BSP_QSPI_Select_Prog(uint8_t Manufacturer, BSP_QSPI_Info_TypeDef *pInfo);
+void BSP_QSPI_GetInfo(BSP_QSPI_Info_TypeDef *pInfo);
 
 int32_t BSP_QSPI_Write_HAL(uint32_t WriteAddr,uint32_t NumByteToWrite,uint8_t * pBuffer);
 int32_t BSP_QSPI_Read_HAL(uint32_t WriteAddr,uint32_t NumByteToWrite,uint8_t * pBuffer);
 int32_t BSP_QSPI_Erase_HAL(uint32_t Addr,uint32_t Num);
 
+/* WL_Flash驱动接口,赋给wl_flash_t的ops. */
+struct WL_Flash_Ops_s;
+extern const struct WL_Flash_Ops_s N25Q128_WL_Ops;
+
 /**
 	* @}
 	*/
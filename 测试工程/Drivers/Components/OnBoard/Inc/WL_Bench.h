@@ -0,0 +1,39 @@
+/**
+    描述: WL_Flash性能测试,板上和PC仿真用同一份代码,结果按CSV输出.
+    文件: WL_Bench.h
+    注意: 会格式化整个磨损平衡区域,里面的数据全部丢失.
+          挂载测试要把pos走一圈,区域越大越慢,板上建议只划1MB左右来测.
+          时间和输出都由调用者提供,这里不依赖芯片相关的头文件.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#ifndef _WL_Bench_H_
+#define _WL_Bench_H_
+
+#include "WL_Flash.h"
+
+#ifndef WL_BENCH_SAMPLES
+#define WL_BENCH_SAMPLES 32 /* 每项最多测多少次 */
+#endif
+
+#define WL_BENCH_VERSION 10 /* 输出格式的版本,列改了就加一 */
+
+typedef struct WL_Bench_s
+{
+    uint64_t (*now_ns)(void); /* 当前时间(ns),板上用DWT,PC上用虚拟时钟 */
+    void (*out)(const char *line); /* 输出一行,不带换行符 */
+    uint8_t *buf; /* 读写用的缓冲区,决定了最大测试长度 */
+    uint32_t buf_size; /* 缓冲区大小 */
+    uint32_t iterations; /* 每项测多少次,0或者超过WL_BENCH_SAMPLES按WL_BENCH_SAMPLES */
+    void (*work)(uint32_t us); /* 流式读测试里模拟消费者处理一块数据,板上空转,PC上推进虚拟时钟,NULL就不处理 */
+    uint32_t work_us; /* 每块处理多久 */
+
+    uint64_t sample[WL_BENCH_SAMPLES]; /* 每次的延时(ns) */
+    char line[128]; /* 输出行 */
+} wl_bench_t;
+
+void WL_Bench_Run(wl_bench_t *Bench, wl_flash_t *WL_Flash);
+
+#endif
@@ -0,0 +1,38 @@
+/**
+    描述: 把磨损平衡区域当成512字节扇区的块设备,给FatFs之类的文件系统用(FatFs的diskio见WL_Diskio.c).
+    文件: WL_Disk.h
+    注意: 文件系统的一个扇区只有512字节,Flash要按sector(一般4K)擦,所以带一个sector大小的合并缓冲:
+          不满一个sector的写先拼在缓冲里,换到别的sector或者WL_Disk_Sync的时候才写回,
+          连续几个扇区落在同一个sector里只写回一次;整个sector的写不经过缓冲直接写.
+          写回之前掉电,缓冲里的数据会丢,文件系统关文件或者f_sync的时候会调WL_Disk_Sync.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#ifndef _WL_Disk_H_
+#define _WL_Disk_H_
+
+#include "WL_Flash.h"
+
+#define WL_DISK_SECTOR_SIZE 512 /* 文件系统的扇区大小 */
+
+typedef struct WL_Disk_s
+{
+    wl_flash_t *flash; /* 下面的磨损平衡层,必须已经WL_Flash_Config过 */
+    uint8_t atomic; /* 在WL_Disk_Init之前填,不为0时写回用WL_Flash_Program(经过dummy合并,掉电不会丢整个sector,多擦一次),
+                       0用WL_Flash_Update */
+    uint32_t sectors; /* 一共多少个扇区 */
+    uint8_t *buf; /* 合并缓冲,一个Flash sector(cfg.sector_size) */
+    uint32_t buf_addr; /* 缓冲里是哪个Flash sector(逻辑地址) */
+    uint8_t buf_valid; /* 缓冲里有内容 */
+    uint8_t buf_dirty; /* 改过还没写回Flash */
+} wl_disk_t;
+
+uint8_t WL_Disk_Init(wl_disk_t *Disk, wl_flash_t *WL_Flash);
+uint8_t WL_Disk_Read(wl_disk_t *Disk, uint32_t sector, uint8_t *dest, uint32_t count);
+uint8_t WL_Disk_Write(wl_disk_t *Disk, uint32_t sector, const uint8_t *src, uint32_t count);
+uint8_t WL_Disk_Sync(wl_disk_t *Disk);
+uint8_t WL_Disk_Trim(wl_disk_t *Disk, uint32_t sector, uint32_t count);
+
+#endif
@@ -0,0 +1,71 @@
+/**
+    描述: WL_Flash和Flash驱动各阶段的耗时统计,按2的幂分桶累计直方图,导出后在PC上用WL_Prof解读.
+    文件: WL_Prof.h
+    注意: 定义WL_FLASH_PROF才会编译进WL_Flash.c和N25Q128.c,不定义没有任何开销.
+          时间是DWT的CYCCNT,单次超过53秒(80MHz)会算错,这里量的都是毫秒级的,不用管.
+          阶段是嵌套的,比如挪dummy里面有擦除和写入,擦除里面又有等待,所以各阶段的时间不能直接相加.
+          这个头文件PC上也要用(读导出的数据),不要包含芯片相关的头文件.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#ifndef _WL_Prof_H_
+#define _WL_Prof_H_
+
+#include <stdint.h>
+
+#define WL_PROF_MAGIC   0x50544C57 /* "WLTP" */
+#define WL_PROF_VERSION 3
+#define WL_PROF_BUCKETS 32 /* 第i个桶是[2^i, 2^(i+1))个周期,0和1都算第0个 */
+
+/* 阶段. */
+#define WL_PROF_TRANSLATE  0 /* calcAddr,虚拟地址换算物理地址 */
+#define WL_PROF_READ       1 /* 驱动读 */
+#define WL_PROF_PROGRAM    2 /* 驱动写(含等写完) */
+#define WL_PROF_ERASE      3 /* 驱动擦除(含等擦完) */
+#define WL_PROF_RELOCATE   4 /* updateWL挪动dummy,含里面的读写擦和pos标记 */
+#define WL_PROF_MARKER     5 /* 写pos标记,重写state */
+#define WL_PROF_POLL       6 /* 等Flash忙完(QSPI自动轮询或者异步驱动的查询) */
+#define WL_PROF_WL_READ    7 /* 整个WL_Flash_Read */
+#define WL_PROF_WL_WRITE   8 /* 整个WL_Flash_Write */
+#define WL_PROF_WL_ERASE   9 /* 整个WL_Flash_Erase_Range */
+#define WL_PROF_CACHE_HIT  10 /* 读缓存命中的一行 */
+#define WL_PROF_CACHE_MISS 11 /* 读缓存没命中的一行,含从Flash读 */
+#define WL_PROF_RA_WAIT    12 /* 等预读的DMA读完 */
+#define WL_PROF_PHASES     13
+
+typedef struct WL_Prof_Hist_s
+{
+    uint32_t count; /* 次数 */
+    uint32_t max; /* 最长一次(周期) */
+    uint64_t total; /* 总周期 */
+    uint32_t bucket[WL_PROF_BUCKETS];
+} wl_prof_hist_t;
+
+/* 整个结构体直接存下来就是导出文件. */
+typedef struct WL_Prof_Buf_s
+{
+    uint32_t magic; /* WL_PROF_MAGIC */
+    uint16_t version; /* WL_PROF_VERSION */
+    uint16_t phases; /* WL_PROF_PHASES */
+    uint32_t buckets; /* WL_PROF_BUCKETS */
+    uint32_t clock_hz; /* 周期的频率 */
+    wl_prof_hist_t hist[WL_PROF_PHASES];
+} wl_prof_buf_t;
+
+/* 下面是板上的接口,PC上只用上面的定义. */
+
+/* 量一段代码: WL_PROF_BEGIN(t); ... WL_PROF_END(WL_PROF_xxx, t); */
+#define WL_PROF_BEGIN(t) uint32_t t = WL_Prof_Now()
+#define WL_PROF_END(phase, t) WL_Prof_Add((phase), WL_Prof_Now() - (t))
+
+extern wl_prof_buf_t WL_Prof_Buf;
+
+void WL_Prof_Init(void);
+uint32_t WL_Prof_Now(void);
+void WL_Prof_Add(uint8_t phase, uint32_t cycles);
+void WL_Prof_Get(wl_prof_buf_t *out, uint8_t reset);
+void WL_Prof_Dump(void (*out)(const uint8_t *data, uint32_t size));
+
+#endif
@@ -0,0 +1,89 @@
+/**
+    描述: WL_Flash和Flash驱动的访问记录,记到环形缓冲区里,导出后可以在PC上用WL_Replay回放.
+    文件: WL_Trace.h
+    注意: 定义WL_FLASH_TRACE才会编译进WL_Flash.c,不定义没有任何开销.
+          时间戳是DWT的CYCCNT,32位,80MHz下53秒回绕一次,两条记录间隔不能超过这个时间.
+          驱动层的记录靠WL_Trace_Attach换掉wl_flash_t的ops,定义了WL_FLASH_STATIC_OPS时不生效.
+          这个头文件PC上也要用(读记录),不要包含芯片相关的头文件.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#ifndef _WL_Trace_H_
+#define _WL_Trace_H_
+
+#include <stdint.h>
+
+#ifndef WL_TRACE_SIZE
+#define WL_TRACE_SIZE 256 /* 记录条数,每条16字节 */
+#endif
+
+#define WL_TRACE_MAGIC   0x52544C57 /* "WLTR" */
+#define WL_TRACE_VERSION 1
+
+/* 操作类型,结束记录再或上WL_TRACE_DONE.WL操作里面调用的WL操作(比如WL_Flash_Update里的WL_Flash_Write)也会记,
+   夹在外层的开始和结束记录中间. */
+#define WL_TRACE_WL_READ        0x01 /* WL_Flash_Read */
+#define WL_TRACE_WL_WRITE       0x02 /* WL_Flash_Write */
+#define WL_TRACE_WL_ERASE       0x03 /* WL_Flash_Erase_Range */
+#define WL_TRACE_WL_FORMAT      0x04 /* WL_Flash_Format */
+#define WL_TRACE_WL_DISCARD     0x05 /* WL_Flash_Discard */
+#define WL_TRACE_WL_PROGRAM     0x06 /* WL_Flash_Program */
+#define WL_TRACE_WL_UPDATE      0x07 /* WL_Flash_Update */
+#define WL_TRACE_WL_SYNC        0x08 /* WL_Flash_Sync(写缓冲里有数据时才记) */
+#define WL_TRACE_FLASH_READ     0x11 /* 驱动读 */
+#define WL_TRACE_FLASH_PROGRAM  0x12 /* 驱动写 */
+#define WL_TRACE_FLASH_ERASE    0x13 /* 驱动擦除 */
+#define WL_TRACE_FLASH_CHIP     0x14 /* 驱动整片擦除(只是开始) */
+#define WL_TRACE_DONE           0x80
+
+typedef struct WL_Trace_Rec_s
+{
+    uint32_t time; /* DWT CYCCNT */
+    uint32_t addr; /* 地址,WL操作是虚拟地址,驱动操作是物理地址 */
+    uint32_t size; /* 长度 */
+    uint8_t op; /* WL_TRACE_xxx */
+    uint8_t reserved[3];
+} wl_trace_rec_t;
+
+/* 缓冲区头部,后面紧跟着WL_TRACE_SIZE条记录,整个结构体直接存下来就是导出文件. */
+typedef struct WL_Trace_Hdr_s
+{
+    uint32_t magic; /* WL_TRACE_MAGIC */
+    uint16_t version; /* WL_TRACE_VERSION */
+    uint16_t rec_size; /* sizeof(wl_trace_rec_t) */
+    uint32_t capacity; /* 记录条数 */
+    uint32_t head; /* 下一条写的位置 */
+    uint32_t total; /* 一共记了多少条,超过capacity说明旧的被覆盖了 */
+    uint32_t clock_hz; /* 时间戳频率 */
+} wl_trace_hdr_t;
+
+typedef struct WL_Trace_Buf_s
+{
+    wl_trace_hdr_t hdr;
+    wl_trace_rec_t rec[WL_TRACE_SIZE];
+} wl_trace_buf_t;
+
+/* PC上只用上面的定义,下面是板上的接口. */
+#include "WL_Flash.h"
+
+/* 套在wl_flash_t原来的驱动外面,记录每次驱动操作. */
+typedef struct WL_Trace_Drv_s
+{
+    wl_flash_ops_t ops; /* 给wl_flash_t用的接口,函数都换成了转发的,caps这些和原来的一样 */
+    const wl_flash_ops_t *inner_ops; /* 原来的驱动接口 */
+    void *inner_drv; /* 原来的驱动私有数据 */
+    uint32_t read_addr; /* 正在进行的后台读,结束记录要用 */
+    uint32_t read_size;
+    uint8_t read_busy;
+} wl_trace_drv_t;
+
+extern wl_trace_buf_t WL_Trace_Buf;
+
+void WL_Trace_Init(void);
+void WL_Trace_Record(uint8_t op, uint32_t addr, uint32_t size);
+void WL_Trace_Attach(wl_trace_drv_t *Trace, wl_flash_t *WL_Flash);
+void WL_Trace_Dump(void (*out)(const uint8_t *data, uint32_t size));
+
+#endif
@@ -1,4 +1,39 @@
 #include "N25Q128.h"
+#include "WL_Flash.h"
+
+/* 定义WL_FLASH_PROF时统计等Flash忙完的时间,见WL_Prof.h. */
+#ifdef WL_FLASH_PROF
+#include "WL_Prof.h"
+#else
+#define WL_PROF_BEGIN(t)
+#define WL_PROF_END(phase, t)
+#endif
+
+/* 当前使用的Flash参数,默认是N25Q128A,BSP_QSPI_Init读到SFDP后更新. */
+static BSP_QSPI_Info_TypeDef BSP_QSPI_Info =
+{
+    N25Q128A_FLASH_SIZE,                               /* FlashSize */
+    N25Q128A_PAGE_SIZE,                                /* PageSize */
+    3,                                                 /* AddressBytes */
+    QUAD_INOUT_FAST_READ_CMD,                          /* ReadCmd */
+    N25Q128A_DUMMY_CYCLES_READ_QUAD,                   /* ReadDummyCycles */
+    0,                                                 /* ReadModeCycles */
+    QSPI_ADDRESS_4_LINES,                              /* ReadAddressMode */
+    QSPI_DATA_4_LINES,                                 /* ReadDataMode */
+    EXT_QUAD_IN_FAST_PROG_CMD,                         /* ProgCmd */
+    QSPI_ADDRESS_4_LINES,                              /* ProgAddressMode */
+    QSPI_DATA_4_LINES,                                 /* ProgDataMode */
+    { SUBSECTOR_ERASE_CMD, SECTOR_ERASE_CMD, 0, 0 },   /* EraseCmd */
+    { N25Q128A_SUBSECTOR_SIZE, N25Q128A_SECTOR_SIZE, 0, 0 }, /* EraseSize */
+    BSP_QSPI_MICRON_ID,                                /* Manufacturer */
+    0                                                  /* DtrRead,BSP_QSPI_Select_Prog确认之前不用 */
+};
+
+/* 按地址字节数选择地址宽度,SFDP读取固定是3字节地址. */
+#define BSP_QSPI_ADDRESS_SIZE ((BSP_QSPI_Info.AddressBytes == 4) ? QSPI_ADDRESS_32_BITS : QSPI_ADDRESS_24_BITS)
+
+static uint8_t BSP_QSPI_EraseCmd(uint32_t Size, uint8_t DefaultCmd);
+static void BSP_QSPI_ReadAlternate(QSPI_CommandTypeDef *sCommand);
 
 /**
   * @brief  This function read the SR of the memory and wait the EOP.
@@ -28,7 +63,9 @@ void BSP_QSPI_AutoPollingMemReady(void)
     sConfig.Interval        = 0x10;
     sConfig.AutomaticStop   = QSPI_AUTOMATIC_STOP_ENABLE;
 
+    WL_PROF_BEGIN(t);
     QSPI_AutoPolling(&sCommand, &sConfig);
+    WL_PROF_END(WL_PROF_POLL, t);
 }
 
 /**
@@ -102,6 +139,8 @@ void BSP_QSPI_WriteEnable(void)
 /**
   * @brief  This function configure the dummy cycles on memory side.
   * @param  None
+  * @note   易失配置寄存器(0x85/0x81)是Micron的,别的厂商这两个指令不是一回事(或者没有),
+  *         不是Micron就不发,读指令直接用SFDP里的dummy/mode周期(芯片上电默认值).
   * @retval None
   */
 void BSP_QSPI_DummyCyclesCfg(void)
@@ -109,6 +148,11 @@ void BSP_QSPI_DummyCyclesCfg(void)
     QSPI_CommandTypeDef sCommand;
     uint8_t reg;
 
+    if (BSP_QSPI_Info.Manufacturer != BSP_QSPI_MICRON_ID)
+    {
+        return;
+    }
+
     /* Initialize the read volatile configuration register command */
     sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
     sCommand.Instruction       = READ_VOL_CFG_REG_CMD;
@@ -132,7 +176,8 @@ void BSP_QSPI_DummyCyclesCfg(void)
 
     /* Update volatile configuration register (with new dummy cycles) */
     sCommand.Instruction = WRITE_VOL_CFG_REG_CMD;
-    MODIFY_REG(reg, N25Q128A_VCR_NB_DUMMY, (N25Q128A_DUMMY_CYCLES_READ_QUAD << POSITION_VAL(N25Q128A_VCR_NB_DUMMY)));
+    /* N25Q的dummy周期数包括mode周期(XIP确认位). */
+    MODIFY_REG(reg, N25Q128A_VCR_NB_DUMMY, ((BSP_QSPI_Info.ReadDummyCycles + BSP_QSPI_Info.ReadModeCycles) << POSITION_VAL(N25Q128A_VCR_NB_DUMMY)));
 
     /* Configure the write volatile configuration register command */
     QSPI_Command(&sCommand);
@@ -142,15 +187,70 @@ void BSP_QSPI_DummyCyclesCfg(void)
 
 }
 
+/**
+  * @brief  This function enter the 4-byte address mode of the memory.
+  * @param  None
+  * @retval None
+  */
+void BSP_QSPI_Enter4ByteAddressMode(void)
+{
+    QSPI_CommandTypeDef sCommand;
+
+    /* Initialize the command */
+    sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
+    sCommand.Instruction       = ENTER_4_BYTE_ADDR_MODE_CMD;
+    sCommand.AddressMode       = QSPI_ADDRESS_NONE;
+    sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
+    sCommand.DataMode          = QSPI_DATA_NONE;
+    sCommand.DummyCycles       = 0;
+    sCommand.DdrMode           = QSPI_DDR_MODE_DISABLE;
+    sCommand.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;
+    sCommand.SIOOMode          = QSPI_SIOO_INST_EVERY_CMD;
+
+    /* Enable write operations, Micron parts require it before 0xB7 */
+    BSP_QSPI_WriteEnable();
+
+    /* Send the command */
+    QSPI_Command(&sCommand);
+
+    /* Configure automatic polling mode to wait the memory is ready */
+    BSP_QSPI_AutoPollingMemReady();
+}
+
 void BSP_QSPI_Init(void)
 {
-    QSPI_MspInit(4, 0, QSPI_SAMPLE_SHIFTING_NONE, 23, QSPI_CS_HIGH_TIME_1_CYCLE, QSPI_CLOCK_MODE_0);
+#if N25Q128A_DTR_ENABLE
+    /* DTR模式下必须关闭采样移位(SSHIFT),时钟降到DTR允许的范围. */
+    QSPI_MspInit(4, N25Q128A_CLOCK_PRESCALER_DTR, QSPI_SAMPLE_SHIFTING_NONE, 23, QSPI_CS_HIGH_TIME_1_CYCLE, QSPI_CLOCK_MODE_0);
+#else
+    QSPI_MspInit(4, N25Q128A_CLOCK_PRESCALER, QSPI_SAMPLE_SHIFTING_NONE, 23, QSPI_CS_HIGH_TIME_1_CYCLE, QSPI_CLOCK_MODE_0);
+#endif
+
+    BSP_QSPI_SFDP_TypeDef sfdp;
+    BSP_QSPI_ID_TypeDef id;
 
     /* QSPI memory reset */
     BSP_QSPI_ResetMemory();
 
-    /* Configuration of the dummy cucles on QSPI memory side */
+    /* 读SFDP,按SFDP选择最快的读模式和擦除大小,读不到就保持N25Q128A的默认参数. */
+    BSP_QSPI_Read_SPDF(&sfdp);
+    BSP_QSPI_Parse_SFDP(&sfdp, &BSP_QSPI_Info);
+
+    /* SFDP没有编程模式,按厂商ID选编程指令. */
+    BSP_QSPI_RDID(&id);
+    BSP_QSPI_Select_Prog(id.Manufacturer, &BSP_QSPI_Info);
+
+    /* QSPI控制器的地址空间按实际容量配置,超出FSIZE的地址会出错. */
+    QSPI_SetFlashSize(POSITION_VAL(BSP_QSPI_Info.FlashSize) - 1);
+
+    /* Configuration of the dummy cucles on QSPI memory side(只有Micron要配). */
     BSP_QSPI_DummyCyclesCfg();
+
+    /* 大于16MB的Flash要进入4字节地址模式,复位后会回到3字节. */
+    if (BSP_QSPI_Info.AddressBytes == 4)
+    {
+        BSP_QSPI_Enter4ByteAddressMode();
+    }
 }
 
 
@@ -167,15 +267,127 @@ void BSP_QSPI_Read(uint8_t *pData, uint32_t ReadAddr, uint32_t Size)
 
     /* Initialize the read command */
     sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
-    sCommand.Instruction       = QUAD_INOUT_FAST_READ_CMD;
+    sCommand.Instruction       = BSP_QSPI_Info.ReadCmd;
+    sCommand.AddressMode       = BSP_QSPI_Info.ReadAddressMode;
+    sCommand.AddressSize       = BSP_QSPI_ADDRESS_SIZE;
+    sCommand.Address           = ReadAddr;
+    sCommand.DataMode          = BSP_QSPI_Info.ReadDataMode;
+    BSP_QSPI_ReadAlternate(&sCommand);
+    sCommand.NbData            = Size;
+    sCommand.DdrMode           = QSPI_DDR_MODE_DISABLE;
+    sCommand.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;
+    sCommand.SIOOMode          = QSPI_SIOO_INST_EVERY_CMD;
+
+    /* Configure the command */
+    QSPI_Command(&sCommand);
+
+    /* Reception of the data */
+    QSPI_Receive(pData);
+}
+
+/**
+  * @brief  用DMA读,发出指令就返回,之后用BSP_QSPI_Read_DMA_Done查询.
+  * @param  pData: Pointer to data to be read
+  * @param  ReadAddr: Read start address
+  * @param  Size: Size of data to read
+  * @note   DMA2通道7,查询方式:工程里没有DMA2_Channel7和QUADSPI的中断处理,
+  *         QSPI_Receive_DMA打开的中断进了NVIC会停在Default_Handler,所以先把这两个中断关掉.
+  *         读完之前不能发别的QSPI指令.
+  * @retval None
+  */
+void BSP_QSPI_Read_DMA(uint8_t *pData, uint32_t ReadAddr, uint32_t Size)
+{
+    QSPI_CommandTypeDef sCommand;
+
+    /* Initialize the read command */
+    sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
+    sCommand.Instruction       = BSP_QSPI_Info.ReadCmd;
+    sCommand.AddressMode       = BSP_QSPI_Info.ReadAddressMode;
+    sCommand.AddressSize       = BSP_QSPI_ADDRESS_SIZE;
+    sCommand.Address           = ReadAddr;
+    sCommand.DataMode          = BSP_QSPI_Info.ReadDataMode;
+    BSP_QSPI_ReadAlternate(&sCommand);
+    sCommand.NbData            = Size;
+    sCommand.DdrMode           = QSPI_DDR_MODE_DISABLE;
+    sCommand.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;
+    sCommand.SIOOMode          = QSPI_SIOO_INST_EVERY_CMD;
+
+    NVIC_DisableIRQ(DMA2_Channel7_IRQn);
+    NVIC_DisableIRQ(QUADSPI_IRQn);
+
+    /* Configure the command */
+    QSPI_Command(&sCommand);
+
+    /* Reception of the data */
+    QSPI_Receive_DMA(pData);
+}
+
+/**
+  * @brief  查询BSP_QSPI_Read_DMA读完没有,读完了顺便收尾,QSPI回到空闲.
+  * @retval QSPI_OK: 读完了, QSPI_BUSY: 还在读, QSPI_ERROR: 传输出错(数据不对).
+  */
+uint8_t BSP_QSPI_Read_DMA_Done(void)
+{
+    uint8_t ret = QSPI_OK;
+
+    if (LL_DMA_IsActiveFlag_TE7(DMA2))
+    {
+        ret = QSPI_ERROR;
+    }
+    else if (!LL_DMA_IsActiveFlag_TC7(DMA2))
+    {
+        return QSPI_BUSY;
+    }
+
+    /* 关掉DMA请求和中断,清掉挂起的中断,下次开中断不会误触发. */
+    CLEAR_BIT(QUADSPI->CR, QUADSPI_CR_DMAEN | QSPI_IT_TE);
+    LL_DMA_DisableChannel(DMA2, LL_DMA_CHANNEL_7);
+    LL_DMA_DisableIT_TC(DMA2, LL_DMA_CHANNEL_7);
+    LL_DMA_DisableIT_HT(DMA2, LL_DMA_CHANNEL_7);
+    LL_DMA_DisableIT_TE(DMA2, LL_DMA_CHANNEL_7);
+    LL_DMA_ClearFlag_GI7(DMA2);
+    NVIC_ClearPendingIRQ(DMA2_Channel7_IRQn);
+
+    /* 和QSPI_Receive一样,等TC再Abort回到空闲;出错的话直接Abort. */
+    if (ret == QSPI_OK)
+    {
+        while((__QSPI_GET_FLAG(QSPI_FLAG_TC)) != SET) {}
+        __QSPI_CLEAR_FLAG(QSPI_FLAG_TC);
+    }
+    QSPI_Abort();
+    NVIC_ClearPendingIRQ(QUADSPI_IRQn);
+
+    return ret;
+}
+
+/**
+  * @brief  Reads an amount of data from the QSPI memory in DTR (DDR) mode.
+  * @param  pData: Pointer to data to be read
+  * @param  ReadAddr: Read start address
+  * @param  Size: Size of data to read
+  * @note   Address and data phases are sampled on both clock edges, the
+  *         instruction is still sent in STR. The QSPI clock must be set for
+  *         DTR operation (see N25Q128A_DTR_ENABLE).
+  *         只有BSP_QSPI_Info.DtrRead的芯片才能调用,0xED是Micron的DTR 1-4-4读(Winbond/ISSI也是这个).
+  *         Micron之外的芯片dummy周期只按SFDP里STR的算,没有在板上验证过.
+  * @retval None
+  */
+void BSP_QSPI_Read_DTR(uint8_t *pData, uint32_t ReadAddr, uint32_t Size)
+{
+    QSPI_CommandTypeDef sCommand;
+
+    /* Initialize the read command */
+    sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
+    sCommand.Instruction       = DTR_QUAD_INOUT_FAST_READ_CMD;
     sCommand.AddressMode       = QSPI_ADDRESS_4_LINES;
-    sCommand.AddressSize       = QSPI_ADDRESS_24_BITS;
+    sCommand.AddressSize       = BSP_QSPI_ADDRESS_SIZE;
     sCommand.Address           = ReadAddr;
     sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
     sCommand.DataMode          = QSPI_DATA_4_LINES;
-    sCommand.DummyCycles       = N25Q128A_DUMMY_CYCLES_READ_QUAD;
+    /* VCR里配置的dummy周期对DTR读同样生效,DTR下不发mode位,一起当dummy. */
+    sCommand.DummyCycles       = BSP_QSPI_Info.ReadDummyCycles + BSP_QSPI_Info.ReadModeCycles;
     sCommand.NbData            = Size;
-    sCommand.DdrMode           = QSPI_DDR_MODE_DISABLE;
+    sCommand.DdrMode           = QSPI_DDR_MODE_ENABLE;
     sCommand.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;
     sCommand.SIOOMode          = QSPI_SIOO_INST_EVERY_CMD;
 
@@ -199,7 +411,7 @@ void BSP_QSPI_Write(uint8_t *pData, uint32_t WriteAddr, uint32_t Size)
     uint32_t end_addr, current_size, current_addr;
 
     /* Calculation of the size between the write address and the end of the page */
-    current_size = N25Q128A_PAGE_SIZE - (WriteAddr % N25Q128A_PAGE_SIZE);
+    current_size = BSP_QSPI_Info.PageSize - (WriteAddr % BSP_QSPI_Info.PageSize);
 
     /* Check if the size of the data is less than the remaining place in the page */
     if (current_size > Size)
@@ -213,11 +425,11 @@ void BSP_QSPI_Write(uint8_t *pData, uint32_t WriteAddr, uint32_t Size)
 
     /* Initialize the program command */
     sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
-    sCommand.Instruction       = EXT_QUAD_IN_FAST_PROG_CMD;
-    sCommand.AddressMode       = QSPI_ADDRESS_4_LINES;
-    sCommand.AddressSize       = QSPI_ADDRESS_24_BITS;
+    sCommand.Instruction       = BSP_QSPI_Info.ProgCmd;
+    sCommand.AddressMode       = BSP_QSPI_Info.ProgAddressMode;
+    sCommand.AddressSize       = BSP_QSPI_ADDRESS_SIZE;
     sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
-    sCommand.DataMode          = QSPI_DATA_4_LINES;
+    sCommand.DataMode          = BSP_QSPI_Info.ProgDataMode;
     sCommand.DummyCycles       = 0;
     sCommand.DdrMode           = QSPI_DDR_MODE_DISABLE;
     sCommand.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;
@@ -243,7 +455,7 @@ void BSP_QSPI_Write(uint8_t *pData, uint32_t WriteAddr, uint32_t Size)
         /* Update the address and size variables for next page programming */
         current_addr += current_size;
         pData += current_size;
-        current_size = ((current_addr + N25Q128A_PAGE_SIZE) > end_addr) ? (end_addr - current_addr) : N25Q128A_PAGE_SIZE;
+        current_size = ((current_addr + BSP_QSPI_Info.PageSize) > end_addr) ? (end_addr - current_addr) : BSP_QSPI_Info.PageSize;
     }
     while (current_addr < end_addr);
 
@@ -261,9 +473,9 @@ void BSP_QSPI_Erase_Block(uint32_t BlockAddress)
 
     /* Initialize the erase command */
     sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
-    sCommand.Instruction       = SUBSECTOR_ERASE_CMD;
+    sCommand.Instruction       = BSP_QSPI_EraseCmd(N25Q128A_SUBSECTOR_SIZE, SUBSECTOR_ERASE_CMD);
     sCommand.AddressMode       = QSPI_ADDRESS_1_LINE;
-    sCommand.AddressSize       = QSPI_ADDRESS_24_BITS;
+    sCommand.AddressSize       = BSP_QSPI_ADDRESS_SIZE;
     sCommand.Address           = BlockAddress;
     sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
     sCommand.DataMode          = QSPI_DATA_NONE;
@@ -298,9 +510,9 @@ void BSP_QSPI_Erase_Sector(uint32_t Sector)
 
     /* Initialize the erase command */
     sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
-    sCommand.Instruction       = SECTOR_ERASE_CMD;
+    sCommand.Instruction       = BSP_QSPI_EraseCmd(N25Q128A_SECTOR_SIZE, SECTOR_ERASE_CMD);
     sCommand.AddressMode       = QSPI_ADDRESS_1_LINE;
-    sCommand.AddressSize       = QSPI_ADDRESS_24_BITS;
+    sCommand.AddressSize       = BSP_QSPI_ADDRESS_SIZE;
     sCommand.Address           = (Sector * N25Q128A_SECTOR_SIZE);
     sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
     sCommand.DataMode          = QSPI_DATA_NONE;
@@ -319,11 +531,61 @@ void BSP_QSPI_Erase_Sector(uint32_t Sector)
 }
 
 
+/**
+  * @brief  Erases an area of the QSPI memory with the erase type of the given size.
+  * @param  Address: Start address, must be aligned on Size
+  * @param  Size: Erase size, one of BSP_QSPI_Info_TypeDef.EraseSize
+  * @retval None
+  */
+void BSP_QSPI_Erase(uint32_t Address, uint32_t Size)
+{
+    QSPI_CommandTypeDef sCommand;
+
+    /* Initialize the erase command */
+    sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
+    sCommand.Instruction       = BSP_QSPI_EraseCmd(Size, SUBSECTOR_ERASE_CMD);
+    sCommand.AddressMode       = QSPI_ADDRESS_1_LINE;
+    sCommand.AddressSize       = BSP_QSPI_ADDRESS_SIZE;
+    sCommand.Address           = Address;
+    sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
+    sCommand.DataMode          = QSPI_DATA_NONE;
+    sCommand.DummyCycles       = 0;
+    sCommand.DdrMode           = QSPI_DDR_MODE_DISABLE;
+    sCommand.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;
+    sCommand.SIOOMode          = QSPI_SIOO_INST_EVERY_CMD;
+
+    /* Enable write operations */
+    BSP_QSPI_WriteEnable();
+
+    /* Send the command */
+    QSPI_Command(&sCommand);
+
+    /* Configure automatic polling mode to wait for end of erase */
+    BSP_QSPI_AutoPollingMemReady();
+}
+
 /**
   * @brief  Erases the entire QSPI memory.
   * @retval None
   */
 void BSP_QSPI_Erase_Chip(void)
+{
+    BSP_QSPI_Erase_Chip_Start();
+
+    /* Configure automatic polling mode to wait for end of erase */
+    BSP_QSPI_AutoPollingMemReady();
+}
+
+/**
+  * @brief  Starts the erase of the entire QSPI memory.
+  * @retval None
+  * @note This function is non blocking meaning that bulk erase
+  *       operation is started but not completed when the function
+  *       returns. Application has to call BSP_QSPI_GetStatus()
+  *       to know when the device is available again (i.e. erase operation
+  *       completed).
+  */
+void BSP_QSPI_Erase_Chip_Start(void)
 {
     QSPI_CommandTypeDef sCommand;
 
@@ -343,9 +605,6 @@ void BSP_QSPI_Erase_Chip(void)
 
     /* Send the command */
     QSPI_Command(&sCommand);
-
-    /* Configure automatic polling mode to wait for end of erase */
-    BSP_QSPI_AutoPollingMemReady();
 }
 
 
@@ -393,6 +652,54 @@ uint8_t BSP_QSPI_GetStatus(void)
     }
 }
 
+/**
+  * @brief  Suspends an ongoing erase (or program) operation.
+  * @retval None
+  * @note Caller has to poll BSP_QSPI_GetStatus() until QSPI_SUSPENDED
+  *       before reading from the memory.
+  */
+void BSP_QSPI_SuspendErase(void)
+{
+    QSPI_CommandTypeDef sCommand;
+
+    /* Initialize the suspend command */
+    sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
+    sCommand.Instruction       = PROG_ERASE_SUSPEND_CMD;
+    sCommand.AddressMode       = QSPI_ADDRESS_NONE;
+    sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
+    sCommand.DataMode          = QSPI_DATA_NONE;
+    sCommand.DummyCycles       = 0;
+    sCommand.DdrMode           = QSPI_DDR_MODE_DISABLE;
+    sCommand.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;
+    sCommand.SIOOMode          = QSPI_SIOO_INST_EVERY_CMD;
+
+    /* Send the command */
+    QSPI_Command(&sCommand);
+}
+
+/**
+  * @brief  Resumes a suspended erase (or program) operation.
+  * @retval None
+  */
+void BSP_QSPI_ResumeErase(void)
+{
+    QSPI_CommandTypeDef sCommand;
+
+    /* Initialize the resume command */
+    sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
+    sCommand.Instruction       = PROG_ERASE_RESUME_CMD;
+    sCommand.AddressMode       = QSPI_ADDRESS_NONE;
+    sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
+    sCommand.DataMode          = QSPI_DATA_NONE;
+    sCommand.DummyCycles       = 0;
+    sCommand.DdrMode           = QSPI_DDR_MODE_DISABLE;
+    sCommand.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;
+    sCommand.SIOOMode          = QSPI_SIOO_INST_EVERY_CMD;
+
+    /* Send the command */
+    QSPI_Command(&sCommand);
+}
+
 /**
   * @brief  Configure the QSPI in memory-mapped mode
   * @retval None
@@ -404,12 +711,11 @@ void BSP_QSPI_EnableMemoryMappedMode(void)
 
     /* Configure the command for the read instruction */
     sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
-    sCommand.Instruction       = QUAD_INOUT_FAST_READ_CMD;
-    sCommand.AddressMode       = QSPI_ADDRESS_4_LINES;
-    sCommand.AddressSize       = QSPI_ADDRESS_24_BITS;
-    sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
-    sCommand.DataMode          = QSPI_DATA_4_LINES;
-    sCommand.DummyCycles       = N25Q128A_DUMMY_CYCLES_READ_QUAD;
+    sCommand.Instruction       = BSP_QSPI_Info.ReadCmd;
+    sCommand.AddressMode       = BSP_QSPI_Info.ReadAddressMode;
+    sCommand.AddressSize       = BSP_QSPI_ADDRESS_SIZE;
+    sCommand.DataMode          = BSP_QSPI_Info.ReadDataMode;
+    BSP_QSPI_ReadAlternate(&sCommand);
     sCommand.DdrMode           = QSPI_DDR_MODE_DISABLE;
     sCommand.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;
     sCommand.SIOOMode          = QSPI_SIOO_INST_EVERY_CMD;
@@ -432,7 +738,7 @@ void BSP_QSPI_RDID(BSP_QSPI_ID_TypeDef *pID)
 
     /* Initialize the erase command */
     sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
-    sCommand.Instruction       = READ_ID_CMD;
+    sCommand.Instruction       = READ_ID_CMD2; /* 0x9F是JEDEC标准的,0x9E只有Micron支持 */
     sCommand.AddressMode       = QSPI_ADDRESS_NONE;
     sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
     sCommand.DataMode          = QSPI_DATA_1_LINE;
@@ -506,6 +812,63 @@ void BSP_QSPI_Read_SPDF(BSP_QSPI_SFDP_TypeDef *pID)
     QSPI_Receive(pRxBuffPtr + 0x10);
 }
 
+/**
+  * @brief  获得当前使用的Flash参数.
+  * @param  pInfo: 复制出来的Flash参数.
+  * @retval None
+  */
+void BSP_QSPI_GetInfo(BSP_QSPI_Info_TypeDef *pInfo)
+{
+    *pInfo = BSP_QSPI_Info;
+}
+
+/**
+  * @brief  按当前读模式填读指令的交替字节(mode位)和dummy周期.
+  * @param  sCommand: 读指令,AddressMode要先填好.
+  * @note   mode周期不能让IO悬空:W25Q这类的mode位是10xx就进连续读模式,之后的指令都会被当成地址.
+  *         所以mode位按交替字节发全1,线数和地址一样.凑不成整字节的(很少见)只能当dummy.
+  * @retval None
+  */
+static void BSP_QSPI_ReadAlternate(QSPI_CommandTypeDef *sCommand)
+{
+    uint32_t lines = (sCommand->AddressMode == QSPI_ADDRESS_4_LINES) ? 4 : ((sCommand->AddressMode == QSPI_ADDRESS_2_LINES) ? 2 : 1);
+    uint32_t bits = BSP_QSPI_Info.ReadModeCycles * lines;
+
+    sCommand->AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
+    sCommand->DummyCycles = BSP_QSPI_Info.ReadDummyCycles;
+    if (bits == 0)
+    {
+        return;
+    }
+    if (((bits % 8) != 0) || (bits > 32))
+    {
+        sCommand->DummyCycles += BSP_QSPI_Info.ReadModeCycles;
+        return;
+    }
+    sCommand->AlternateByteMode = (lines == 4) ? QSPI_ALTERNATE_BYTES_4_LINES : ((lines == 2) ? QSPI_ALTERNATE_BYTES_2_LINES : QSPI_ALTERNATE_BYTES_1_LINE);
+    sCommand->AlternateBytesSize = (bits == 8) ? QSPI_ALTERNATE_BYTES_8_BITS : ((bits == 16) ? QSPI_ALTERNATE_BYTES_16_BITS :
+                                   ((bits == 24) ? QSPI_ALTERNATE_BYTES_24_BITS : QSPI_ALTERNATE_BYTES_32_BITS));
+    sCommand->AlternateBytes = 0xFFFFFFFF;
+}
+
+/**
+  * @brief  找到对应擦除大小的指令.
+  * @param  Size: 擦除大小.
+  * @param  DefaultCmd: 没有找到时用的指令.
+  * @retval 擦除指令
+  */
+static uint8_t BSP_QSPI_EraseCmd(uint32_t Size, uint8_t DefaultCmd)
+{
+    for (uint32_t i = 0; i < BSP_QSPI_ERASE_TYPES; i++)
+    {
+        if (BSP_QSPI_Info.EraseSize[i] == Size)
+        {
+            return BSP_QSPI_Info.EraseCmd[i];
+        }
+    }
+    return DefaultCmd;
+}
+
 /* 下面是HAL API,为了提供给SPIFFS临时使用,实际上修改SPIFFS也可以兼容我的专用API. */
 
 int32_t BSP_QSPI_Write_HAL(uint32_t WriteAddr,uint32_t NumByteToWrite,uint8_t * pBuffer)
@@ -526,3 +889,100 @@ int32_t BSP_QSPI_Erase_HAL(uint32_t Addr,uint32_t Num)
 			BSP_QSPI_Erase_Block(Addr >> 12);
 	return 0;
 } 
+
+/* 下面是WL_Flash的驱动接口,WL_Flash不直接调用BSP_QSPI_xxx,通过wl_flash_t的ops来访问. */
+
+static void N25Q128_WL_Read(void *drv, uint32_t addr, uint8_t *dest, uint32_t size)
+{
+    (void)drv;
+#if N25Q128A_DTR_ENABLE
+    /* 大块数据走DTR读,pos标记和state这些小数据依然走STR.芯片不支持DTR就全部走STR. */
+    if (BSP_QSPI_Info.DtrRead && (size >= N25Q128A_DTR_READ_MIN))
+    {
+        BSP_QSPI_Read_DTR(dest, addr, size);
+        return;
+    }
+#endif
+    BSP_QSPI_Read(dest, addr, size);
+}
+
+static void N25Q128_WL_Read_Start(void *drv, uint32_t addr, uint8_t *dest, uint32_t size)
+{
+    (void)drv;
+    BSP_QSPI_Read_DMA(dest, addr, size);
+}
+
+static uint8_t N25Q128_WL_Read_Done(void *drv, uint8_t wait)
+{
+    uint8_t status;
+
+    (void)drv;
+    do
+    {
+        status = BSP_QSPI_Read_DMA_Done();
+    } while (wait && (status == QSPI_BUSY));
+    return status;
+}
+
+static void N25Q128_WL_Program(void *drv, uint32_t addr, const uint8_t *src, uint32_t size)
+{
+    (void)drv;
+    BSP_QSPI_Write((uint8_t *)src, addr, size);
+}
+
+static void N25Q128_WL_Erase(void *drv, uint32_t addr, uint32_t size)
+{
+    (void)drv;
+    BSP_QSPI_Erase(addr, size);
+}
+
+static void N25Q128_WL_Erase_Chip(void *drv)
+{
+    (void)drv;
+    BSP_QSPI_Erase_Chip_Start();
+}
+
+static uint8_t N25Q128_WL_GetStatus(void *drv)
+{
+    (void)drv;
+    return BSP_QSPI_GetStatus();
+}
+
+static void N25Q128_WL_Suspend(void *drv)
+{
+    (void)drv;
+    BSP_QSPI_SuspendErase();
+}
+
+static void N25Q128_WL_Resume(void *drv)
+{
+    (void)drv;
+    BSP_QSPI_ResumeErase();
+}
+
+static void N25Q128_WL_Info(void *drv, uint32_t *chip_size, uint32_t *erase_size)
+{
+    (void)drv;
+    *chip_size = BSP_QSPI_Info.FlashSize;
+    for (uint32_t i = 0; i < WL_FLASH_ERASE_TYPES; i++)
+    {
+        erase_size[i] = (i < BSP_QSPI_ERASE_TYPES) ? BSP_QSPI_Info.EraseSize[i] : 0;
+    }
+}
+
+/* 擦除/写入都在BSP里等完成了,所以不带WL_FLASH_CAP_ASYNC;读可以走DMA. */
+const wl_flash_ops_t N25Q128_WL_Ops =
+{
+    N25Q128_WL_Read,
+    N25Q128_WL_Program,
+    N25Q128_WL_Erase,
+    N25Q128_WL_Erase_Chip,
+    N25Q128_WL_GetStatus,
+    N25Q128_WL_Suspend,
+    N25Q128_WL_Resume,
+    N25Q128_WL_Info,
+    WL_FLASH_CAP_SUSPEND | WL_FLASH_CAP_READ_DMA,
+    N25Q128A_BULK_ERASE_TYP_TIME,
+    N25Q128_WL_Read_Start,
+    N25Q128_WL_Read_Done,
+};
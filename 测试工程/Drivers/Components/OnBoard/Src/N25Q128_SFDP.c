@@ -0,0 +1,148 @@
+/**
+    描述: SFDP(JESD216)解析和编程指令选择,只改BSP_QSPI_Info_TypeDef,不碰QSPI,PC上也能编译测试(见仿真工程/Tools/WL_Sfdp.c).
+    文件: N25Q128_SFDP.c
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include "N25Q128.h"
+
+static uint8_t BSP_QSPI_SFDP_ReadMode(BSP_QSPI_Info_TypeDef *pInfo, uint32_t Field, uint32_t AddressMode, uint32_t DataMode);
+
+/**
+  * @brief  解析SFDP的JEDEC基本参数表(JESD216).
+  * @param  pSFDP: BSP_QSPI_Read_SPDF读出来的SFDP.
+  * @param  pInfo: Flash参数,调用前要填好默认值,只有SFDP里描述了的部分会被改写.
+  * @retval QSPI_OK: 解析成功, QSPI_NOT_SUPPORTED: 不是有效的SFDP,pInfo不变.
+  * @note   基本参数表前9个DWORD没有编程模式和页大小的描述,这两项保持默认值.
+  */
+uint8_t BSP_QSPI_Parse_SFDP(const BSP_QSPI_SFDP_TypeDef *pSFDP, BSP_QSPI_Info_TypeDef *pInfo)
+{
+    uint32_t dw1 = pSFDP->dwData[0];
+    uint32_t dw2 = pSFDP->dwData[1];
+    uint32_t i, j, n = 0;
+
+    /* 签名不对,或者第一个参数表不是JEDEC基本参数表(ID为0),就不解析. */
+    if ((pSFDP->Signature != BSP_QSPI_SFDP_SIGNATURE) || (pSFDP->Parameter_ID != 0x00) || (pSFDP->Parameter_Length < 9))
+    {
+        return QSPI_NOT_SUPPORTED;
+    }
+
+    /* 容量:最高位为0时是(位数 - 1),为1时是2^N位.4GB以上的地址空间用不了. */
+    if (dw2 & 0x80000000)
+    {
+        if (((dw2 & 0x7FFFFFFF) < 3) || ((dw2 & 0x7FFFFFFF) > 34))
+        {
+            return QSPI_NOT_SUPPORTED;
+        }
+        pInfo->FlashSize = 1UL << ((dw2 & 0x7FFFFFFF) - 3);
+    }
+    else
+    {
+        pInfo->FlashSize = (dw2 + 1) / 8;
+    }
+
+    /* DTR:DWORD1的bit19. */
+    pInfo->DtrRead = (dw1 >> 19) & 0x01;
+
+    /* 地址字节数:00只支持3字节,01支持3或4字节,10只支持4字节.超过16MB的就要用4字节. */
+    pInfo->AddressBytes = ((((dw1 >> 17) & 0x03) == 0x02) || ((((dw1 >> 17) & 0x03) == 0x01) && (pInfo->FlashSize > 0x1000000))) ? 4 : 3;
+
+    /* 按速度从快到慢选读指令:1-4-4,1-1-4,1-2-2,1-1-2,都没有就用1-1-1的Fast Read. */
+    if (!((dw1 & (1UL << 21)) && BSP_QSPI_SFDP_ReadMode(pInfo, pSFDP->dwData[2], QSPI_ADDRESS_4_LINES, QSPI_DATA_4_LINES)) &&
+            !((dw1 & (1UL << 22)) && BSP_QSPI_SFDP_ReadMode(pInfo, pSFDP->dwData[2] >> 16, QSPI_ADDRESS_1_LINE, QSPI_DATA_4_LINES)) &&
+            !((dw1 & (1UL << 20)) && BSP_QSPI_SFDP_ReadMode(pInfo, pSFDP->dwData[3] >> 16, QSPI_ADDRESS_2_LINES, QSPI_DATA_2_LINES)) &&
+            !((dw1 & (1UL << 16)) && BSP_QSPI_SFDP_ReadMode(pInfo, pSFDP->dwData[3], QSPI_ADDRESS_1_LINE, QSPI_DATA_2_LINES)))
+    {
+        pInfo->ReadCmd = FAST_READ_CMD;
+        pInfo->ReadDummyCycles = N25Q128A_DUMMY_CYCLES_READ;
+        pInfo->ReadModeCycles = 0;
+        pInfo->ReadAddressMode = QSPI_ADDRESS_1_LINE;
+        pInfo->ReadDataMode = QSPI_DATA_1_LINE;
+    }
+
+    /* 擦除类型1~4在DWORD8和DWORD9,每个16位:低8位是2^N的N,高8位是指令.按大小从小到大插入. */
+    for (i = 0; i < BSP_QSPI_ERASE_TYPES; i++)
+    {
+        uint32_t field = (pSFDP->dwData[7 + i / 2] >> ((i % 2) * 16)) & 0xFFFF;
+        if (((field & 0xFF) == 0) || ((field & 0xFF) > 31))
+        {
+            continue;
+        }
+        for (j = n; (j > 0) && (pInfo->EraseSize[j - 1] > (1UL << (field & 0xFF))); j--)
+        {
+            pInfo->EraseSize[j] = pInfo->EraseSize[j - 1];
+            pInfo->EraseCmd[j] = pInfo->EraseCmd[j - 1];
+        }
+        pInfo->EraseSize[j] = 1UL << (field & 0xFF);
+        pInfo->EraseCmd[j] = field >> 8;
+        n++;
+    }
+
+    /* 没有擦除类型描述,那就只看DWORD1里的4K擦除. */
+    if ((n == 0) && ((dw1 & 0x03) == 0x01))
+    {
+        pInfo->EraseSize[0] = 0x1000;
+        pInfo->EraseCmd[0] = (dw1 >> 8) & 0xFF;
+        n = 1;
+    }
+
+    /* 剩下的清空,表示没有. */
+    for (i = n; (n != 0) && (i < BSP_QSPI_ERASE_TYPES); i++)
+    {
+        pInfo->EraseSize[i] = 0;
+        pInfo->EraseCmd[i] = 0;
+    }
+
+    return QSPI_OK;
+}
+
+/**
+  * @brief  按JEDEC厂商ID选择编程指令,顺便记下厂商ID,Micron的都支持DTR读.
+  * @param  Manufacturer: BSP_QSPI_RDID读到的厂商ID.
+  * @param  pInfo: Flash参数.
+  * @note   0x12(4线地址4线数据)是Micron专有的,其他厂商同一个指令不一定是编程(W25Q的0x12是4字节地址编程,
+  *         还是单线),所以只有确认是Micron才用,其他一律用JEDEC标准的0x02单线页编程.
+  * @retval None
+  */
+void BSP_QSPI_Select_Prog(uint8_t Manufacturer, BSP_QSPI_Info_TypeDef *pInfo)
+{
+    pInfo->Manufacturer = Manufacturer;
+    if (Manufacturer == BSP_QSPI_MICRON_ID)
+    {
+        /* N25Q128A的SFDP里DTR位是0,但是0x0D/0x3D/0x6D/0xED这些DTR读都有. */
+        pInfo->DtrRead = 1;
+        pInfo->ProgCmd = EXT_QUAD_IN_FAST_PROG_CMD;
+        pInfo->ProgAddressMode = QSPI_ADDRESS_4_LINES;
+        pInfo->ProgDataMode = QSPI_DATA_4_LINES;
+    }
+    else
+    {
+        pInfo->ProgCmd = PAGE_PROG_CMD;
+        pInfo->ProgAddressMode = QSPI_ADDRESS_1_LINE;
+        pInfo->ProgDataMode = QSPI_DATA_1_LINE;
+    }
+}
+
+/**
+  * @brief  从SFDP的一个读模式描述(16位)里取出指令和dummy周期.
+  * @param  pInfo: Flash参数.
+  * @param  Field: 低5位是等待周期,5~7位是mode周期,8~15位是指令.
+  * @param  AddressMode: 这个模式的地址线数.
+  * @param  DataMode: 这个模式的数据线数.
+  * @retval 1: 已选用, 0: 指令无效没有选用.
+  */
+static uint8_t BSP_QSPI_SFDP_ReadMode(BSP_QSPI_Info_TypeDef *pInfo, uint32_t Field, uint32_t AddressMode, uint32_t DataMode)
+{
+    if (((Field >> 8) & 0xFF) == 0x00)
+    {
+        return 0;
+    }
+    pInfo->ReadCmd = (Field >> 8) & 0xFF;
+    pInfo->ReadDummyCycles = Field & 0x1F;
+    pInfo->ReadModeCycles = (Field >> 5) & 0x07;
+    pInfo->ReadAddressMode = AddressMode;
+    pInfo->ReadDataMode = DataMode;
+    return 1;
+}
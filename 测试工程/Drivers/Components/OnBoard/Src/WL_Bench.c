@@ -0,0 +1,677 @@
+/**
+    描述: WL_Flash性能测试,测读/写/擦除在不同长度和对齐下的速度和延时分布,以及不同状态下WL_Flash_Config的挂载时间.
+    文件: WL_Bench.c
+    注意: 输出是CSV,每行第一列是记录类型,'#'开头的行是下面记录的列名,方便脚本对比两次结果.
+          不用printf,板上栈很小,自己拼数字.延时单位是us,保留3位小数.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <string.h>
+#include "WL_Bench.h"
+
+/* 读写测试的长度,大于缓冲区的跳过. */
+static const uint32_t WL_Bench_Size[] = {16, 256, 4096, 16384};
+
+/* 前后两次统计,每个有一百多字节,板上任务栈小,不放在栈上. */
+static wl_flash_stats_t WL_Bench_Before;
+static wl_flash_stats_t WL_Bench_After;
+
+/**
+  * @brief  往行里追加一个字符串.
+  */
+static char *WL_Bench_Str(char *p, const char *s)
+{
+    while (*s != '\0')
+    {
+        *p++ = *s++;
+    }
+    return p;
+}
+
+/**
+  * @brief  往行里追加",数字".
+  */
+static char *WL_Bench_Num(char *p, uint32_t v)
+{
+    char tmp[10];
+    uint32_t n = 0;
+
+    *p++ = ',';
+    do
+    {
+        tmp[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v != 0);
+    while (n > 0)
+    {
+        *p++ = tmp[--n];
+    }
+    return p;
+}
+
+/**
+  * @brief  排序延时,插入排序,最多也就几十个.
+  */
+static void WL_Bench_Sort(uint64_t *a, uint32_t n)
+{
+    for (uint32_t i = 1; i < n; i++)
+    {
+        uint64_t v = a[i];
+        uint32_t j = i;
+        while ((j > 0) && (a[j - 1] > v))
+        {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = v;
+    }
+}
+
+/**
+  * @brief  往行里追加",ns换算成us保留3位小数".
+  */
+static char *WL_Bench_Us(char *p, uint64_t ns)
+{
+    uint32_t frac = (uint32_t)(ns % 1000);
+
+    p = WL_Bench_Num(p, (uint32_t)(ns / 1000));
+    *p++ = '.';
+    *p++ = '0' + frac / 100;
+    *p++ = '0' + (frac / 10) % 10;
+    *p++ = '0' + frac % 10;
+    return p;
+}
+
+/**
+  * @brief  输出一行: 类型,数字,数字...
+  * @param  Bench: 测试参数.
+  * @param  name: 第一列.
+  * @param  val: 后面的数字.
+  * @param  count: 数字个数,一行最多9个.
+  * @param  n: 不为0时最后再加上sample里的p50,p99,max,sample要有n个.
+  */
+static void WL_Bench_Line(wl_bench_t *Bench, const char *name, const uint32_t *val, uint32_t count, uint32_t n)
+{
+    char *p = WL_Bench_Str(Bench->line, name);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        p = WL_Bench_Num(p, val[i]);
+    }
+    if (n != 0)
+    {
+        WL_Bench_Sort(Bench->sample, n);
+        p = WL_Bench_Us(p, Bench->sample[(n - 1) / 2]);
+        p = WL_Bench_Us(p, Bench->sample[(n * 99 + 99) / 100 - 1]);
+        p = WL_Bench_Us(p, Bench->sample[n - 1]);
+    }
+    *p = '\0';
+    Bench->out(Bench->line);
+}
+
+/**
+  * @brief  记一次延时.
+  * @param  start: 开始时间(ns).
+  * @retval 这次用的时间(ns).
+  */
+static uint64_t WL_Bench_Sample(wl_bench_t *Bench, uint32_t i, uint64_t start)
+{
+    Bench->sample[i] = Bench->now_ns() - start;
+    return Bench->sample[i];
+}
+
+/**
+  * @brief  输出一项读写擦的结果: 操作,长度,偏移,次数,KiB/s,p50,p99,max(us).
+  * @param  total_ns: 总时间.
+  * @param  bytes: 总字节数.
+  */
+static void WL_Bench_Report(wl_bench_t *Bench, const char *name, uint32_t size, uint32_t offset, uint32_t n, uint64_t total_ns, uint64_t bytes)
+{
+    uint32_t val[4];
+
+    val[0] = size;
+    val[1] = offset;
+    val[2] = n;
+    val[3] = (total_ns == 0) ? 0 : (uint32_t)(bytes * 1000000000 / 1024 / total_ns);
+    WL_Bench_Line(Bench, name, val, 4, n);
+}
+
+/**
+  * @brief  第i次测试用的地址,每次换一个地方,不在同一个Page上反复测.
+  * @param  span: 这次测试占的大小(已经按Page对齐).
+  */
+static uint32_t WL_Bench_Addr(wl_flash_t *WL_Flash, uint32_t i, uint32_t span)
+{
+    return (i % (WL_Flash->flash_size / span)) * span;
+}
+
+/**
+  * @brief  直接擦掉两份state和cfg,下次挂载就跟全新的Flash一样.
+  */
+static void WL_Bench_Blank(wl_flash_t *WL_Flash)
+{
+    for (uint32_t addr = WL_Flash->addr_state1; addr < WL_Flash->cfg.start_addr + WL_Flash->cfg.full_mem_size; addr += WL_Flash->cfg.sector_size)
+    {
+        WL_Flash->ops->erase(WL_Flash->drv, addr, WL_Flash->cfg.sector_size);
+        while (((WL_Flash->ops->caps & WL_FLASH_CAP_ASYNC) != 0) && (WL_Flash->ops->get_status(WL_Flash->drv) == WL_FLASH_DRV_BUSY))
+        {
+            vTaskDelay(1);
+        }
+    }
+}
+
+/**
+  * @brief  测挂载时间: 挂载类型,pos,move_count,次数,p50,p99,max(us).
+  * @param  name: 状态名.
+  * @param  blank: 每次挂载前是否擦掉state.
+  */
+static void WL_Bench_Mount(wl_bench_t *Bench, wl_flash_t *WL_Flash, const char *name, uint32_t n, uint8_t blank)
+{
+    uint32_t val[3];
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (blank)
+        {
+            WL_Bench_Blank(WL_Flash);
+        }
+        uint64_t start = Bench->now_ns();
+        WL_Flash_Config(WL_Flash);
+        WL_Bench_Sample(Bench, i, start);
+    }
+    /* 挂载之后的坐标,全新的话就是初始化出来的0. */
+    val[0] = WL_Flash->state.pos;
+    val[1] = WL_Flash->state.move_count;
+    val[2] = n;
+    WL_Bench_Line(Bench, name, val, 3, n);
+}
+
+/**
+  * @brief  读写: 每种长度按对齐,错开1字节,从Page中间开始(跨Page)各测一遍,写之前擦干净,擦除不算时间,读刚才写的地方.
+  */
+static void WL_Bench_ReadWrite(wl_bench_t *Bench, wl_flash_t *WL_Flash, uint32_t n)
+{
+    uint32_t page = WL_Flash->cfg.page_size;
+    uint64_t total, start;
+
+    Bench->out("#op,size,offset,n,kib_s,p50_us,p99_us,max_us");
+    for (uint32_t s = 0; s < sizeof(WL_Bench_Size) / sizeof(WL_Bench_Size[0]); s++)
+    {
+        uint32_t size = WL_Bench_Size[s];
+        uint32_t offset_list[3] = {0, 1, page / 2};
+        if (size > Bench->buf_size)
+        {
+            continue;
+        }
+        for (uint32_t o = 0; o < 3; o++)
+        {
+            uint32_t offset = offset_list[o];
+            uint32_t span = (offset + size + page - 1) / page * page;
+
+            total = 0;
+            for (uint32_t i = 0; i < n; i++)
+            {
+                uint32_t addr = WL_Bench_Addr(WL_Flash, i, span);
+                for (uint32_t j = 0; j < size; j++)
+                {
+                    Bench->buf[j] = (uint8_t)(i + j);
+                }
+                WL_Flash_Erase_Range(WL_Flash, addr, span);
+                start = Bench->now_ns();
+                WL_Flash_Write(WL_Flash, addr + offset, Bench->buf, size);
+                total += WL_Bench_Sample(Bench, i, start);
+            }
+            WL_Bench_Report(Bench, "write", size, offset, n, total, (uint64_t)size * n);
+
+            total = 0;
+            for (uint32_t i = 0; i < n; i++)
+            {
+                start = Bench->now_ns();
+                WL_Flash_Read(WL_Flash, WL_Bench_Addr(WL_Flash, i, span) + offset, Bench->buf, size);
+                total += WL_Bench_Sample(Bench, i, start);
+            }
+            WL_Bench_Report(Bench, "read", size, offset, n, total, (uint64_t)size * n);
+        }
+    }
+}
+
+/**
+  * @brief  反复读同一个地方,配置了读缓存的话除了第一次都命中,第一次不算时间.
+  */
+static void WL_Bench_Reread(wl_bench_t *Bench, wl_flash_t *WL_Flash, uint32_t n)
+{
+    uint64_t total, start;
+
+    for (uint32_t size = 16; (size <= 256) && (size <= Bench->buf_size); size *= 16)
+    {
+        total = 0;
+        WL_Flash_Read(WL_Flash, 0, Bench->buf, size);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            start = Bench->now_ns();
+            WL_Flash_Read(WL_Flash, 0, Bench->buf, size);
+            total += WL_Bench_Sample(Bench, i, start);
+        }
+        WL_Bench_Report(Bench, "reread", size, 0, n, total, (uint64_t)size * n);
+    }
+}
+
+/**
+  * @brief  流式读,512字节一块顺序往下读,每块之间消费者处理work_us.延时就是消费者等Flash的时间,
+  *         速度按总时间(含处理)算,配置了顺序预读的话处理的时候DMA在后台读下一块.
+  */
+static void WL_Bench_Stream(wl_bench_t *Bench, wl_flash_t *WL_Flash, uint32_t n)
+{
+    uint64_t begin, total, start, stall = 0;
+    uint32_t val[5];
+
+    if (Bench->buf_size < 512)
+    {
+        return;
+    }
+    begin = Bench->now_ns();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        start = Bench->now_ns();
+        WL_Flash_Read(WL_Flash, i * 512, Bench->buf, 512);
+        stall += WL_Bench_Sample(Bench, i, start);
+        if (Bench->work != NULL)
+        {
+            Bench->work(Bench->work_us);
+        }
+    }
+    total = Bench->now_ns() - begin;
+    val[0] = 512;
+    val[1] = Bench->work_us;
+    val[2] = n;
+    val[3] = (total == 0) ? 0 : (uint32_t)((uint64_t)512 * n * 1000000000 / 1024 / total);
+    val[4] = (uint32_t)(stall / 1000);
+    Bench->out("#stream,chunk,work_us,n,kib_s,stall_us,p50_us,p99_us,max_us");
+    WL_Bench_Line(Bench, "stream", val, 5, n);
+}
+
+/**
+  * @brief  32字节的小记录一条接一条写,最后WL_Flash_Sync,看写缓冲省了多少次编程指令(没开统计的话是0).
+  */
+static void WL_Bench_Records(wl_bench_t *Bench, wl_flash_t *WL_Flash, uint32_t n)
+{
+    uint32_t page = WL_Flash->cfg.page_size;
+    uint32_t rec[3];
+    uint64_t start;
+
+    if (Bench->buf_size < 32)
+    {
+        return;
+    }
+    WL_Flash_Erase_Range(WL_Flash, 0, page);
+    WL_Flash_GetStats(WL_Flash, &WL_Bench_Before, 0);
+    for (uint32_t i = 0; i < 32; i++)
+    {
+        Bench->buf[i] = (uint8_t)i;
+    }
+    for (uint32_t i = 0; i < n; i++)
+    {
+        start = Bench->now_ns();
+        WL_Flash_Write(WL_Flash, (i * 32) % page, Bench->buf, 32);
+        WL_Bench_Sample(Bench, i, start);
+    }
+    WL_Flash_Sync(WL_Flash);
+    WL_Flash_GetStats(WL_Flash, &WL_Bench_After, 0);
+    rec[0] = 32;
+    rec[1] = n;
+    rec[2] = WL_Bench_After.flash_program_ops - WL_Bench_Before.flash_program_ops;
+    Bench->out("#records,size,n,program_ops,p50_us,p99_us,max_us");
+    WL_Bench_Line(Bench, "records", rec, 3, n);
+}
+
+/**
+  * @brief  定期保存512字节的配置,8次里6次没变,1次只清了一个标志位,1次改了一个值.
+  *         config_erase是以前的用法(每次先擦再写),config_update用WL_Flash_Update,对比擦除次数和写入字节数.
+  */
+static void WL_Bench_Settings(wl_bench_t *Bench, wl_flash_t *WL_Flash, uint32_t n)
+{
+    static const char *mode[2] = {"config_erase", "config_update"};
+    uint32_t page = WL_Flash->cfg.page_size;
+    uint32_t cfg[4];
+    uint64_t start;
+
+    if (Bench->buf_size < 512)
+    {
+        return;
+    }
+    Bench->out("#config,size,n,erase_ops,program_bytes,p50_us,p99_us,max_us");
+    for (uint32_t m = 0; m < 2; m++)
+    {
+        for (uint32_t j = 0; j < 512; j++)
+        {
+            Bench->buf[j] = (uint8_t)(j * 7);
+        }
+        WL_Flash_Erase_Range(WL_Flash, 0, page);
+        WL_Flash_Write(WL_Flash, 0, Bench->buf, 512);
+        WL_Flash_GetStats(WL_Flash, &WL_Bench_Before, 0);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (i % 8 == 3)
+            {
+                Bench->buf[i % 512] &= (uint8_t)~(1 << (i % 8));
+            }
+            else if (i % 8 == 7)
+            {
+                Bench->buf[(i * 13) % 512]++;
+            }
+            start = Bench->now_ns();
+            if (m == 0)
+            {
+                WL_Flash_Erase_Range(WL_Flash, 0, page);
+                WL_Flash_Write(WL_Flash, 0, Bench->buf, 512);
+            }
+            else
+            {
+                WL_Flash_Update(WL_Flash, 0, Bench->buf, 512);
+            }
+            WL_Bench_Sample(Bench, i, start);
+        }
+        WL_Flash_Sync(WL_Flash);
+        WL_Flash_GetStats(WL_Flash, &WL_Bench_After, 0);
+        cfg[0] = 512;
+        cfg[1] = n;
+        cfg[2] = WL_Bench_After.flash_erase_ops - WL_Bench_Before.flash_erase_ops;
+        cfg[3] = (uint32_t)(WL_Bench_After.flash_program - WL_Bench_Before.flash_program);
+        WL_Bench_Line(Bench, mode[m], cfg, 4, n);
+    }
+}
+
+/**
+  * @brief  计数器,每次加一就保存.counter_erase是以前的用法,每次先擦再写4字节的计数,测n次;
+  *         counter_update用WL_Flash_Update写64字节,前4字节是基数,后面480位每加一清一位,用完基数加480,位图回到全1,测64n次.
+  *         输出位数,次数,擦除指令数,每1000次的擦除数,每次平均和最长用时(us).
+  */
+static void WL_Bench_Counter(wl_bench_t *Bench, wl_flash_t *WL_Flash, uint32_t n)
+{
+    uint32_t page = WL_Flash->cfg.page_size;
+    uint32_t cnt[4];
+
+    if (Bench->buf_size < 64)
+    {
+        return;
+    }
+    Bench->out("#counter,bits,incs,erase_ops,erases_per_1k,mean_us,max_us");
+    for (uint32_t m = 0; m < 2; m++)
+    {
+        uint32_t incs = (m == 0) ? n : (n * 64);
+        uint64_t total = 0, worst = 0, took, start;
+        char *p;
+
+        WL_Flash_Erase_Range(WL_Flash, 0, page);
+        WL_Flash_GetStats(WL_Flash, &WL_Bench_Before, 0);
+        for (uint32_t c = 1; c <= incs; c++)
+        {
+            uint32_t base = (m == 0) ? c : (c / 480 * 480), bits = c - base;
+
+            memcpy(Bench->buf, &base, 4);
+            memset(&Bench->buf[4], 0xFF, 60);
+            memset(&Bench->buf[4], 0x00, bits / 8);
+            if (bits % 8 != 0)
+            {
+                Bench->buf[4 + bits / 8] = (uint8_t)(0xFF << (bits % 8));
+            }
+            start = Bench->now_ns();
+            if (m == 0)
+            {
+                WL_Flash_Erase_Range(WL_Flash, 0, page);
+                WL_Flash_Write(WL_Flash, 0, Bench->buf, 4);
+            }
+            else
+            {
+                WL_Flash_Update(WL_Flash, 0, Bench->buf, 64);
+            }
+            took = Bench->now_ns() - start;
+            total += took;
+            worst = (took > worst) ? took : worst;
+        }
+        WL_Flash_Sync(WL_Flash);
+        WL_Flash_GetStats(WL_Flash, &WL_Bench_After, 0);
+        cnt[0] = (m == 0) ? 32 : 480;
+        cnt[1] = incs;
+        cnt[2] = WL_Bench_After.flash_erase_ops - WL_Bench_Before.flash_erase_ops;
+        cnt[3] = (uint32_t)((uint64_t)cnt[2] * 1000 / incs);
+        /* 次数比WL_BENCH_SAMPLES多,不排序,只给平均和最长. */
+        p = WL_Bench_Str(Bench->line, (m == 0) ? "counter_erase" : "counter_update");
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            p = WL_Bench_Num(p, cnt[i]);
+        }
+        p = WL_Bench_Us(p, total / incs);
+        p = WL_Bench_Us(p, worst);
+        *p = '\0';
+        Bench->out(Bench->line);
+    }
+}
+
+/**
+  * @brief  100字节的小补丁写到前4个Page的任意位置,内容每次都变,基本上都要擦.patch_update用WL_Flash_Update(在RAM里拼整个sector),
+  *         patch_program用WL_Flash_Program(经过dummy合并).
+  *         ram_bound是按代码算出来的上限,不是测出来的: 除了一直都在的temp_buff,合并最多还要多少RAM.
+  *         WL_Flash_Update比较完(栈上比较块)才申请sector大小的内存,两个不同时在,但是开了丢弃位图的话,
+  *         写回时trimRevive的比较块和它同时在;WL_Flash_Program只用栈上一个比较块(比较和trimRevive不同时),拼接用temp_buff.
+  */
+static void WL_Bench_Patch(wl_bench_t *Bench, wl_flash_t *WL_Flash, uint32_t n)
+{
+    static const char *mode[2] = {"patch_update", "patch_program"};
+    uint32_t page = WL_Flash->cfg.page_size;
+    uint32_t pat[4];
+    uint64_t start;
+
+    if (Bench->buf_size < 100)
+    {
+        return;
+    }
+    Bench->out("#patch,size,n,erase_ops,ram_bound,p50_us,p99_us,max_us");
+    for (uint32_t m = 0; m < 2; m++)
+    {
+        WL_Flash_GetStats(WL_Flash, &WL_Bench_Before, 0);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            uint32_t addr = (i % 4) * page + (i * 389) % (page - 100);
+            for (uint32_t j = 0; j < 100; j++)
+            {
+                Bench->buf[j] = (uint8_t)(i * 31 + j + m);
+            }
+            start = Bench->now_ns();
+            if (m == 0)
+            {
+                WL_Flash_Update(WL_Flash, addr, Bench->buf, 100);
+            }
+            else
+            {
+                WL_Flash_Program(WL_Flash, addr, Bench->buf, 100);
+            }
+            WL_Bench_Sample(Bench, i, start);
+        }
+        WL_Flash_GetStats(WL_Flash, &WL_Bench_After, 0);
+        pat[0] = 100;
+        pat[1] = n;
+        pat[2] = WL_Bench_After.flash_erase_ops - WL_Bench_Before.flash_erase_ops;
+        if (m == 0)
+        {
+            pat[3] = WL_Flash->cfg.sector_size + ((WL_Flash->trim_map != NULL) ? WL_FLASH_CMP_CHUNK : 0);
+            pat[3] = (pat[3] > WL_FLASH_CMP_CHUNK) ? pat[3] : WL_FLASH_CMP_CHUNK;
+        }
+        else
+        {
+            pat[3] = WL_FLASH_CMP_CHUNK;
+        }
+        WL_Bench_Line(Bench, mode[m], pat, 4, n);
+    }
+}
+
+/**
+  * @brief  擦除,只能按sector,没有偏移.
+  */
+static void WL_Bench_Erase(wl_bench_t *Bench, wl_flash_t *WL_Flash, uint32_t n)
+{
+    uint32_t page = WL_Flash->cfg.page_size;
+    uint64_t total, start;
+
+    for (uint32_t pages = 1; pages <= 16; pages *= 4)
+    {
+        total = 0;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            start = Bench->now_ns();
+            WL_Flash_Erase_Range(WL_Flash, WL_Bench_Addr(WL_Flash, i, pages * page), pages * page);
+            total += WL_Bench_Sample(Bench, i, start);
+        }
+        WL_Bench_Report(Bench, "erase", pages * page, 0, n, total, (uint64_t)pages * page * n);
+    }
+}
+
+/**
+  * @brief  上面这些读写擦的放大情况,挂载和格式化不算.定义WL_FLASH_NO_STATS时全是0.
+  */
+static void WL_Bench_Stats(wl_bench_t *Bench, wl_flash_t *WL_Flash)
+{
+    uint32_t st[9];
+
+    WL_Flash_GetStats(WL_Flash, &WL_Bench_After, 1);
+    st[0] = (uint32_t)WL_Bench_After.user_write;
+    st[1] = (uint32_t)WL_Bench_After.flash_program;
+    st[2] = (uint32_t)WL_Bench_After.user_erase;
+    st[3] = (uint32_t)WL_Bench_After.flash_erase;
+    st[4] = (uint32_t)WL_Bench_After.reloc;
+    st[5] = WL_Bench_After.wl_updates;
+    st[6] = WL_Bench_After.state_rewrites;
+    st[7] = WL_Bench_After.cache_hits;
+    st[8] = WL_Bench_After.cache_misses;
+    Bench->out("#stats,user_write,flash_program,user_erase,flash_erase,reloc,wl_updates,state_rewrites,cache_hits,cache_misses");
+    WL_Bench_Line(Bench, "stats", st, 9, 0);
+}
+
+/**
+  * @brief  模拟日志型文件系统: 第0个sector是目录,每个文件改写一次;文件按1~4个sector轮流,在其余sector里从前往后环形分配,
+  *         活的文件占到四分之一就删最老的.fs_keep删了不管,fs_discard删的时候WL_Flash_Discard,对比挪dummy复制了多少.
+  *         两次都先格式化,操作序列一模一样.要配置cfg.trim_sectors才测.
+  */
+static void WL_Bench_Fs(wl_bench_t *Bench, wl_flash_t *WL_Flash, uint32_t n)
+{
+    uint32_t sectors = WL_Flash->flash_size / WL_Flash->cfg.sector_size - 1;
+    uint32_t chunk = (Bench->buf_size < WL_Flash->cfg.sector_size) ? Bench->buf_size : WL_Flash->cfg.sector_size;
+    uint32_t fsv[7];
+    uint64_t total, start;
+
+    if (WL_Flash->trim_map == NULL)
+    {
+        return;
+    }
+    memset(Bench->buf, 0x5A, chunk);
+    Bench->out("#fs,discard,files,sector_writes,reloc_kib,skipped_kib,erase_ops,total_ms");
+    for (uint32_t m = 0; m < 2; m++)
+    {
+        uint32_t head = 0, tail = 0, live = 0, oldest = 0, writes = 0;
+
+        WL_Flash_Format(WL_Flash, NULL);
+        WL_Flash_GetStats(WL_Flash, &WL_Bench_After, 1);
+        start = Bench->now_ns();
+        for (uint32_t f = 0; f < n * 16; f++)
+        {
+            /* 新文件写在head,再改目录. */
+            for (uint32_t k = 0; k <= f % 4; k++)
+            {
+                uint32_t addr = (1 + head) * WL_Flash->cfg.sector_size;
+                WL_Flash_Erase_Range(WL_Flash, addr, WL_Flash->cfg.sector_size);
+                for (uint32_t off = 0; off < WL_Flash->cfg.sector_size; off += chunk)
+                {
+                    WL_Flash_Write(WL_Flash, addr + off, Bench->buf, chunk);
+                }
+                head = (head + 1) % sectors;
+                live++;
+                writes++;
+            }
+            WL_Flash_Erase_Range(WL_Flash, 0, WL_Flash->cfg.sector_size);
+            WL_Flash_Write(WL_Flash, 0, Bench->buf, chunk);
+            writes++;
+            /* 超过四分之一就从最老的文件开始删. */
+            while (live > sectors / 4)
+            {
+                for (uint32_t k = 0; k <= oldest % 4; k++)
+                {
+                    if (m == 1)
+                    {
+                        WL_Flash_Discard(WL_Flash, (1 + tail) * WL_Flash->cfg.sector_size, WL_Flash->cfg.sector_size);
+                    }
+                    tail = (tail + 1) % sectors;
+                    live--;
+                }
+                oldest++;
+            }
+        }
+        total = Bench->now_ns() - start;
+        WL_Flash_GetStats(WL_Flash, &WL_Bench_After, 0);
+        fsv[0] = m;
+        fsv[1] = n * 16;
+        fsv[2] = writes;
+        fsv[3] = (uint32_t)(WL_Bench_After.reloc / 1024);
+        fsv[4] = (uint32_t)(WL_Bench_After.discard_skipped / 1024);
+        fsv[5] = WL_Bench_After.flash_erase_ops;
+        fsv[6] = (uint32_t)(total / 1000000);
+        WL_Bench_Line(Bench, (m == 0) ? "fs_keep" : "fs_discard", fsv, 7, 0);
+    }
+}
+
+/**
+  * @brief  挂载时间主要看recoverPos要扫多少坐标,分别测全新,刚格式化,用了一半,转过一圈.
+  */
+static void WL_Bench_Mounts(wl_bench_t *Bench, wl_flash_t *WL_Flash, uint32_t n)
+{
+    n = (n > 8) ? 8 : n;
+    Bench->out("#mount,pos,move_count,n,p50_us,p99_us,max_us");
+    WL_Bench_Mount(Bench, WL_Flash, "mount_blank", n, 1);
+    WL_Flash_Format(WL_Flash, NULL);
+    WL_Bench_Mount(Bench, WL_Flash, "mount_fresh", n, 0);
+    while (WL_Flash->state.pos < WL_Flash->state.max_pos / 2)
+    {
+        WL_Flash_Erase_Range(WL_Flash, 0, WL_Flash->cfg.sector_size);
+    }
+    WL_Bench_Mount(Bench, WL_Flash, "mount_half", n, 0);
+    while (WL_Flash->state.move_count == 0)
+    {
+        WL_Flash_Erase_Range(WL_Flash, 0, WL_Flash->cfg.sector_size);
+    }
+    WL_Bench_Mount(Bench, WL_Flash, "mount_wrapped", n, 0);
+}
+
+/**
+  * @brief  跑全部测试.
+  * @param  Bench: 测试参数,now_ns,out,buf,buf_size必须填好.
+  * @param  WL_Flash: 磨损平衡结构体,cfg,ops,drv填好就行,还没有WL_Flash_Config过.
+  */
+void WL_Bench_Run(wl_bench_t *Bench, wl_flash_t *WL_Flash)
+{
+    uint32_t n = ((Bench->iterations == 0) || (Bench->iterations > WL_BENCH_SAMPLES)) ? WL_BENCH_SAMPLES : Bench->iterations;
+    uint32_t val[5];
+
+    WL_Flash_Config(WL_Flash);
+    WL_Flash_Format(WL_Flash, NULL);
+    WL_Flash_GetStats(WL_Flash, &WL_Bench_After, 1);
+
+    val[0] = WL_BENCH_VERSION;
+    val[1] = WL_Flash->cfg.full_mem_size;
+    val[2] = WL_Flash->cfg.page_size;
+    val[3] = WL_Flash->flash_size;
+    val[4] = WL_Flash->state.max_pos;
+    Bench->out("#bench,version,area,page,user_size,max_pos");
+    WL_Bench_Line(Bench, "bench", val, 5, 0);
+
+    WL_Bench_ReadWrite(Bench, WL_Flash, n);
+    WL_Bench_Reread(Bench, WL_Flash, n);
+    WL_Bench_Stream(Bench, WL_Flash, n);
+    WL_Bench_Records(Bench, WL_Flash, n);
+    WL_Bench_Settings(Bench, WL_Flash, n);
+    WL_Bench_Counter(Bench, WL_Flash, n);
+    WL_Bench_Patch(Bench, WL_Flash, n);
+    WL_Bench_Erase(Bench, WL_Flash, n);
+    WL_Bench_Stats(Bench, WL_Flash);
+    WL_Bench_Fs(Bench, WL_Flash, n);
+    WL_Bench_Mounts(Bench, WL_Flash, n);
+}
@@ -0,0 +1,199 @@
+/**
+    描述: 512字节扇区的块设备,见WL_Disk.h.
+    文件: WL_Disk.c
+    注意: 不是线程安全的,和WL_Flash一样,多个任务用要自己加锁(FatFs开FF_FS_REENTRANT就行).
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <string.h>
+#include "WL_Disk.h"
+
+static uint8_t WL_Disk_Store(wl_disk_t *Disk, uint32_t address, const uint8_t *src);
+static uint8_t WL_Disk_Flush(wl_disk_t *Disk);
+
+/**
+  * @brief  写回一个整sector.
+  * @param  Disk: 块设备.
+  * @param  address: sector的逻辑地址.
+  * @param  src: 一个sector的内容.
+  * @retval 1: 成功, 0: 失败.
+  * @note   内容一样的不写,只有1变0的不擦,整个sector给全了WL_Flash_Update也不用再申请内存.
+  */
+static uint8_t WL_Disk_Store(wl_disk_t *Disk, uint32_t address, const uint8_t *src)
+{
+    if (Disk->atomic)
+    {
+        return WL_Flash_Program(Disk->flash, address, src, Disk->flash->cfg.sector_size);
+    }
+    return WL_Flash_Update(Disk->flash, address, src, Disk->flash->cfg.sector_size);
+}
+
+/**
+  * @brief  合并缓冲改过的话写回去,缓冲内容留着当读缓存.
+  * @param  Disk: 块设备.
+  * @retval 1: 成功, 0: 失败.
+  */
+static uint8_t WL_Disk_Flush(wl_disk_t *Disk)
+{
+    if (!Disk->buf_dirty)
+    {
+        return 1;
+    }
+    Disk->buf_dirty = 0;
+    return WL_Disk_Store(Disk, Disk->buf_addr, Disk->buf);
+}
+
+/**
+  * @brief  初始化块设备,申请合并缓冲.
+  * @param  Disk: 块设备,atomic要先填好,第一次用之前其他字段要是0(全局变量本来就是).
+  * @param  WL_Flash: 磨损平衡结构体(必须已经被初始化).
+  * @retval 1: 成功, 0: 申请不到sector大小的内存,或者sector不是512的倍数.
+  * @note   重新挂载WL_Flash之后也要再调一次,缓冲里的旧内容会丢掉.
+  */
+uint8_t WL_Disk_Init(wl_disk_t *Disk, wl_flash_t *WL_Flash)
+{
+    if ((WL_Flash->cfg.sector_size % WL_DISK_SECTOR_SIZE) != 0)
+    {
+        return 0;
+    }
+    if ((Disk->buf == NULL) || (Disk->flash == NULL) || (Disk->flash->cfg.sector_size != WL_Flash->cfg.sector_size))
+    {
+        if (Disk->buf != NULL)
+        {
+            vPortFree(Disk->buf);
+        }
+        Disk->buf = (uint8_t *)pvPortMalloc(WL_Flash->cfg.sector_size);
+        if (Disk->buf == NULL)
+        {
+            return 0;
+        }
+    }
+    Disk->flash = WL_Flash;
+    Disk->sectors = WL_Flash->flash_size / WL_DISK_SECTOR_SIZE;
+    Disk->buf_valid = 0;
+    Disk->buf_dirty = 0;
+    return 1;
+}
+
+/**
+  * @brief  读扇区.
+  * @param  Disk: 块设备.
+  * @param  sector: 第一个扇区号.
+  * @param  dest: 读到这里.
+  * @param  count: 扇区数.
+  * @retval 1: 成功, 0: 超出范围.
+  * @note   多个扇区一次WL_Flash_Read读完,合并缓冲里还没写回的再盖上去.
+  */
+uint8_t WL_Disk_Read(wl_disk_t *Disk, uint32_t sector, uint8_t *dest, uint32_t count)
+{
+    uint32_t address = sector * WL_DISK_SECTOR_SIZE;
+    uint32_t size = count * WL_DISK_SECTOR_SIZE;
+
+    if ((sector >= Disk->sectors) || (count > Disk->sectors - sector))
+    {
+        return 0;
+    }
+    WL_Flash_Read(Disk->flash, address, dest, size);
+    if (Disk->buf_dirty && (Disk->buf_addr + Disk->flash->cfg.sector_size > address) && (Disk->buf_addr < address + size))
+    {
+        uint32_t lo = (Disk->buf_addr > address) ? Disk->buf_addr : address;
+        uint32_t hi = (Disk->buf_addr + Disk->flash->cfg.sector_size < address + size) ? (Disk->buf_addr + Disk->flash->cfg.sector_size) : (address + size);
+        memcpy(&dest[lo - address], &Disk->buf[lo - Disk->buf_addr], hi - lo);
+    }
+    return 1;
+}
+
+/**
+  * @brief  写扇区.
+  * @param  Disk: 块设备.
+  * @param  sector: 第一个扇区号.
+  * @param  src: 数据.
+  * @param  count: 扇区数.
+  * @retval 1: 成功, 0: 超出范围或者写回失败.
+  * @note   按Flash sector分段:整个sector的直接写;不满的拼进合并缓冲,缓冲里是别的sector就先把那个写回去.
+  */
+uint8_t WL_Disk_Write(wl_disk_t *Disk, uint32_t sector, const uint8_t *src, uint32_t count)
+{
+    uint32_t address = sector * WL_DISK_SECTOR_SIZE;
+    uint32_t size = count * WL_DISK_SECTOR_SIZE;
+    uint32_t block = Disk->flash->cfg.sector_size;
+    uint8_t result = 1;
+
+    if ((sector >= Disk->sectors) || (count > Disk->sectors - sector))
+    {
+        return 0;
+    }
+    for (uint32_t done = 0; done < size;)
+    {
+        uint32_t base = (address + done) - (address + done) % block;
+        uint32_t offset = address + done - base;
+        uint32_t len = ((block - offset) < (size - done)) ? (block - offset) : (size - done);
+
+        if (len == block)
+        {
+            /* 整个sector都给了,缓冲里的旧内容不要了. */
+            if (Disk->buf_valid && (Disk->buf_addr == base))
+            {
+                Disk->buf_valid = 0;
+                Disk->buf_dirty = 0;
+            }
+            result &= WL_Disk_Store(Disk, base, &src[done]);
+        }
+        else
+        {
+            if (!Disk->buf_valid || (Disk->buf_addr != base))
+            {
+                result &= WL_Disk_Flush(Disk);
+                WL_Flash_Read(Disk->flash, base, Disk->buf, block);
+                Disk->buf_addr = base;
+                Disk->buf_valid = 1;
+            }
+            memcpy(&Disk->buf[offset], &src[done], len);
+            Disk->buf_dirty = 1;
+        }
+        done += len;
+    }
+    return result;
+}
+
+/**
+  * @brief  把合并缓冲和WL_Flash的写缓冲都写回Flash.
+  * @param  Disk: 块设备.
+  * @retval 1: 成功, 0: 写回失败.
+  */
+uint8_t WL_Disk_Sync(wl_disk_t *Disk)
+{
+    uint8_t result = WL_Disk_Flush(Disk);
+
+    WL_Flash_Sync(Disk->flash);
+    return result;
+}
+
+/**
+  * @brief  告诉下面这些扇区不要了(文件系统删文件时的TRIM).
+  * @param  Disk: 块设备.
+  * @param  sector: 第一个扇区号.
+  * @param  count: 扇区数.
+  * @retval 1: 成功, 0: 超出范围.
+  * @note   只有整个落在范围里的Flash sector才会丢弃,WL_Flash没有丢弃位图(cfg.trim_sectors为0)的话什么也不做.
+  */
+uint8_t WL_Disk_Trim(wl_disk_t *Disk, uint32_t sector, uint32_t count)
+{
+    uint32_t address = sector * WL_DISK_SECTOR_SIZE;
+    uint32_t size = count * WL_DISK_SECTOR_SIZE;
+
+    if ((sector >= Disk->sectors) || (count > Disk->sectors - sector))
+    {
+        return 0;
+    }
+    /* 缓冲里的sector整个丢弃了,就不用再写回了. */
+    if (Disk->buf_valid && (Disk->buf_addr >= address) && (Disk->buf_addr + Disk->flash->cfg.sector_size <= address + size))
+    {
+        Disk->buf_valid = 0;
+        Disk->buf_dirty = 0;
+    }
+    WL_Flash_Discard(Disk->flash, address, size);
+    return 1;
+}
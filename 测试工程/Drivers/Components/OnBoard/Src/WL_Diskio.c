@@ -0,0 +1,127 @@
+/**
+    描述: FatFs的diskio,把第0个驱动器挂在WL_Disk上,FAT就放在磨损平衡区域里.
+    文件: WL_Diskio.c
+    注意: 工程里没有FatFs,这个文件不在工程里.加FatFs的时候用它代替FatFs自带的diskio.c,
+          ffconf.h里扇区大小用512(FF_MAX_SS/_MAX_SS),要TRIM就打开FF_USE_TRIM/_USE_TRIM,
+          格式化时f_mkfs的簇大小取Flash sector(4K)的倍数,簇和sector对齐,写数据基本都是整sector.
+          CubeMX给L4生成的是R0.12c,扇区号是DWORD;R0.14以后是LBA_t,按FF_LBA64区分.
+          MWL_Flash要先WL_Flash_Config过,get_fattime要自己提供(或者打开FF_FS_NORTC).
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include "ff.h"
+#include "diskio.h"
+#include "WL_Disk.h"
+
+#ifdef FF_LBA64
+#define WL_DISKIO_LBA LBA_t
+#else
+#define WL_DISKIO_LBA DWORD
+#endif
+
+/* R0.12c的CTRL_TRIM;更早的版本叫CTRL_ERASE_SECTOR,参数一样是起止扇区号. */
+#if !defined(CTRL_TRIM) && defined(CTRL_ERASE_SECTOR)
+#define CTRL_TRIM CTRL_ERASE_SECTOR
+#endif
+
+extern wl_flash_t MWL_Flash;
+
+static wl_disk_t WL_Diskio_Disk;
+static DSTATUS WL_Diskio_Stat = STA_NOINIT;
+
+/**
+  * @brief  驱动器状态.
+  * @param  pdrv: 驱动器号,只有0.
+  */
+DSTATUS disk_status(BYTE pdrv)
+{
+    return (pdrv == 0) ? WL_Diskio_Stat : STA_NOINIT;
+}
+
+/**
+  * @brief  初始化驱动器,申请合并缓冲.
+  * @param  pdrv: 驱动器号,只有0.
+  */
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    if (pdrv != 0)
+    {
+        return STA_NOINIT;
+    }
+    WL_Diskio_Stat = WL_Disk_Init(&WL_Diskio_Disk, &MWL_Flash) ? 0 : STA_NOINIT;
+    return WL_Diskio_Stat;
+}
+
+/**
+  * @brief  读扇区.
+  */
+DRESULT disk_read(BYTE pdrv, BYTE *buff, WL_DISKIO_LBA sector, UINT count)
+{
+    if ((pdrv != 0) || (count == 0))
+    {
+        return RES_PARERR;
+    }
+    if (WL_Diskio_Stat & STA_NOINIT)
+    {
+        return RES_NOTRDY;
+    }
+    return WL_Disk_Read(&WL_Diskio_Disk, (uint32_t)sector, buff, count) ? RES_OK : RES_PARERR;
+}
+
+/**
+  * @brief  写扇区,几个扇区连着写的话同一个Flash sector只写回一次.
+  */
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, WL_DISKIO_LBA sector, UINT count)
+{
+    if ((pdrv != 0) || (count == 0))
+    {
+        return RES_PARERR;
+    }
+    if (WL_Diskio_Stat & STA_NOINIT)
+    {
+        return RES_NOTRDY;
+    }
+    return WL_Disk_Write(&WL_Diskio_Disk, (uint32_t)sector, buff, count) ? RES_OK : RES_ERROR;
+}
+
+/**
+  * @brief  其他控制: 同步,容量,擦除块大小,TRIM.
+  */
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    if (pdrv != 0)
+    {
+        return RES_PARERR;
+    }
+    if (WL_Diskio_Stat & STA_NOINIT)
+    {
+        return RES_NOTRDY;
+    }
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        return WL_Disk_Sync(&WL_Diskio_Disk) ? RES_OK : RES_ERROR;
+    case GET_SECTOR_COUNT:
+        *(WL_DISKIO_LBA *)buff = WL_Diskio_Disk.sectors;
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = WL_DISK_SECTOR_SIZE;
+        return RES_OK;
+    case GET_BLOCK_SIZE:
+        /* 擦除块是多少个扇区,f_mkfs按这个对齐数据区. */
+        *(DWORD *)buff = WL_Diskio_Disk.flash->cfg.sector_size / WL_DISK_SECTOR_SIZE;
+        return RES_OK;
+#ifdef CTRL_TRIM
+    case CTRL_TRIM:
+    {
+        /* 起止扇区号,含结尾那个. */
+        WL_DISKIO_LBA *range = (WL_DISKIO_LBA *)buff;
+        return WL_Disk_Trim(&WL_Diskio_Disk, (uint32_t)range[0], (uint32_t)(range[1] - range[0] + 1)) ? RES_OK : RES_PARERR;
+    }
+#endif
+    default:
+        return RES_PARERR;
+    }
+}
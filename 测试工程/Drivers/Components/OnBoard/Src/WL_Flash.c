@@ -9,107 +9,1575 @@
 
 #include "WL_Flash.h" /* 此文件是这个C的头文件. */
 #include "CRC.h" /* 此文件必须实现Calculate_CRC功能. */
-#include "N25Q128.h" /* 此文件要实现BSP_QSPI_Erase_Block,BSP_QSPI_Read,BSP_QSPI_Write函数. */
+#include <string.h>
 
+/*
+ * 默认每个wl_flash_t通过自己的ops访问Flash,多一次间接调用.
+ * 如果整个固件只有一种芯片,可以定义WL_FLASH_STATIC_OPS为驱动表的名字(例如N25Q128_WL_Ops),
+ * 这时候直接调用const表里的函数,开LTO可以内联掉,ops字段就不用了.
+ */
+#ifdef WL_FLASH_STATIC_OPS
+extern const wl_flash_ops_t WL_FLASH_STATIC_OPS;
+#define WL_OPS(W) (&WL_FLASH_STATIC_OPS)
+#else
+#define WL_OPS(W) ((W)->ops)
+#endif
 
-static uint32_t WL_Flash_calcAddr(wl_flash_t *WL_Flash, uint32_t addr);
+/* 定义WL_FLASH_TRACE时记录每次调用的开始和结束,见WL_Trace.h. */
+#ifdef WL_FLASH_TRACE
+#include "WL_Trace.h"
+#define WL_TRACE(op, addr, size) WL_Trace_Record((op), (addr), (size))
+#else
+#define WL_TRACE(op, addr, size)
+#endif
+
+/* 定义WL_FLASH_PROF时统计各阶段的耗时,见WL_Prof.h. */
+#ifdef WL_FLASH_PROF
+#include "WL_Prof.h"
+#else
+#define WL_PROF_BEGIN(t)
+#define WL_PROF_END(phase, t)
+#endif
+
+/* 运行统计,定义WL_FLASH_NO_STATS时去掉. */
+#ifdef WL_FLASH_NO_STATS
+#define WL_STAT(W, field, n)
+#else
+#define WL_STAT(W, field, n) ((W)->stats.field += (n))
+#endif
+
+/* WL_Flash_Program合并日志在当前坐标那wr_size个字节里的位置,第0个字节是坐标本身. */
+#define WL_RMW_COMMIT 1 /* 0x00: dummy里已经是拼好的新内容 */
+#define WL_RMW_DONE   2 /* 0x00: 已经复制回原来的Page */
+#define WL_RMW_PAGE   4 /* 4字节,原来的Page是第几个物理Page */
+#define WL_RMW_LOG    8 /* 日志要这么多字节,cfg.wr_size不能比它小 */
+
+/* 逻辑sector是不是已丢弃,trim_map不为NULL才能用. */
+#define WL_TRIM_TEST(W, sector) (((W)->trim_map[(sector) / 32] >> ((sector) % 32)) & 1)
+
+/* 旧版16位字段的state结构,只用来迁移旧格式的Flash. */
+typedef struct WL_State_v1_s
+{
+    uint16_t pos;
+    uint16_t max_pos;
+    uint16_t move_count;
+    uint16_t block_size;
+    uint8_t version;
+    uint32_t crc;
+} wl_state_v1_t;
+
+static uint32_t WL_Flash_calcAddr(wl_flash_t *WL_Flash, uint32_t addr, uint32_t *run);
 static void WL_Flash_Erase_RAW(wl_flash_t *WL_Flash, uint32_t start_address, uint32_t size);
+static uint32_t WL_Flash_Erase_Plan(wl_flash_t *WL_Flash, uint32_t address, uint32_t size);
 static void WL_Flash_recoverPos(wl_flash_t *WL_Flash);
 static void WL_Flash_initSections(wl_flash_t *WL_Flash);
 static void WL_Flash_Erase_Sector(wl_flash_t *WL_Flash, uint32_t sector);
 static void WL_Flash_updateWL(wl_flash_t *WL_Flash);
+static uint32_t WL_Flash_countPos(wl_flash_t *WL_Flash, uint32_t state_addr);
+static void WL_Flash_writePos(wl_flash_t *WL_Flash, uint32_t state_addr, uint32_t first, uint32_t count);
+static void WL_Flash_writeState(wl_flash_t *WL_Flash, uint32_t state_addr, uint32_t count);
+static uint8_t WL_Flash_migrateState(wl_flash_t *WL_Flash);
+static void WL_Flash_Wait(wl_flash_t *WL_Flash);
+static void WL_Flash_Erase_Block(wl_flash_t *WL_Flash, uint32_t address, uint32_t size);
+static void WL_Flash_Read_RAW(wl_flash_t *WL_Flash, uint32_t address, uint8_t *dest, uint32_t size);
+static void WL_Flash_Program_RAW(wl_flash_t *WL_Flash, uint32_t address, const uint8_t *src, uint32_t size);
+static void *WL_Flash_alloc(void *buf, uint32_t *alloc, uint32_t size);
+static void WL_Flash_wearCount(wl_flash_t *WL_Flash, uint32_t address, uint32_t size);
+static void WL_Flash_wearLoad(wl_flash_t *WL_Flash);
+static void WL_Flash_trimLoad(wl_flash_t *WL_Flash);
+static void WL_Flash_trimSave(wl_flash_t *WL_Flash);
+static void WL_Flash_trimMark(wl_flash_t *WL_Flash, uint32_t sector, uint8_t discard);
+static uint8_t WL_Flash_trimRun(wl_flash_t *WL_Flash, uint32_t address, uint32_t *len);
+static void WL_Flash_trimRevive(wl_flash_t *WL_Flash, uint32_t address, uint32_t size);
+static uint32_t WL_Flash_logicalAddr(wl_flash_t *WL_Flash, uint32_t index);
+static void WL_Flash_cacheInit(wl_flash_t *WL_Flash);
+static void WL_Flash_cacheInvalidate(wl_flash_t *WL_Flash, uint32_t address, uint32_t size);
+static void WL_Flash_cacheRead(wl_flash_t *WL_Flash, uint32_t address, uint8_t *dest, uint32_t size);
+static void WL_Flash_wbInit(wl_flash_t *WL_Flash);
+static uint8_t WL_Flash_wbWrite(wl_flash_t *WL_Flash, uint32_t address, const uint8_t *src, uint32_t size);
+static void WL_Flash_wbMerge(wl_flash_t *WL_Flash, uint32_t address, uint8_t *dest, uint32_t size);
+static void WL_Flash_raInit(wl_flash_t *WL_Flash);
+static void WL_Flash_raFinish(wl_flash_t *WL_Flash);
+static void WL_Flash_raKick(wl_flash_t *WL_Flash);
+static void WL_Flash_raInvalidate(wl_flash_t *WL_Flash, uint32_t address, uint32_t size);
+static uint8_t WL_Flash_raRead(wl_flash_t *WL_Flash, uint32_t address, uint8_t *dest, uint32_t size);
+static void WL_Flash_readDirect(wl_flash_t *WL_Flash, uint32_t address, uint8_t *dest, uint32_t size);
+static uint8_t WL_Flash_compare(const uint8_t *old, const uint8_t *src, uint32_t size, uint32_t *first, uint32_t *last);
+static uint8_t WL_Flash_checkRange(wl_flash_t *WL_Flash, uint32_t address, const uint8_t *src, uint32_t size, uint32_t *first, uint32_t *last);
+static uint8_t WL_Flash_rewriteSector(wl_flash_t *WL_Flash, uint32_t address, const uint8_t *src, uint32_t size);
+static uint8_t WL_Flash_isBlank(const uint8_t *data, uint32_t size);
+static void WL_Flash_rmwLog(wl_flash_t *WL_Flash, uint32_t offset, const uint8_t *data, uint32_t size);
+static void WL_Flash_rmwFinish(wl_flash_t *WL_Flash, uint32_t dummy, uint32_t phys);
+static void WL_Flash_rmwRecover(wl_flash_t *WL_Flash);
+static void WL_Flash_rmwPage(wl_flash_t *WL_Flash, uint32_t base, uint32_t lo, uint32_t hi, const uint8_t *src);
+
+/**
+  * @brief  从虚拟地址计算出物理地址.
+  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  * @param  addr: 虚拟地址.
+  * @param  run: 不为NULL时返回从addr开始物理上连续的长度,读写可以一次做完这么长.
+  * @note   映射是分段平移:先按move_count转一个偏移(在offset处分成两段),再跳过dummy(又分一次),最多三段.
+  *         addr所在的那一段缓存在xlat_xxx里,顺序读写一直落在同一段,只要比较一下;
+  *         pos/move_count变了state_gen就加一,缓存跟着作废.
+  */
+static uint32_t WL_Flash_calcAddr(wl_flash_t *WL_Flash, uint32_t addr, uint32_t *run)
+{
+    WL_PROF_BEGIN(t);
+    if ((WL_Flash->xlat_gen != WL_Flash->state_gen) || (addr < WL_Flash->xlat_lo) || (addr >= WL_Flash->xlat_hi))
+    {
+        /* move_count * page_size一定小于flash_size,不用取模,接近4GB也不会溢出. */
+        uint32_t offset = WL_Flash->state.move_count * WL_Flash->cfg.page_size;
+        uint32_t dummy_addr = WL_Flash->state.pos * WL_Flash->cfg.page_size;
+        uint32_t lo, hi, delta, split;
+
+        /* [offset, flash_size)往前挪到0开始,[0, offset)接在后面. */
+        if (addr >= offset)
+        {
+            lo = offset;
+            hi = WL_Flash->flash_size;
+            delta = 0 - offset;
+        }
+        else
+        {
+            lo = 0;
+            hi = offset;
+            delta = WL_Flash->flash_size - offset;
+        }
+        /* 换算结果到了dummy_addr的要往后跳一个page,split是这一段里从哪里开始跳. */
+        split = (dummy_addr > lo + delta) ? (dummy_addr - (lo + delta)) : 0;
+        if (split == 0)
+        {
+            delta += WL_Flash->cfg.page_size;
+        }
+        else if (split < hi - lo)
+        {
+            if (addr - lo >= split)
+            {
+                lo += split;
+                delta += WL_Flash->cfg.page_size;
+            }
+            else
+            {
+                hi = lo + split;
+            }
+        }
+        WL_Flash->xlat_lo = lo;
+        WL_Flash->xlat_hi = hi;
+        WL_Flash->xlat_delta = delta;
+        WL_Flash->xlat_gen = WL_Flash->state_gen;
+    }
+    if (run != NULL)
+    {
+        *run = WL_Flash->xlat_hi - addr;
+    }
+    WL_PROF_END(WL_PROF_TRANSLATE, t);
+    return addr + WL_Flash->xlat_delta;
+}
+
+/**
+  * @brief  擦SubSector + 更新WL.
+  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  * @param  sector: 需要擦的SubSector的地址.
+  */
+static void WL_Flash_Erase_Sector(wl_flash_t *WL_Flash, uint32_t sector)
+{
+    /* 先更新表,这时候pos就移动了,更新WL的时刻只有此时出现. */
+    WL_Flash_updateWL(WL_Flash);
+    /* 转换虚拟地址,VA -> PA变换. */
+    uint32_t virt_addr = WL_Flash_calcAddr(WL_Flash, sector * WL_Flash->cfg.sector_size, NULL);
+    /* 执行真实擦除. */
+    WL_Flash_Erase_Block(WL_Flash, WL_Flash->cfg.start_addr + virt_addr, WL_Flash->cfg.sector_size);
+}
+
+/**
+  * @brief  初始化这个Flash磨损平衡的底层函数.
+  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  */
+static void WL_Flash_initSections(wl_flash_t *WL_Flash)
+{
+    /* 第一次初始化,pos当然是0. */
+    WL_Flash->state.pos = 0;
+    /* 第一次初始化,pos当然是0. */
+    WL_Flash->state.move_count = 0;
+    /* pos/move_count变了,地址换算缓存作废. */
+    WL_Flash->state_gen++;
+    /* 更新后当前state的版本跟用户配置版本肯定是一样的啊. */
+    WL_Flash->state.version = WL_Flash->cfg.version;
+    /* 粒度大小 = SubSector大小,这样很方便. */
+    WL_Flash->state.block_size = WL_Flash->cfg.page_size;
+    /* max_pos是由可用SubSector扇区数量决定的,比如16MB的W25Q128就是4000个左右(要减去冗余和计算部分). */
+    WL_Flash->state.max_pos = 1 + WL_Flash->flash_size / WL_Flash->cfg.page_size;
+    /* 计算state的CRC,因为每此上电都判断这个来表示state的内容是否正确. */
+    WL_Flash->state.crc = Calculate_CRC((uint8_t *)&WL_Flash->state, sizeof(wl_state_t) - sizeof(uint32_t));
+    WL_STAT(WL_Flash, state_rewrites, 2);
+    /* 把两个state都存起来,以便掉电还能重新取出. */
+    WL_Flash_Erase_RAW(WL_Flash, WL_Flash->addr_state1, WL_Flash->state_size);
+    WL_Flash_Program_RAW(WL_Flash, WL_Flash->addr_state1, (uint8_t *)&WL_Flash->state, sizeof(wl_state_t));
+    /* 因为冗余了两份,所以要写两次. */
+    WL_Flash_Erase_RAW(WL_Flash, WL_Flash->addr_state2, WL_Flash->state_size);
+    WL_Flash_Program_RAW(WL_Flash, WL_Flash->addr_state2, (uint8_t *)&WL_Flash->state, sizeof(wl_state_t));
+    /* 地址配置也要写进去. */
+    WL_Flash_Erase_RAW(WL_Flash, WL_Flash->addr_cfg, WL_Flash->cfg_size);
+    WL_Flash_Program_RAW(WL_Flash, WL_Flash->addr_cfg, (uint8_t *)&WL_Flash->cfg, sizeof(wl_config_t));
+}
+
+/**
+  * @brief  数一份state里已经用了多少个坐标.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  state_addr: state的储存地址.
+  * @retval 第一个没用的坐标,全部用了就是max_pos.
+  * @note   坐标是从前往后按顺序用的,前面一段全是用了的,后面全是0xFF,所以二分查找,
+  *         16MB也只要读十几个字节,原来是一个字节一个字节往后找.
+  *         掉电时写了一半的坐标不是0xFF,也算用了,这时候数据已经复制完了.
+  */
+static uint32_t WL_Flash_countPos(wl_flash_t *WL_Flash, uint32_t state_addr)
+{
+    uint32_t low = 0;
+    uint32_t high = WL_Flash->state.max_pos;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        uint8_t pos_bits = 0;
+        /* 每个坐标只看第一个字节. */
+        WL_Flash_Read_RAW(WL_Flash, state_addr + sizeof(wl_state_t) + mid * WL_Flash->cfg.wr_size, &pos_bits, 1);
+        if (pos_bits == 0xff)
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+/**
+  * @brief  恢复正在使用的坐标.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化,两份state的头部已经一致).
+  * @note   坐标先写state1再写state2,中间掉电两份会差一个,以多的为准,把少的那份补上,
+  *         不然以后只剩一份能用的时候坐标就错了.
+  */
+static void WL_Flash_recoverPos(wl_flash_t *WL_Flash)
+{
+    uint32_t count1 = WL_Flash_countPos(WL_Flash, WL_Flash->addr_state1);
+    uint32_t count2 = WL_Flash_countPos(WL_Flash, WL_Flash->addr_state2);
+
+    if (count1 < count2)
+    {
+        WL_Flash_writePos(WL_Flash, WL_Flash->addr_state1, count1, count2);
+        count1 = count2;
+    }
+    else if (count2 < count1)
+    {
+        WL_Flash_writePos(WL_Flash, WL_Flash->addr_state2, count2, count1);
+    }
+    WL_Flash->state.pos = count1;
+    /* 坐标全用了,说明转圈的时候还没来得及重写state就掉电了.退回最后一个坐标,数据已经复制好了,下次更新磨损平衡表会重新转圈. */
+    if (WL_Flash->state.pos == WL_Flash->state.max_pos)
+    {
+        WL_Flash->state.pos--;
+    }
+    WL_Flash->state_gen++;
+}
+
+/**
+  * @brief  擦除规划,选出这个地址能用的最大擦除大小.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  address: 当前物理地址.
+  * @param  size: 剩下需要擦除的长度.
+  * @retval 这次要擦除的大小.
+  */
+static uint32_t WL_Flash_Erase_Plan(wl_flash_t *WL_Flash, uint32_t address, uint32_t size)
+{
+    /* 从大到小找,地址对齐而且剩下长度够的就用,64K擦除比16次4K擦除快得多. */
+    for (uint32_t i = WL_FLASH_ERASE_TYPES; i > 0; i--)
+    {
+        uint32_t erase_size = WL_Flash->erase_size[i - 1];
+        if ((erase_size > WL_Flash->cfg.sector_size) && ((address % erase_size) == 0) && (size >= erase_size))
+        {
+            return erase_size;
+        }
+    }
+    /* 都不行就按sector_size擦. */
+    return WL_Flash->cfg.sector_size;
+}
+
+/**
+  * @brief  写入坐标位,第first到第count - 1个坐标标记为已用(0x00).
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  state_addr: state的储存地址.
+  * @param  first: 从这个坐标开始写.
+  * @param  count: 已用的坐标数量.
+  * @note   用temp_buff一次写一段,坐标之间的0xFF写进去不改变Flash内容.
+  */
+static void WL_Flash_writePos(wl_flash_t *WL_Flash, uint32_t state_addr, uint32_t first, uint32_t count)
+{
+    uint32_t total = count * WL_Flash->cfg.wr_size;
+    WL_PROF_BEGIN(t);
+    for (uint32_t offset = first * WL_Flash->cfg.wr_size; offset < total; offset += WL_Flash->cfg.temp_buff_size)
+    {
+        uint32_t len = ((total - offset) < WL_Flash->cfg.temp_buff_size) ? (total - offset) : WL_Flash->cfg.temp_buff_size;
+        for (uint32_t j = 0; j < len; j++)
+        {
+            /* 每个坐标只用第一个字节. */
+            WL_Flash->temp_buff[j] = (((offset + j) % WL_Flash->cfg.wr_size) == 0) ? 0x00 : 0xFF;
+        }
+        WL_Flash_Program_RAW(WL_Flash, state_addr + sizeof(wl_state_t) + offset, WL_Flash->temp_buff, len);
+    }
+    WL_PROF_END(WL_PROF_MARKER, t);
+}
+
+/**
+  * @brief  重写一份state,包括坐标位.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  state_addr: state的储存地址.
+  * @param  count: 已用的坐标数量.
+  */
+static void WL_Flash_writeState(wl_flash_t *WL_Flash, uint32_t state_addr, uint32_t count)
+{
+    WL_STAT(WL_Flash, state_rewrites, 1);
+    WL_Flash_Erase_RAW(WL_Flash, state_addr, WL_Flash->state_size);
+    WL_Flash_Program_RAW(WL_Flash, state_addr, (uint8_t *)&WL_Flash->state, sizeof(wl_state_t));
+    WL_Flash_writePos(WL_Flash, state_addr, 0, count);
+}
+
+/**
+  * @brief  把旧版16位字段的state迁移成现在的32位格式.
+  * @param  WL_FLash: 磨损平衡结构体(地址已经计算好).
+  * @retval 1: 迁移成功, 0: 没有能迁移的旧state, 2: 有旧state,但是新旧state占的sector数不一样,没法原地迁移,Flash没有动.
+  */
+static uint8_t WL_Flash_migrateState(wl_flash_t *WL_Flash)
+{
+    wl_state_v1_t old_state;
+    uint32_t old_addr;
+    uint32_t new_addr;
+    uint32_t pos = 0;
+
+    /* 旧格式state占的大小跟现在不一样的话,数据区布局就全变了,没法原地迁移.
+       按旧布局(那时候没有擦除次数区和丢弃位图区)看看旧state在不在,在的话不能当成新Flash初始化,数据会丢. */
+    uint32_t old_size = ((sizeof(wl_state_v1_t) + (WL_Flash->cfg.full_mem_size / WL_Flash->cfg.sector_size) * WL_Flash->cfg.wr_size) + WL_Flash->cfg.sector_size - 1) / WL_Flash->cfg.sector_size;
+    old_size = old_size * WL_Flash->cfg.sector_size;
+    if (old_size != WL_Flash->state_size)
+    {
+        for (uint32_t i = 1; i <= 2; i++)
+        {
+            old_addr = WL_Flash->addr_cfg - old_size * (3 - i);
+            WL_Flash_Read_RAW(WL_Flash, old_addr, (uint8_t *)&old_state, sizeof(wl_state_v1_t));
+            if ((Calculate_CRC((uint8_t *)&old_state, sizeof(wl_state_v1_t) - sizeof(uint32_t)) == old_state.crc) &&
+                    (old_state.version == WL_Flash->cfg.version) && (old_state.block_size == WL_Flash->cfg.page_size))
+            {
+                return 2;
+            }
+        }
+        return 0;
+    }
+
+    /* 两份旧state,哪份对就用哪份. */
+    old_addr = WL_Flash->addr_state1;
+    WL_Flash_Read_RAW(WL_Flash, old_addr, (uint8_t *)&old_state, sizeof(wl_state_v1_t));
+    if (Calculate_CRC((uint8_t *)&old_state, sizeof(wl_state_v1_t) - sizeof(uint32_t)) != old_state.crc)
+    {
+        old_addr = WL_Flash->addr_state2;
+        WL_Flash_Read_RAW(WL_Flash, old_addr, (uint8_t *)&old_state, sizeof(wl_state_v1_t));
+        if (Calculate_CRC((uint8_t *)&old_state, sizeof(wl_state_v1_t) - sizeof(uint32_t)) != old_state.crc)
+        {
+            return 0;
+        }
+    }
+
+    /* 配置变了的话数据本来就要重新初始化,不用迁移. */
+    if ((old_state.version != WL_Flash->cfg.version) || (old_state.block_size != WL_Flash->cfg.page_size) ||
+            (old_state.max_pos != 1 + WL_Flash->flash_size / WL_Flash->cfg.page_size))
+    {
+        return 0;
+    }
+
+    /* 按旧的偏移找出正在使用的坐标. */
+    for (pos = 0; pos < old_state.max_pos; pos++)
+    {
+        uint8_t pos_bits = 0;
+        WL_Flash_Read_RAW(WL_Flash, old_addr + sizeof(wl_state_v1_t) + pos * WL_Flash->cfg.wr_size, &pos_bits, 1);
+        if (pos_bits == 0xff)
+        {
+            break;
+        }
+    }
+
+    WL_Flash->state.pos = old_state.pos;
+    WL_Flash->state.max_pos = old_state.max_pos;
+    WL_Flash->state.move_count = old_state.move_count;
+    WL_Flash->state_gen++;
+    WL_Flash->state.block_size = old_state.block_size;
+    WL_Flash->state.version = old_state.version;
+    WL_Flash->state.crc = Calculate_CRC((uint8_t *)&WL_Flash->state, sizeof(wl_state_t) - sizeof(uint32_t));
+
+    /* 先写另外一份,最后才覆盖旧的那份,中途掉电下次上电还能再迁移或者按一份坏了修复.
+       每份都是先写坐标最后写头部:另一份还是旧格式,头部写早了掉电,新格式只剩一份坐标不全的,pos就恢复错了. */
+    new_addr = (old_addr == WL_Flash->addr_state1) ? WL_Flash->addr_state2 : WL_Flash->addr_state1;
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        uint32_t state_addr = (i == 0) ? new_addr : old_addr;
+        WL_STAT(WL_Flash, state_rewrites, 1);
+        WL_Flash_Erase_RAW(WL_Flash, state_addr, WL_Flash->state_size);
+        WL_Flash_writePos(WL_Flash, state_addr, 0, pos);
+        WL_Flash_Program_RAW(WL_Flash, state_addr, (uint8_t *)&WL_Flash->state, sizeof(wl_state_t));
+    }
+
+    return 1;
+}
+
+/**
+  * @brief  等待驱动擦除完成.同步驱动直接返回.
+  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  * @note   异步驱动擦除的时候让出CPU,不在这里死等.
+  */
+static void WL_Flash_Wait(wl_flash_t *WL_Flash)
+{
+    if ((WL_OPS(WL_Flash)->caps & WL_FLASH_CAP_ASYNC) == 0)
+    {
+        return;
+    }
+    WL_PROF_BEGIN(t);
+    while (WL_OPS(WL_Flash)->get_status(WL_Flash->drv) == WL_FLASH_DRV_BUSY)
+    {
+        vTaskDelay(1);
+    }
+    WL_PROF_END(WL_PROF_POLL, t);
+}
+
+/**
+  * @brief  擦一块并记下擦除次数,所有物理擦除都走这里.
+  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  * @param  address: 物理地址.
+  * @param  size: 擦除大小,必须是芯片支持的擦除大小.
+  */
+static void WL_Flash_Erase_Block(wl_flash_t *WL_Flash, uint32_t address, uint32_t size)
+{
+    WL_Flash_raFinish(WL_Flash);
+    WL_PROF_BEGIN(t);
+    WL_OPS(WL_Flash)->erase(WL_Flash->drv, address, size);
+    WL_Flash_Wait(WL_Flash);
+    WL_PROF_END(WL_PROF_ERASE, t);
+    WL_Flash_wearCount(WL_Flash, address, size);
+    WL_STAT(WL_Flash, flash_erase, size);
+    WL_STAT(WL_Flash, flash_erase_ops, 1);
+}
+
+/**
+  * @brief  直接物理读取,所有驱动读都走这里,顺便统计.预读的DMA没完的话先等它读完.
+  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  * @param  address: 物理地址.
+  * @param  dest: 读出的数据.
+  * @param  size: 长度.
+  */
+static void WL_Flash_Read_RAW(wl_flash_t *WL_Flash, uint32_t address, uint8_t *dest, uint32_t size)
+{
+    WL_Flash_raFinish(WL_Flash);
+    WL_PROF_BEGIN(t);
+    WL_OPS(WL_Flash)->read(WL_Flash->drv, address, dest, size);
+    WL_PROF_END(WL_PROF_READ, t);
+    WL_STAT(WL_Flash, flash_read, size);
+}
+
+/**
+  * @brief  直接物理写入,所有驱动写都走这里,顺便统计.
+  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  * @param  address: 物理地址.
+  * @param  src: 数据.
+  * @param  size: 长度.
+  */
+static void WL_Flash_Program_RAW(wl_flash_t *WL_Flash, uint32_t address, const uint8_t *src, uint32_t size)
+{
+    WL_Flash_raFinish(WL_Flash);
+    WL_PROF_BEGIN(t);
+    WL_OPS(WL_Flash)->program(WL_Flash->drv, address, src, size);
+    WL_PROF_END(WL_PROF_PROGRAM, t);
+    WL_STAT(WL_Flash, flash_program, size);
+    WL_STAT(WL_Flash, flash_program_ops, 1);
+}
+
+/**
+  * @brief  记擦除次数,只在RAM里加,攒够WL_FLASH_WEAR_FLUSH次再写回Flash.
+  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  * @param  address: 物理地址.
+  * @param  size: 擦除大小,64K擦除就是16个Page各加一次.
+  */
+static void WL_Flash_wearCount(wl_flash_t *WL_Flash, uint32_t address, uint32_t size)
+{
+    if (WL_Flash->wear_count == NULL)
+    {
+        return;
+    }
+    for (uint32_t offset = 0; offset < size; offset += WL_Flash->cfg.page_size)
+    {
+        uint32_t block = (address + offset - WL_Flash->cfg.start_addr) / WL_Flash->cfg.page_size;
+        if (block < WL_Flash->wear_blocks)
+        {
+            WL_Flash->wear_count[block]++;
+        }
+    }
+    WL_Flash->wear_dirty++;
+}
+
+/**
+  * @brief  准备Config要用的一块缓冲,第一次挂载时申请,以后挂载够大就接着用,不够大重新申请,不要了就释放.
+  * @param  buf: 原来的缓冲,没有申请过是NULL.
+  * @param  alloc: 原来申请的大小,返回现在的大小(没有缓冲就是0).
+  * @param  size: 这次要的大小,0表示不要了.
+  * @retval 缓冲,size为0或者内存不够返回NULL.
+  */
+static void *WL_Flash_alloc(void *buf, uint32_t *alloc, uint32_t size)
+{
+    if ((buf != NULL) && (size != 0) && (*alloc >= size))
+    {
+        return buf;
+    }
+    if (buf != NULL)
+    {
+        vPortFree(buf);
+    }
+    *alloc = 0;
+    if (size == 0)
+    {
+        return NULL;
+    }
+    /* 申请内存,如果不使用FreeRTOS,那么要移植这个函数. */
+    buf = pvPortMalloc(size);
+    if (buf != NULL)
+    {
+        *alloc = size;
+    }
+    return buf;
+}
+
+/**
+  * @brief  读回擦除次数.擦除次数区分成几份轮流写,找序号最大而且CRC对的那份.
+  * @param  WL_FLash: 磨损平衡结构体(地址已经计算好).
+  * @note   区域放不下两份记录就不统计,wear_count保持NULL.都找不到(全新的Flash)就从0开始.
+  */
+static void WL_Flash_wearLoad(wl_flash_t *WL_Flash)
+{
+    wl_wear_hdr_t hdr;
+    wl_wear_hdr_t best;
+    uint32_t slots = 0;
+    uint32_t limit = 0xFFFFFFFF;
+
+    WL_Flash->wear_blocks = WL_Flash->cfg.full_mem_size / WL_Flash->cfg.page_size;
+    WL_Flash->wear_snap_size = (sizeof(wl_wear_hdr_t) + WL_Flash->wear_blocks * sizeof(uint32_t) + WL_Flash->cfg.sector_size - 1) / WL_Flash->cfg.sector_size * WL_Flash->cfg.sector_size;
+    if (WL_Flash->wear_size < WL_Flash->wear_snap_size * 2)
+    {
+        /* 出错原因,wear_sectors太少,一份记录要wear_snap_size,至少要两份轮流写. */
+        WL_Flash->wear_count = (uint32_t *)WL_Flash_alloc(WL_Flash->wear_count, &WL_Flash->wear_alloc, 0);
+        return;
+    }
+    WL_Flash->wear_count = (uint32_t *)WL_Flash_alloc(WL_Flash->wear_count, &WL_Flash->wear_alloc, WL_Flash->wear_blocks * sizeof(uint32_t));
+    if (WL_Flash->wear_count == NULL)
+    {
+        return;
+    }
+    slots = WL_Flash->wear_size / WL_Flash->wear_snap_size;
+    WL_Flash->wear_dirty = 0;
+
+    for (;;)
+    {
+        uint32_t slot = slots;
+        /* 只读头部,找比limit小的最大序号. */
+        for (uint32_t i = 0; i < slots; i++)
+        {
+            WL_Flash_Read_RAW(WL_Flash, WL_Flash->addr_wear + i * WL_Flash->wear_snap_size, (uint8_t *)&hdr, sizeof(wl_wear_hdr_t));
+            if ((hdr.magic == WL_FLASH_WEAR_MAGIC) && (hdr.blocks == WL_Flash->wear_blocks) && (hdr.seq < limit) &&
+                    ((slot == slots) || (hdr.seq > best.seq)))
+            {
+                slot = i;
+                best = hdr;
+            }
+        }
+        if (slot == slots)
+        {
+            /* 一份能用的都没有,从0开始,下次写第0份. */
+            memset(WL_Flash->wear_count, 0, WL_Flash->wear_blocks * sizeof(uint32_t));
+            WL_Flash->wear_seq = 0;
+            WL_Flash->wear_slot = slots - 1;
+            return;
+        }
+        WL_Flash_Read_RAW(WL_Flash, WL_Flash->addr_wear + slot * WL_Flash->wear_snap_size + sizeof(wl_wear_hdr_t), (uint8_t *)WL_Flash->wear_count, WL_Flash->wear_blocks * sizeof(uint32_t));
+        if ((Calculate_CRC((uint8_t *)&best, sizeof(wl_wear_hdr_t) - sizeof(uint32_t)) ^
+                Calculate_CRC((uint8_t *)WL_Flash->wear_count, WL_Flash->wear_blocks * sizeof(uint32_t))) == best.crc)
+        {
+            WL_Flash->wear_seq = best.seq;
+            WL_Flash->wear_slot = slot;
+            return;
+        }
+        /* 这份写到一半掉电了,找上一份. */
+        limit = best.seq;
+    }
+}
+
+/**
+  * @brief  读回丢弃位图.找序号最大而且头部CRC对的那份,一个字节一个字节数0的位数.
+  * @param  WL_FLash: 磨损平衡结构体(地址和flash_size已经计算好).
+  * @note   区域放不下两份记录就不支持,trim_map保持NULL.都找不到(全新的Flash)就是全部没丢弃,第一次改的时候再写一份.
+  */
+static void WL_Flash_trimLoad(wl_flash_t *WL_Flash)
+{
+    wl_trim_hdr_t hdr;
+    uint32_t slots = 0;
+    uint32_t addr = 0;
+
+    WL_Flash->trim_count = 0;
+    WL_Flash->trim_seq = 0;
+    WL_Flash->trim_blocks = WL_Flash->flash_size / WL_Flash->cfg.sector_size;
+    WL_Flash->trim_snap_size = (sizeof(wl_trim_hdr_t) + WL_Flash->trim_blocks + WL_Flash->cfg.sector_size - 1) / WL_Flash->cfg.sector_size * WL_Flash->cfg.sector_size;
+    if (WL_Flash->trim_size < WL_Flash->trim_snap_size * 2)
+    {
+        /* 出错原因,trim_sectors太少,一份记录要trim_snap_size,至少要两份轮流写. */
+        WL_Flash->trim_map = (uint32_t *)WL_Flash_alloc(WL_Flash->trim_map, &WL_Flash->trim_alloc, 0);
+        return;
+    }
+    WL_Flash->trim_map = (uint32_t *)WL_Flash_alloc(WL_Flash->trim_map, &WL_Flash->trim_alloc, (WL_Flash->trim_blocks + 31) / 32 * sizeof(uint32_t));
+    if (WL_Flash->trim_map == NULL)
+    {
+        return;
+    }
+    memset(WL_Flash->trim_map, 0, (WL_Flash->trim_blocks + 31) / 32 * sizeof(uint32_t));
+    slots = WL_Flash->trim_size / WL_Flash->trim_snap_size;
+    WL_Flash->trim_slot = slots - 1;
+
+    /* 头部最后写,CRC对的那份内容一定是完整的. */
+    for (uint32_t i = 0; i < slots; i++)
+    {
+        WL_Flash_Read_RAW(WL_Flash, WL_Flash->addr_trim + i * WL_Flash->trim_snap_size, (uint8_t *)&hdr, sizeof(wl_trim_hdr_t));
+        if ((hdr.magic == WL_FLASH_TRIM_MAGIC) && (hdr.sectors == WL_Flash->trim_blocks) && (hdr.seq > WL_Flash->trim_seq) &&
+                (Calculate_CRC((uint8_t *)&hdr, sizeof(wl_trim_hdr_t) - sizeof(uint32_t)) == hdr.crc))
+        {
+            WL_Flash->trim_seq = hdr.seq;
+            WL_Flash->trim_slot = i;
+        }
+    }
+    if (WL_Flash->trim_seq == 0)
+    {
+        return;
+    }
+
+    addr = WL_Flash->addr_trim + WL_Flash->trim_slot * WL_Flash->trim_snap_size + sizeof(wl_trim_hdr_t);
+    for (uint32_t offset = 0; offset < WL_Flash->trim_blocks; offset += WL_Flash->cfg.temp_buff_size)
+    {
+        uint32_t len = ((WL_Flash->trim_blocks - offset) < WL_Flash->cfg.temp_buff_size) ? (WL_Flash->trim_blocks - offset) : WL_Flash->cfg.temp_buff_size;
+        WL_Flash_Read_RAW(WL_Flash, addr + offset, WL_Flash->temp_buff, len);
+        for (uint32_t j = 0; j < len; j++)
+        {
+            uint8_t zeros = 0;
+            for (uint8_t bits = (uint8_t)~WL_Flash->temp_buff[j]; bits != 0; bits &= (uint8_t)(bits - 1))
+            {
+                zeros++;
+            }
+            if (zeros & 1)
+            {
+                WL_Flash->trim_map[(offset + j) / 32] |= (uint32_t)1 << ((offset + j) % 32);
+                WL_Flash->trim_count++;
+            }
+        }
+    }
+}
+
+/**
+  * @brief  按RAM里的位图整份重写到下一份,已丢弃写0xFE,没丢弃是0xFF不用写.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @note   写到一半掉电的话头部没写,下次挂载还是用上一份.
+  */
+static void WL_Flash_trimSave(wl_flash_t *WL_Flash)
+{
+    wl_trim_hdr_t hdr;
+    uint32_t slot = (WL_Flash->trim_slot + 1) % (WL_Flash->trim_size / WL_Flash->trim_snap_size);
+    uint32_t addr = WL_Flash->addr_trim + slot * WL_Flash->trim_snap_size;
+
+    WL_Flash_Erase_RAW(WL_Flash, addr, WL_Flash->trim_snap_size);
+    for (uint32_t offset = 0; offset < WL_Flash->trim_blocks; offset += WL_Flash->cfg.temp_buff_size)
+    {
+        uint32_t len = ((WL_Flash->trim_blocks - offset) < WL_Flash->cfg.temp_buff_size) ? (WL_Flash->trim_blocks - offset) : WL_Flash->cfg.temp_buff_size;
+        uint8_t dirty = 0;
+        for (uint32_t j = 0; j < len; j++)
+        {
+            WL_Flash->temp_buff[j] = WL_TRIM_TEST(WL_Flash, offset + j) ? 0xFE : 0xFF;
+            dirty |= (uint8_t)~WL_Flash->temp_buff[j];
+        }
+        if (dirty)
+        {
+            WL_Flash_Program_RAW(WL_Flash, addr + sizeof(wl_trim_hdr_t) + offset, WL_Flash->temp_buff, len);
+        }
+    }
+    hdr.magic = WL_FLASH_TRIM_MAGIC;
+    hdr.seq = WL_Flash->trim_seq + 1;
+    hdr.sectors = WL_Flash->trim_blocks;
+    hdr.crc = Calculate_CRC((uint8_t *)&hdr, sizeof(wl_trim_hdr_t) - sizeof(uint32_t));
+    WL_Flash_Program_RAW(WL_Flash, addr, (uint8_t *)&hdr, sizeof(wl_trim_hdr_t));
+    WL_Flash->trim_seq = hdr.seq;
+    WL_Flash->trim_slot = slot;
+}
+
+/**
+  * @brief  改一个逻辑sector的丢弃状态,RAM和Flash一起改.
+  * @param  WL_FLash: 磨损平衡结构体(trim_map不为NULL).
+  * @param  sector: 逻辑sector号.
+  * @param  discard: 1: 标记为已丢弃, 0: 又能用了(已经擦过).
+  * @note   Flash上只是把这个sector的字节再清一位,8位都清完了(或者还没有记录)才整份重写.
+  */
+static void WL_Flash_trimMark(wl_flash_t *WL_Flash, uint32_t sector, uint8_t discard)
+{
+    uint32_t addr = WL_Flash->addr_trim + WL_Flash->trim_slot * WL_Flash->trim_snap_size + sizeof(wl_trim_hdr_t) + sector;
+    uint8_t bits = 0;
+
+    if (WL_TRIM_TEST(WL_Flash, sector) == discard)
+    {
+        return;
+    }
+    WL_Flash->trim_map[sector / 32] ^= (uint32_t)1 << (sector % 32);
+    WL_Flash->trim_count = discard ? (WL_Flash->trim_count + 1) : (WL_Flash->trim_count - 1);
+    if (WL_Flash->trim_seq != 0)
+    {
+        WL_Flash_Read_RAW(WL_Flash, addr, &bits, 1);
+    }
+    if (bits == 0)
+    {
+        WL_Flash_trimSave(WL_Flash);
+        return;
+    }
+    /* 清掉最低的一个1,0的位数就变了单双. */
+    bits &= (uint8_t)(bits - 1);
+    WL_Flash_Program_RAW(WL_Flash, addr, &bits, 1);
+}
+
+/**
+  * @brief  从address开始,丢弃状态和address所在sector一样的一段有多长.
+  * @param  WL_FLash: 磨损平衡结构体(trim_map不为NULL).
+  * @param  address: 逻辑地址.
+  * @param  len: 传入最多看多长,返回这一段的长度.
+  * @retval 1: 这一段已丢弃, 0: 没丢弃.
+  */
+static uint8_t WL_Flash_trimRun(wl_flash_t *WL_Flash, uint32_t address, uint32_t *len)
+{
+    uint32_t sector = address / WL_Flash->cfg.sector_size;
+    uint8_t trimmed = WL_TRIM_TEST(WL_Flash, sector);
+    uint32_t end = (sector + 1) * WL_Flash->cfg.sector_size;
+
+    while ((end - address < *len) && (++sector < WL_Flash->trim_blocks) && (WL_TRIM_TEST(WL_Flash, sector) == trimmed))
+    {
+        end += WL_Flash->cfg.sector_size;
+    }
+    *len = (end - address < *len) ? (end - address) : *len;
+    return trimmed;
+}
+
+/**
+  * @brief  要写的范围里有已丢弃的sector就先擦掉,再从位图里去掉.
+  * @param  WL_FLash: 磨损平衡结构体(trim_map不为NULL).
+  * @param  address: 逻辑地址.
+  * @param  size: 长度.
+  * @note   已丢弃的sector读出来一直是0xFF,用户当它是擦过的,但Flash里可能还是旧数据,不擦直接写就错了.
+  *         挪dummy时没复制过去的,还有从来没写过的(格式化文件系统时整个卷都丢弃),Flash里本来就是空的,
+  *         读一遍确认是空的就不擦,省一次擦除和一次挪dummy.
+  */
+static void WL_Flash_trimRevive(wl_flash_t *WL_Flash, uint32_t address, uint32_t size)
+{
+    uint32_t last = (address + size - 1) / WL_Flash->cfg.sector_size;
+    uint32_t chunk[WL_FLASH_CMP_CHUNK / 4];
+
+    for (uint32_t sector = address / WL_Flash->cfg.sector_size; (sector <= last) && (sector < WL_Flash->trim_blocks); sector++)
+    {
+        if (WL_TRIM_TEST(WL_Flash, sector))
+        {
+            uint32_t phys = WL_Flash->cfg.start_addr + WL_Flash_calcAddr(WL_Flash, sector * WL_Flash->cfg.sector_size, NULL);
+            uint8_t blank = 1;
+
+            for (uint32_t off = 0; blank && (off < WL_Flash->cfg.sector_size); off += WL_FLASH_CMP_CHUNK)
+            {
+                WL_Flash_Read_RAW(WL_Flash, phys + off, (uint8_t *)chunk, WL_FLASH_CMP_CHUNK);
+                blank = WL_Flash_isBlank((uint8_t *)chunk, WL_FLASH_CMP_CHUNK);
+            }
+            WL_Flash_cacheInvalidate(WL_Flash, sector * WL_Flash->cfg.sector_size, WL_Flash->cfg.sector_size);
+            WL_Flash_raInvalidate(WL_Flash, sector * WL_Flash->cfg.sector_size, WL_Flash->cfg.sector_size);
+            if (!blank)
+            {
+                WL_Flash_Erase_Sector(WL_Flash, sector);
+            }
+            WL_Flash_trimMark(WL_Flash, sector, 0);
+        }
+    }
+}
+
+/**
+  * @brief  从物理Page号反算逻辑地址,calcAddr反过来.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  index: 物理Page号,不能是dummy(state.pos).
+  * @retval 逻辑地址.
+  */
+static uint32_t WL_Flash_logicalAddr(wl_flash_t *WL_Flash, uint32_t index)
+{
+    uint32_t addr = index * WL_Flash->cfg.page_size;
+    uint32_t offset = WL_Flash->state.move_count * WL_Flash->cfg.page_size;
+
+    /* 先去掉dummy那一格,再转回move_count的偏移. */
+    if (index > WL_Flash->state.pos)
+    {
+        addr -= WL_Flash->cfg.page_size;
+    }
+    return (addr >= WL_Flash->flash_size - offset) ? (addr - (WL_Flash->flash_size - offset)) : (addr + offset);
+}
+
+/**
+  * @brief  准备读缓存,第一次挂载时申请内存,每次挂载都清空,参数变大了重新申请.
+  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  * @note   参数不对或者内存不够就不用缓存,cache_tag是NULL(以前申请的也释放掉).
+  */
+static void WL_Flash_cacheInit(wl_flash_t *WL_Flash)
+{
+    uint32_t lines = WL_Flash->cache_sets * WL_Flash->cache_ways;
+    uint32_t stamp_alloc = WL_Flash->cache_tag_alloc;
+
+    if ((WL_Flash->cache_line_size == 0) || (lines == 0) || ((WL_Flash->cfg.page_size % WL_Flash->cache_line_size) != 0))
+    {
+        /* 出错原因,没有配置缓存,或者一行跨了Page(跨Page的两半物理上不连续). */
+        lines = 0;
+    }
+    WL_Flash->cache_data = (uint8_t *)WL_Flash_alloc(WL_Flash->cache_data, &WL_Flash->cache_data_alloc, lines * WL_Flash->cache_line_size);
+    WL_Flash->cache_stamp = (uint32_t *)WL_Flash_alloc(WL_Flash->cache_stamp, &stamp_alloc, lines * sizeof(uint32_t));
+    WL_Flash->cache_tag = (uint32_t *)WL_Flash_alloc(WL_Flash->cache_tag, &WL_Flash->cache_tag_alloc, lines * sizeof(uint32_t));
+    if ((WL_Flash->cache_data == NULL) || (WL_Flash->cache_tag == NULL) || (WL_Flash->cache_stamp == NULL))
+    {
+        /* 一个都不留,cache_tag为NULL就是没有缓存. */
+        WL_Flash->cache_data = (uint8_t *)WL_Flash_alloc(WL_Flash->cache_data, &WL_Flash->cache_data_alloc, 0);
+        WL_Flash->cache_stamp = (uint32_t *)WL_Flash_alloc(WL_Flash->cache_stamp, &stamp_alloc, 0);
+        WL_Flash->cache_tag = (uint32_t *)WL_Flash_alloc(WL_Flash->cache_tag, &WL_Flash->cache_tag_alloc, 0);
+        return;
+    }
+    memset(WL_Flash->cache_tag, 0, lines * sizeof(uint32_t));
+    memset(WL_Flash->cache_stamp, 0, lines * sizeof(uint32_t));
+    WL_Flash->cache_clock = 0;
+}
+
+/**
+  * @brief  作废和一段逻辑地址重叠的缓存行,写入和擦除之后调用.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  address: 逻辑地址.
+  * @param  size: 长度.
+  * @note   缓存按逻辑地址存,挪dummy只是换了物理位置,内容不变,不用作废.
+  *         行数不多,直接扫一遍所有行,比按地址一行一行查简单.
+  */
+static void WL_Flash_cacheInvalidate(wl_flash_t *WL_Flash, uint32_t address, uint32_t size)
+{
+    uint32_t lines = WL_Flash->cache_sets * WL_Flash->cache_ways;
+    uint32_t first, last;
+
+    if ((WL_Flash->cache_tag == NULL) || (size == 0))
+    {
+        return;
+    }
+    first = address / WL_Flash->cache_line_size + 1;
+    last = (address + size - 1) / WL_Flash->cache_line_size + 1;
+    for (uint32_t i = 0; i < lines; i++)
+    {
+        if ((WL_Flash->cache_tag[i] >= first) && (WL_Flash->cache_tag[i] <= last))
+        {
+            WL_Flash->cache_tag[i] = 0;
+        }
+    }
+}
+
+/**
+  * @brief  经过读缓存读取,没命中的行整行从Flash读进来.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  address: 逻辑地址.
+  * @param  dest: 读出的数据.
+  * @param  size: 长度.
+  */
+static void WL_Flash_cacheRead(wl_flash_t *WL_Flash, uint32_t address, uint8_t *dest, uint32_t size)
+{
+    uint32_t line_size = WL_Flash->cache_line_size;
+
+    while (size > 0)
+    {
+        WL_PROF_BEGIN(t);
+        uint32_t line = address / line_size;
+        uint32_t offset = address % line_size;
+        uint32_t len = ((line_size - offset) < size) ? (line_size - offset) : size;
+        uint32_t *tag = &WL_Flash->cache_tag[(line % WL_Flash->cache_sets) * WL_Flash->cache_ways];
+        uint32_t *stamp = &WL_Flash->cache_stamp[(line % WL_Flash->cache_sets) * WL_Flash->cache_ways];
+        uint32_t way = 0, victim = 0;
+
+        /* 组内找这一行,顺便找最久没用的一行(空行的stamp是0,一定先被选中). */
+        for (way = 0; way < WL_Flash->cache_ways; way++)
+        {
+            if (tag[way] == line + 1)
+            {
+                break;
+            }
+            if (stamp[way] < stamp[victim])
+            {
+                victim = way;
+            }
+        }
+        if (way < WL_Flash->cache_ways)
+        {
+            uint8_t *data = WL_Flash->cache_data + (uint32_t)(tag + way - WL_Flash->cache_tag) * line_size;
+            memcpy(dest, data + offset, len);
+            WL_STAT(WL_Flash, cache_hits, 1);
+            WL_PROF_END(WL_PROF_CACHE_HIT, t);
+        }
+        else
+        {
+            uint8_t *data = WL_Flash->cache_data + (uint32_t)(tag + victim - WL_Flash->cache_tag) * line_size;
+            /* 一行不会跨Page,整行换算一次物理地址就行. */
+            WL_Flash_Read_RAW(WL_Flash, WL_Flash->cfg.start_addr + WL_Flash_calcAddr(WL_Flash, line * line_size, NULL), data, line_size);
+            tag[victim] = line + 1;
+            way = victim;
+            memcpy(dest, data + offset, len);
+            WL_STAT(WL_Flash, cache_misses, 1);
+            WL_PROF_END(WL_PROF_CACHE_MISS, t);
+        }
+        stamp[way] = ++WL_Flash->cache_clock;
+        address += len;
+        dest += len;
+        size -= len;
+    }
+}
+
+/**
+  * @brief  准备写缓冲,第一次挂载时申请内存,每次挂载都清空(没写回的就丢了),wb_size变大了重新申请.
+  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  * @note   参数不对或者内存不够就不用写缓冲,wb_data是NULL(以前申请的也释放掉).
+  */
+static void WL_Flash_wbInit(wl_flash_t *WL_Flash)
+{
+    uint32_t size = WL_Flash->wb_size;
+
+    WL_Flash->wb_lo = 0;
+    WL_Flash->wb_hi = 0;
+    if ((size == 0) || ((WL_Flash->cfg.page_size % size) != 0))
+    {
+        /* 出错原因,没有配置写缓冲,或者缓冲跨了Page. */
+        size = 0;
+    }
+    WL_Flash->wb_data = (uint8_t *)WL_Flash_alloc(WL_Flash->wb_data, &WL_Flash->wb_alloc, size);
+}
+
+/**
+  * @brief  把一次小块写入攒进写缓冲.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  address: 逻辑地址.
+  * @param  src: 数据.
+  * @param  size: 长度.
+  * @retval 1: 攒进去了, 0: 跨了缓冲窗口或者没有写缓冲,要直接写.
+  * @note   NOR写入只能1变0,同一个地方写两次的结果是两次数据相与,所以缓冲里也是相与,
+  *         写回的时候一次写进去和分几次写的结果一样.攒满整个窗口马上写回.
+  */
+static uint8_t WL_Flash_wbWrite(wl_flash_t *WL_Flash, uint32_t address, const uint8_t *src, uint32_t size)
+{
+    uint32_t window, offset;
+
+    /* 没有写缓冲的时候wb_size是0,不能先取模. */
+    if ((WL_Flash->wb_data == NULL) || (size == 0))
+    {
+        return 0;
+    }
+    window = address - address % WL_Flash->wb_size;
+    offset = address - window;
+    if (offset + size > WL_Flash->wb_size)
+    {
+        return 0;
+    }
+    if ((WL_Flash->wb_lo != WL_Flash->wb_hi) && (WL_Flash->wb_addr != window))
+    {
+        /* 换窗口了,先把上一个写回去. */
+        WL_Flash_Sync(WL_Flash);
+    }
+    if (WL_Flash->wb_lo == WL_Flash->wb_hi)
+    {
+        memset(WL_Flash->wb_data, 0xFF, WL_Flash->wb_size);
+        WL_Flash->wb_addr = window;
+        WL_Flash->wb_lo = offset;
+        WL_Flash->wb_hi = offset + size;
+        WL_Flash->wb_since = xTaskGetTickCount();
+    }
+    for (uint32_t i = 0; i < size; i++)
+    {
+        WL_Flash->wb_data[offset + i] &= src[i];
+    }
+    WL_Flash->wb_lo = (offset < WL_Flash->wb_lo) ? offset : WL_Flash->wb_lo;
+    WL_Flash->wb_hi = (offset + size > WL_Flash->wb_hi) ? (offset + size) : WL_Flash->wb_hi;
+    WL_STAT(WL_Flash, wb_absorbed, 1);
+    if ((WL_Flash->wb_lo == 0) && (WL_Flash->wb_hi == WL_Flash->wb_size))
+    {
+        WL_Flash_Sync(WL_Flash);
+    }
+    return 1;
+}
+
+/**
+  * @brief  读出来的数据叠上写缓冲里还没写回的部分,结果和已经写回一样.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  address: 逻辑地址.
+  * @param  dest: 已经从Flash(或者读缓存)读出来的数据.
+  * @param  size: 长度.
+  */
+static void WL_Flash_wbMerge(wl_flash_t *WL_Flash, uint32_t address, uint8_t *dest, uint32_t size)
+{
+    uint32_t lo, hi;
+
+    if (WL_Flash->wb_lo == WL_Flash->wb_hi)
+    {
+        return;
+    }
+    lo = WL_Flash->wb_addr + WL_Flash->wb_lo;
+    hi = WL_Flash->wb_addr + WL_Flash->wb_hi;
+    lo = (address > lo) ? address : lo;
+    hi = (address + size < hi) ? (address + size) : hi;
+    for (uint32_t a = lo; a < hi; a++)
+    {
+        dest[a - address] &= WL_Flash->wb_data[a - WL_Flash->wb_addr];
+    }
+}
+
+/**
+  * @brief  准备顺序预读,第一次挂载时申请内存,每次挂载都清空,参数变大了重新申请.
+  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  * @note   参数不对,驱动不能后台读或者内存不够就不预读,ra是NULL(以前申请的也释放掉).
+  */
+static void WL_Flash_raInit(wl_flash_t *WL_Flash)
+{
+    const wl_flash_ops_t *ops = WL_OPS(WL_Flash);
+
+    /* 重新挂载的时候可能还有DMA没读完. */
+    WL_Flash_raFinish(WL_Flash);
+    if (WL_Flash->ra_streams == 0)
+    {
+        WL_Flash->ra_streams = 1;
+    }
+    if ((WL_Flash->ra_depth == 0) || (WL_Flash->ra_size == 0) || ((WL_Flash->cfg.page_size % WL_Flash->ra_size) != 0) ||
+            ((ops->caps & WL_FLASH_CAP_READ_DMA) == 0) || (ops->read_start == NULL) || (ops->read_done == NULL))
+    {
+        /* 出错原因,没有配置预读,一块跨了Page,或者驱动只能同步读. */
+        WL_Flash->ra_data = (uint8_t *)WL_Flash_alloc(WL_Flash->ra_data, &WL_Flash->ra_data_alloc, 0);
+        WL_Flash->ra = (wl_flash_ra_t *)WL_Flash_alloc(WL_Flash->ra, &WL_Flash->ra_alloc, 0);
+        return;
+    }
+    WL_Flash->ra_data = (uint8_t *)WL_Flash_alloc(WL_Flash->ra_data, &WL_Flash->ra_data_alloc, WL_Flash->ra_streams * WL_Flash->ra_depth * WL_Flash->ra_size);
+    WL_Flash->ra = (wl_flash_ra_t *)WL_Flash_alloc(WL_Flash->ra, &WL_Flash->ra_alloc, WL_Flash->ra_streams * sizeof(wl_flash_ra_t));
+    if ((WL_Flash->ra_data == NULL) || (WL_Flash->ra == NULL))
+    {
+        WL_Flash->ra_data = (uint8_t *)WL_Flash_alloc(WL_Flash->ra_data, &WL_Flash->ra_data_alloc, 0);
+        WL_Flash->ra = (wl_flash_ra_t *)WL_Flash_alloc(WL_Flash->ra, &WL_Flash->ra_alloc, 0);
+        return;
+    }
+    /* next是0xFFFFFFFF,哪次读都对不上,第一次读到的时候才开始跟踪. */
+    memset(WL_Flash->ra, 0, WL_Flash->ra_streams * sizeof(wl_flash_ra_t));
+    for (uint32_t i = 0; i < WL_Flash->ra_streams; i++)
+    {
+        WL_Flash->ra[i].next = 0xFFFFFFFF;
+    }
+    WL_Flash->ra_clock = 0;
+}
+
+/**
+  * @brief  等正在进行的预读DMA读完.发别的驱动指令之前都要先调用,QSPI同一时间只能做一件事.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  */
+static void WL_Flash_raFinish(wl_flash_t *WL_Flash)
+{
+    if (WL_Flash->ra_busy == 0)
+    {
+        return;
+    }
+    WL_PROF_BEGIN(t);
+    WL_OPS(WL_Flash)->read_done(WL_Flash->drv, 1);
+    WL_PROF_END(WL_PROF_RA_WAIT, t);
+    WL_Flash->ra[WL_Flash->ra_busy - 1].ready++;
+    WL_Flash->ra_busy = 0;
+}
+
+/**
+  * @brief  DMA空闲的话,给最近在读的流预读下一块.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @note   只在WL_Flash_xxx里调用,用户在两次读之间处理数据的时候DMA在后台读.
+  *         上一块读完了才会发下一块,所以要有人查询,WL_Flash_Poll也会调用这里.
+  */
+static void WL_Flash_raKick(wl_flash_t *WL_Flash)
+{
+    wl_flash_ra_t *best = NULL;
+
+    if (WL_Flash->ra == NULL)
+    {
+        return;
+    }
+    if (WL_Flash->ra_busy != 0)
+    {
+        if (WL_OPS(WL_Flash)->read_done(WL_Flash->drv, 0) == WL_FLASH_DRV_BUSY)
+        {
+            return;
+        }
+        WL_Flash->ra[WL_Flash->ra_busy - 1].ready++;
+        WL_Flash->ra_busy = 0;
+    }
+    for (uint32_t i = 0; i < WL_Flash->ra_streams; i++)
+    {
+        wl_flash_ra_t *ra = &WL_Flash->ra[i];
+        /* 环满了,或者已经读到末尾的不用再读. */
+        if (ra->seq && (ra->count < WL_Flash->ra_depth) && ((ra->base + ra->count + 1) * WL_Flash->ra_size <= WL_Flash->flash_size) &&
+                ((best == NULL) || (ra->stamp > best->stamp)))
+        {
+            best = ra;
+        }
+    }
+    if (best != NULL)
+    {
+        uint32_t block = best->base + best->count;
+        uint32_t stream = (uint32_t)(best - WL_Flash->ra);
+        uint32_t slot = (best->head + best->count) % WL_Flash->ra_depth;
+        uint8_t *data = WL_Flash->ra_data + (stream * WL_Flash->ra_depth + slot) * WL_Flash->ra_size;
+
+        /* 一块不跨Page,换算一次物理地址就行.挪dummy之前会先等DMA读完,读到的一定是对的. */
+        WL_OPS(WL_Flash)->read_start(WL_Flash->drv, WL_Flash->cfg.start_addr + WL_Flash_calcAddr(WL_Flash, block * WL_Flash->ra_size, NULL), data, WL_Flash->ra_size);
+        best->count++;
+        WL_Flash->ra_busy = stream + 1;
+        WL_STAT(WL_Flash, flash_read, WL_Flash->ra_size);
+        WL_STAT(WL_Flash, ra_fetches, 1);
+    }
+}
+
+/**
+  * @brief  作废和一段逻辑地址重叠的预读数据,Flash内容变了的时候调用.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  address: 逻辑地址.
+  * @param  size: 长度.
+  * @note   和读缓存一样按逻辑地址存,挪dummy不用作废.
+  */
+static void WL_Flash_raInvalidate(wl_flash_t *WL_Flash, uint32_t address, uint32_t size)
+{
+    if ((WL_Flash->ra == NULL) || (size == 0))
+    {
+        return;
+    }
+    WL_Flash_raFinish(WL_Flash);
+    for (uint32_t i = 0; i < WL_Flash->ra_streams; i++)
+    {
+        wl_flash_ra_t *ra = &WL_Flash->ra[i];
+        if ((ra->count != 0) && (address < (ra->base + ra->count) * WL_Flash->ra_size) && (address + size > ra->base * WL_Flash->ra_size))
+        {
+            /* 整个环清空,下次读再从那里开始预读. */
+            ra->count = 0;
+            ra->ready = 0;
+        }
+    }
+}
+
+/**
+  * @brief  从预读缓冲读取,顺便识别顺序读.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  address: 逻辑地址.
+  * @param  dest: 读出的数据.
+  * @param  size: 长度.
+  * @retval 1: 已经从预读缓冲读出来了, 0: 要直接读Flash.
+  * @note   从上一次读完的地方接着读就算同一个流;对不上的换掉最久没用的流,这一次不预读.
+  */
+static uint8_t WL_Flash_raRead(wl_flash_t *WL_Flash, uint32_t address, uint8_t *dest, uint32_t size)
+{
+    uint32_t ra_size = WL_Flash->ra_size;
+    wl_flash_ra_t *ra = NULL;
+    uint8_t hit = 0;
+
+    for (uint32_t i = 0; i < WL_Flash->ra_streams; i++)
+    {
+        if (WL_Flash->ra[i].next == address)
+        {
+            ra = &WL_Flash->ra[i];
+            break;
+        }
+        if ((ra == NULL) || (WL_Flash->ra[i].stamp < ra->stamp))
+        {
+            ra = &WL_Flash->ra[i];
+        }
+    }
+    if (ra->next != address)
+    {
+        /* 新的流,等它下次接着读再说. */
+        if (WL_Flash->ra_busy == (uint32_t)(ra - WL_Flash->ra) + 1)
+        {
+            WL_Flash_raFinish(WL_Flash);
+        }
+        ra->seq = 0;
+        ra->count = 0;
+        ra->ready = 0;
+    }
+    else
+    {
+        ra->seq = 1;
+        /* 已经读过去的块不要了. */
+        while ((ra->count != 0) && ((ra->base + 1) * ra_size <= address))
+        {
+            if (ra->ready == 0)
+            {
+                WL_Flash_raFinish(WL_Flash);
+            }
+            ra->base++;
+            ra->head = (ra->head + 1) % WL_Flash->ra_depth;
+            ra->count--;
+            ra->ready--;
+        }
+        if ((ra->count != 0) && (ra->base * ra_size <= address) && (address + size <= (ra->base + ra->count) * ra_size))
+        {
+            /* 最后一块还在DMA的话只能等,只有一个DMA,所以最多等一块. */
+            if ((address + size - 1) / ra_size - ra->base >= ra->ready)
+            {
+                WL_Flash_raFinish(WL_Flash);
+                WL_STAT(WL_Flash, ra_stalls, 1);
+            }
+            for (uint32_t done = 0; done < size;)
+            {
+                uint32_t index = (address + done) / ra_size - ra->base;
+                uint32_t offset = (address + done) % ra_size;
+                uint32_t len = ((ra_size - offset) < (size - done)) ? (ra_size - offset) : (size - done);
+                uint32_t slot = (ra->head + index) % WL_Flash->ra_depth;
+                memcpy(dest + done, WL_Flash->ra_data + ((uint32_t)(ra - WL_Flash->ra) * WL_Flash->ra_depth + slot) * ra_size + offset, len);
+                done += len;
+            }
+            WL_STAT(WL_Flash, ra_hits, 1);
+            hit = 1;
+        }
+        else if (ra->count != 0)
+        {
+            /* 跳着读或者一次读得太多,环里的对不上了,从头来. */
+            if (WL_Flash->ra_busy == (uint32_t)(ra - WL_Flash->ra) + 1)
+            {
+                WL_Flash_raFinish(WL_Flash);
+            }
+            ra->count = 0;
+            ra->ready = 0;
+        }
+    }
+    if (ra->count == 0)
+    {
+        ra->base = (address + size) / ra_size;
+        ra->head = 0;
+    }
+    ra->next = address + size;
+    ra->stamp = ++WL_Flash->ra_clock;
+    return hit;
+}
+
+/**
+  * @brief  从Flash读,不走读缓存和预读,叠上写缓冲,结果和WL_Flash_Read一样.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  address: 逻辑地址.
+  * @param  dest: 读到这里.
+  * @param  size: 长度.
+  */
+static void WL_Flash_readDirect(wl_flash_t *WL_Flash, uint32_t address, uint8_t *dest, uint32_t size)
+{
+    for (uint32_t done = 0; done < size;)
+    {
+        uint32_t run;
+        uint32_t len = size - done;
+        /* 已丢弃的sector不读Flash,直接是0xFF. */
+        if ((WL_Flash->trim_count != 0) && WL_Flash_trimRun(WL_Flash, address + done, &len))
+        {
+            memset(&dest[done], 0xFF, len);
+            WL_STAT(WL_Flash, discard_read, len);
+            done += len;
+            continue;
+        }
+        /* 要计算出虚拟地址,因为地址已经是乱的了.物理上连续的一段一次读完. */
+        uint32_t virt_addr = WL_Flash_calcAddr(WL_Flash, address + done, &run);
+        len = (run < len) ? run : len;
+        WL_Flash_Read_RAW(WL_Flash, WL_Flash->cfg.start_addr + virt_addr, &dest[done], len);
+        done += len;
+    }
+    /* 写缓冲里还没写回的数据叠上去. */
+    WL_Flash_wbMerge(WL_Flash, address, dest, size);
+}
+
+/**
+  * @brief  比较Flash里的内容和要写的内容.
+  * @param  old: Flash里现在的内容.
+  * @param  src: 要写的内容.
+  * @param  size: 长度.
+  * @param  first: 结果是WL_FLASH_UPD_PROGRAM时,返回第一个不一样的字节.
+  * @param  last: 同上,返回最后一个不一样的字节的下一个.
+  * @retval WL_FLASH_UPD_xxx.
+  * @note   按字比较,尾巴按字节.src不用对齐,memcpy在M4上编译出来就是一条LDR.
+  */
+static uint8_t WL_Flash_compare(const uint8_t *old, const uint8_t *src, uint32_t size, uint32_t *first, uint32_t *last)
+{
+    uint8_t result = WL_FLASH_UPD_SAME;
+    uint32_t i = 0;
+
+    for (; i + 4 <= size; i += 4)
+    {
+        uint32_t o, n;
+        memcpy(&o, &old[i], 4);
+        memcpy(&n, &src[i], 4);
+        if (o == n)
+        {
+            continue;
+        }
+        if ((o & n) != n)
+        {
+            return WL_FLASH_UPD_ERASE;
+        }
+        /* 计数器,位图每次只清一位,精确到字节,写得越少越快. */
+        for (uint32_t k = i; k < i + 4; k++)
+        {
+            if (old[k] != src[k])
+            {
+                *first = (result == WL_FLASH_UPD_SAME) ? k : *first;
+                *last = k + 1;
+                result = WL_FLASH_UPD_PROGRAM;
+            }
+        }
+    }
+    for (; i < size; i++)
+    {
+        if (old[i] == src[i])
+        {
+            continue;
+        }
+        if ((old[i] & src[i]) != src[i])
+        {
+            return WL_FLASH_UPD_ERASE;
+        }
+        *first = (result == WL_FLASH_UPD_SAME) ? i : *first;
+        *last = i + 1;
+        result = WL_FLASH_UPD_PROGRAM;
+    }
+    return result;
+}
+
+/**
+  * @brief  一块一块从Flash读出来和要写的内容比较,遇到要擦的就不用再比了.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  address: 逻辑地址.
+  * @param  src: 要写的内容.
+  * @param  size: 长度.
+  * @param  first: 结果是WL_FLASH_UPD_PROGRAM时,返回第一个不一样的字节(相对address).
+  * @param  last: 同上,返回最后一个不一样的字节的下一个.
+  * @retval WL_FLASH_UPD_xxx.
+  */
+static uint8_t WL_Flash_checkRange(wl_flash_t *WL_Flash, uint32_t address, const uint8_t *src, uint32_t size, uint32_t *first, uint32_t *last)
+{
+    uint32_t chunk[WL_FLASH_CMP_CHUNK / 4]; /* 按字对齐,比较的时候可以按字读 */
+    uint8_t need = WL_FLASH_UPD_SAME;
+
+    for (uint32_t off = 0; (off < size) && (need != WL_FLASH_UPD_ERASE); off += WL_FLASH_CMP_CHUNK)
+    {
+        uint32_t n = (size - off < WL_FLASH_CMP_CHUNK) ? (size - off) : WL_FLASH_CMP_CHUNK;
+        uint32_t f = 0, l = 0;
+        uint8_t cmp;
+
+        WL_Flash_readDirect(WL_Flash, address + off, (uint8_t *)chunk, n);
+        cmp = WL_Flash_compare((uint8_t *)chunk, &src[off], n, &f, &l);
+        if (cmp != WL_FLASH_UPD_SAME)
+        {
+            *first = (need == WL_FLASH_UPD_SAME) ? (off + f) : *first;
+            *last = off + l;
+            need = (cmp > need) ? cmp : need;
+        }
+    }
+    return need;
+}
+
+/**
+  * @brief  擦掉一个sector再写回去,给WL_Flash_Update用.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  address: 要改的逻辑地址,[address, address + size)不跨sector.
+  * @param  src: 新内容.
+  * @param  size: 长度.
+  * @retval 1: 成功, 0: 只改一部分,申请不到sector大小的内存.
+  * @note   只改一部分的话,sector其余的内容先读到RAM里,和新内容拼好再写.擦完是0xFF,头尾的0xFF不用写.
+  */
+static uint8_t WL_Flash_rewriteSector(wl_flash_t *WL_Flash, uint32_t address, const uint8_t *src, uint32_t size)
+{
+    uint32_t base = address - address % WL_Flash->cfg.sector_size;
+    uint32_t lo = 0, hi = WL_Flash->cfg.sector_size;
+    uint8_t *merge = NULL;
+    const uint8_t *data = src;
+
+    if (size != WL_Flash->cfg.sector_size)
+    {
+        merge = (uint8_t *)pvPortMalloc(WL_Flash->cfg.sector_size);
+        if (merge == NULL)
+        {
+            return 0;
+        }
+        WL_Flash_readDirect(WL_Flash, base, merge, WL_Flash->cfg.sector_size);
+        memcpy(&merge[address - base], src, size);
+        data = merge;
+    }
+    WL_Flash_Erase_Range(WL_Flash, base, WL_Flash->cfg.sector_size);
+    while ((lo < hi) && (data[lo] == 0xFF))
+    {
+        lo++;
+    }
+    while ((hi > lo) && (data[hi - 1] == 0xFF))
+    {
+        hi--;
+    }
+    if (hi > lo)
+    {
+        WL_Flash_Write(WL_Flash, base + lo, &data[lo], hi - lo);
+    }
+    if (merge != NULL)
+    {
+        vPortFree(merge);
+    }
+    WL_STAT(WL_Flash, update_erases, 1);
+    return 1;
+}
 
 /**
-  * @brief  从虚拟地址计算出物理地址.
-  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
-  * @param  addr: 虚拟地址.
+  * @brief  是不是全是0xFF,擦完就是这样,不用写.
   */
-static uint32_t WL_Flash_calcAddr(wl_flash_t *WL_Flash, uint32_t addr)
+static uint8_t WL_Flash_isBlank(const uint8_t *data, uint32_t size)
 {
-    /* 计算得到物理地址了. */
-    uint32_t result = (WL_Flash->flash_size - WL_Flash->state.move_count * WL_Flash->cfg.page_size + addr) % WL_Flash->flash_size;
-    /* 计算出对应的dummy_addr. */
-    uint32_t dummy_addr = WL_Flash->state.pos * WL_Flash->cfg.page_size;
-    /* 如果计算结果没占用到dummy_addr储存区域,就不用管.如果占用到了,那要往下一个page挪动. */
-    if (result >= dummy_addr)
+    for (uint32_t i = 0; i < size; i++)
     {
-        result += WL_Flash->cfg.page_size;
+        if (data[i] != 0xFF)
+        {
+            return 0;
+        }
     }
-    return result;
+    return 1;
 }
 
 /**
-  * @brief  擦SubSector + 更新WL.
-  * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
-  * @param  sector: 需要擦的SubSector的地址.
+  * @brief  写合并日志,两份state里当前坐标的那几个字节都写.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  offset: WL_RMW_xxx.
+  * @param  data: 内容.
+  * @param  size: 长度.
+  * @note   找坐标只看每个坐标的第一个字节,重写坐标时其他字节写的是0xFF,日志不会被影响.
   */
-static void WL_Flash_Erase_Sector(wl_flash_t *WL_Flash, uint32_t sector)
+static void WL_Flash_rmwLog(wl_flash_t *WL_Flash, uint32_t offset, const uint8_t *data, uint32_t size)
 {
-    /* 先更新表,这时候pos就移动了,更新WL的时刻只有此时出现. */
-    WL_Flash_updateWL(WL_Flash);
-    /* 转换虚拟地址,VA -> PA变换. */
-    uint32_t virt_addr = WL_Flash_calcAddr(WL_Flash, sector * WL_Flash->cfg.sector_size);
-    /* 执行真实擦除. */
-    BSP_QSPI_Erase_Block(WL_Flash->cfg.start_addr + virt_addr);
+    uint32_t slot = sizeof(wl_state_t) + WL_Flash->state.pos * WL_Flash->cfg.wr_size + offset;
+
+    WL_Flash_Program_RAW(WL_Flash, WL_Flash->addr_state1 + slot, data, size);
+    WL_Flash_Program_RAW(WL_Flash, WL_Flash->addr_state2 + slot, data, size);
 }
 
 /**
-  * @brief  初始化这个Flash磨损平衡的底层函数.
+  * @brief  合并的后半段: 擦掉原来的Page,把dummy里拼好的内容复制回去,记下完成.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  dummy: dummy的物理地址.
+  * @param  phys: 原来的Page的物理地址.
+  * @note   dummy下次挪动之前不会变,中途掉电的话挂载时从头再做一次,结果一样.
+  */
+static void WL_Flash_rmwFinish(wl_flash_t *WL_Flash, uint32_t dummy, uint32_t phys)
+{
+    const uint8_t zero = 0x00;
+
+    WL_Flash_Erase_RAW(WL_Flash, phys, WL_Flash->cfg.page_size);
+    for (uint32_t off = 0; off < WL_Flash->cfg.page_size; off += WL_Flash->cfg.temp_buff_size)
+    {
+        WL_Flash_Read_RAW(WL_Flash, dummy + off, WL_Flash->temp_buff, WL_Flash->cfg.temp_buff_size);
+        if (!WL_Flash_isBlank(WL_Flash->temp_buff, WL_Flash->cfg.temp_buff_size))
+        {
+            WL_Flash_Program_RAW(WL_Flash, phys + off, WL_Flash->temp_buff, WL_Flash->cfg.temp_buff_size);
+        }
+    }
+    WL_Flash_rmwLog(WL_Flash, WL_RMW_DONE, &zero, 1);
+}
+
+/**
+  * @brief  挂载时检查当前坐标的合并日志,新内容已经在dummy里但还没复制完就掉电的话,接着复制.
   * @param  WL_FLash: 磨损平衡结构体(此时正在初始化,此函数不是用户调用的.).
+  * @note   两份日志先后写,哪份说没做完就再做一次.
   */
-static void WL_Flash_initSections(wl_flash_t *WL_Flash)
+static void WL_Flash_rmwRecover(wl_flash_t *WL_Flash)
 {
-    /* 第一次初始化,pos当然是0. */
-    WL_Flash->state.pos = 0;
-    /* 第一次初始化,pos当然是0. */
-    WL_Flash->state.move_count = 0;
-    /* 更新后当前state的版本跟用户配置版本肯定是一样的啊. */
-    WL_Flash->state.version = WL_Flash->cfg.version;
-    /* 粒度大小 = SubSector大小,这样很方便. */
-    WL_Flash->state.block_size = WL_Flash->cfg.page_size;
-    /* max_pos是由可用SubSector扇区数量决定的,比如16MB的W25Q128就是4000个左右(要减去冗余和计算部分). */
-    WL_Flash->state.max_pos = 1 + WL_Flash->flash_size / WL_Flash->cfg.page_size;
-    /* 计算state的CRC,因为每此上电都判断这个来表示state的内容是否正确. */
-    WL_Flash->state.crc = Calculate_CRC((uint8_t *)&WL_Flash->state, sizeof(wl_state_t) - sizeof(uint32_t));
-    /* 把两个state都存起来,以便掉电还能重新取出. */
-    WL_Flash_Erase_RAW(WL_Flash, WL_Flash->addr_state1, WL_Flash->state_size);
-    BSP_QSPI_Write((uint8_t *)&WL_Flash->state, WL_Flash->addr_state1, sizeof(wl_state_t));
-    /* 因为冗余了两份,所以要写两次. */
-    WL_Flash_Erase_RAW(WL_Flash, WL_Flash->addr_state2, WL_Flash->state_size);
-    BSP_QSPI_Write((uint8_t *)&WL_Flash->state, WL_Flash->addr_state2, sizeof(wl_state_t));
-    /* 地址配置也要写进去. */
-    WL_Flash_Erase_RAW(WL_Flash, WL_Flash->addr_cfg, WL_Flash->cfg_size);
-    BSP_QSPI_Write((uint8_t *)&WL_Flash->cfg, WL_Flash->addr_cfg, sizeof(wl_config_t));
+    uint8_t log[WL_RMW_LOG];
+    uint32_t page;
+
+    if (WL_Flash->cfg.wr_size < WL_RMW_LOG)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        uint32_t state_addr = (i == 0) ? WL_Flash->addr_state1 : WL_Flash->addr_state2;
+        WL_Flash_Read_RAW(WL_Flash, state_addr + sizeof(wl_state_t) + WL_Flash->state.pos * WL_Flash->cfg.wr_size, log, WL_RMW_LOG);
+        if ((log[WL_RMW_COMMIT] != 0x00) || (log[WL_RMW_DONE] == 0x00))
+        {
+            continue;
+        }
+        /* Page号比标记先写,标记写了Page号就是完整的. */
+        memcpy(&page, &log[WL_RMW_PAGE], sizeof(page));
+        if ((page < WL_Flash->state.max_pos) && (page != WL_Flash->state.pos))
+        {
+            WL_Flash_rmwFinish(WL_Flash, WL_Flash->cfg.start_addr + WL_Flash->state.pos * WL_Flash->cfg.page_size,
+                               WL_Flash->cfg.start_addr + page * WL_Flash->cfg.page_size);
+        }
+        return;
+    }
 }
 
 /**
-  * @brief  恢复正在使用的坐标.
+  * @brief  不用Page大小的内存改一个Page: 旧内容和新内容一边拼一边复制到擦好的dummy,再复制回去.
   * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
-  * @param  start_address: 起始地址.
-  * @param  size: 需要擦除长度.
+  * @param  base: Page的逻辑地址.
+  * @param  lo: 新内容在Page里的起始偏移.
+  * @param  hi: 新内容在Page里的结束偏移(不含).
+  * @param  src: 新内容,对应[lo, hi).
+  * @note   先和擦除一样挪一次dummy,合并用的dummy跟着转,不会一直擦同一个地方.
+  *         [lo, hi)里已丢弃的sector先去掉标记(page_size比sector_size大时,同一个Page里可能一半丢弃一半要擦).
+  *         日志标记之前掉电,原来的Page没动过;之后掉电,挂载时接着复制,所以Page要么是旧的要么是新的.
   */
-static void WL_Flash_recoverPos(wl_flash_t *WL_Flash)
+static void WL_Flash_rmwPage(wl_flash_t *WL_Flash, uint32_t base, uint32_t lo, uint32_t hi, const uint8_t *src)
 {
-    /* 循环查找所有坐标,时间不确定性. */
-    for (size_t i = 0; i < WL_Flash->state.max_pos; i++)
+    uint32_t step = WL_Flash->cfg.temp_buff_size;
+    uint32_t dummy, phys, page;
+    const uint8_t zero = 0x00;
+
+    /* 新内容盖住的已丢弃sector先变回能用(不空就擦掉),不然拼好以后标记还在,读出来还是0xFF.
+       先擦后改标记,掉电的话还是已丢弃,和WL_Flash_Write一样. */
+    if (WL_Flash->trim_count != 0)
     {
-        uint8_t pos_bits = 0;
-        /* 把坐标位读出来,如果用了的坐标是0x00的,没用就是0xFF的. */
-        BSP_QSPI_Read(&pos_bits, WL_Flash->addr_state1 + sizeof(wl_state_t) + i * WL_Flash->cfg.wr_size, 1);
-        /* 开始判断是不是找到了. */
-        if (pos_bits == 0xff)
+        WL_Flash_trimRevive(WL_Flash, base + lo, hi - lo);
+    }
+    WL_Flash_updateWL(WL_Flash);
+    dummy = WL_Flash->cfg.start_addr + WL_Flash->state.pos * WL_Flash->cfg.page_size;
+    phys = WL_Flash->cfg.start_addr + WL_Flash_calcAddr(WL_Flash, base, NULL);
+
+    /* 旧内容(叠上写缓冲)一块一块读出来,拼上新内容写到dummy. */
+    WL_Flash_Erase_RAW(WL_Flash, dummy, WL_Flash->cfg.page_size);
+    for (uint32_t off = 0; off < WL_Flash->cfg.page_size; off += step)
+    {
+        uint32_t a = (lo > off) ? lo : off;
+        uint32_t b = (hi < off + step) ? hi : (off + step);
+
+        WL_Flash_readDirect(WL_Flash, base + off, WL_Flash->temp_buff, step);
+        if (a < b)
+        {
+            memcpy(&WL_Flash->temp_buff[a - off], &src[a - lo], b - a);
+        }
+        if (!WL_Flash_isBlank(WL_Flash->temp_buff, step))
         {
-            /* 填坐标,因为找到了,现在这个坐标就是可以用的坐标了. */
-            WL_Flash->state.pos = i;
-            break; /* 找到坐标了,跳出循环. */
+            WL_Flash_Program_RAW(WL_Flash, dummy + off, WL_Flash->temp_buff, step);
         }
     }
-    /* 如果是最大pos了,就减一下,不然就覆盖后面的配置了,到下次更新磨损平衡表就能修复pos的这个问题.所以此处不修复.(因为上电要执行这个函数,费时费力.) */
-    if (WL_Flash->state.pos == WL_Flash->state.max_pos)
+
+    /* 先记Page号,再标记dummy里的内容完整了. */
+    page = (phys - WL_Flash->cfg.start_addr) / WL_Flash->cfg.page_size;
+    WL_Flash_rmwLog(WL_Flash, WL_RMW_PAGE, (const uint8_t *)&page, sizeof(page));
+    WL_Flash_rmwLog(WL_Flash, WL_RMW_COMMIT, &zero, 1);
+    WL_Flash_rmwFinish(WL_Flash, dummy, phys);
+
+    /* 写缓冲里这个Page的内容已经一起写进去了. */
+    if ((WL_Flash->wb_lo != WL_Flash->wb_hi) && (WL_Flash->wb_addr / WL_Flash->cfg.page_size == base / WL_Flash->cfg.page_size))
     {
-        WL_Flash->state.pos--;
+        WL_Flash->wb_lo = WL_Flash->wb_hi = 0;
     }
-
+    WL_Flash_cacheInvalidate(WL_Flash, base, WL_Flash->cfg.page_size);
+    WL_Flash_raInvalidate(WL_Flash, base, WL_Flash->cfg.page_size);
+    WL_STAT(WL_Flash, rmw_pages, 1);
 }
 
 /**
@@ -120,11 +1588,15 @@ static void WL_Flash_recoverPos(wl_flash_t *WL_Flash)
   */
 static void WL_Flash_Erase_RAW(wl_flash_t *WL_Flash, uint32_t start_address, uint32_t size)
 {
-    uint32_t i = 0;
-    for (i = 0; i < size / WL_Flash->cfg.sector_size; i++)
+    /* 不足一个sector的部分不擦,和以前一样. */
+    uint32_t end_address = start_address + (size / WL_Flash->cfg.sector_size) * WL_Flash->cfg.sector_size;
+    while (start_address < end_address)
     {
+        /* 每次都挑能用的最大擦除. */
+        uint32_t erase_size = WL_Flash_Erase_Plan(WL_Flash, start_address, end_address - start_address);
 		/* 已经是物理擦除. */
-        BSP_QSPI_Erase_Block(start_address + (i * WL_Flash->cfg.sector_size));
+        WL_Flash_Erase_Block(WL_Flash, start_address, erase_size);
+        start_address += erase_size;
     }
 }
 
@@ -134,6 +1606,7 @@ static void WL_Flash_Erase_RAW(wl_flash_t *WL_Flash, uint32_t start_address, uin
   */
 static void WL_Flash_updateWL(wl_flash_t *WL_Flash)
 {
+    WL_PROF_BEGIN(t);
     /* 等下要清零的,先储存一个数据. */
     const uint8_t used_bits = 0;
     /* 下次要访问的pos偏移,要不断移动pos,才能做到平衡.不能总在操作一个地方. */
@@ -142,27 +1615,49 @@ static void WL_Flash_updateWL(wl_flash_t *WL_Flash)
     {
         data_addr = 0;
     }
+    /* 要挪的这个Page上面的sector全都丢弃了的话不用复制,dummy擦完空着就行,读的时候本来就是0xFF.
+       page_size比sector_size大时,只要有一个sector没丢弃就整个Page照常复制. */
+    uint8_t skip = (WL_Flash->trim_count != 0);
+    if (skip)
+    {
+        uint32_t sector = WL_Flash_logicalAddr(WL_Flash, (uint32_t)data_addr) / WL_Flash->cfg.sector_size;
+        for (uint32_t i = 0; skip && (i < WL_Flash->cfg.page_size / WL_Flash->cfg.sector_size); i++)
+        {
+            skip = WL_TRIM_TEST(WL_Flash, sector + i);
+        }
+    }
     /* 算出真正的需要磨损的下一page地址.实际上要改move_count才真正修改磨损坐标偏移. */
     data_addr = WL_Flash->cfg.start_addr + data_addr * WL_Flash->cfg.page_size;
     /* 根据pos偏移,算出我需要的dummy_addr位置.这是下一个要用的位置.擦掉. */
     WL_Flash->dummy_addr = WL_Flash->cfg.start_addr + WL_Flash->state.pos * WL_Flash->cfg.page_size;
     /* 擦掉下一个要用到的位置. */
     WL_Flash_Erase_RAW(WL_Flash, WL_Flash->dummy_addr, WL_Flash->cfg.page_size);
+    WL_STAT(WL_Flash, wl_updates, 1);
+    if (skip)
+    {
+        WL_STAT(WL_Flash, discard_skipped, WL_Flash->cfg.page_size);
+    }
+    else
+    {
+        WL_STAT(WL_Flash, reloc, WL_Flash->cfg.page_size);
+    }
     /* 根据buff求出需要复制的次数,所以buff越大速度越快,当然也是有理论上限的. */
-    size_t copy_count = WL_Flash->cfg.page_size / WL_Flash->cfg.temp_buff_size;
+    size_t copy_count = skip ? 0 : (WL_Flash->cfg.page_size / WL_Flash->cfg.temp_buff_size);
     for (size_t i = 0; i < copy_count; i++)
     {
         /* 先读取当前位置的,然后写到下一位置的.复制数据. */
-        BSP_QSPI_Read(WL_Flash->temp_buff, data_addr + i * WL_Flash->cfg.temp_buff_size, WL_Flash->cfg.temp_buff_size);
-        BSP_QSPI_Write(WL_Flash->temp_buff, WL_Flash->dummy_addr + i * WL_Flash->cfg.temp_buff_size, WL_Flash->cfg.temp_buff_size);
+        WL_Flash_Read_RAW(WL_Flash, data_addr + i * WL_Flash->cfg.temp_buff_size, WL_Flash->temp_buff, WL_Flash->cfg.temp_buff_size);
+        WL_Flash_Program_RAW(WL_Flash, WL_Flash->dummy_addr + i * WL_Flash->cfg.temp_buff_size, WL_Flash->temp_buff, WL_Flash->cfg.temp_buff_size);
     }
     /* 求出新pos位置. */
     uint32_t byte_pos = WL_Flash->state.pos * WL_Flash->cfg.wr_size;
+    WL_PROF_BEGIN(m);
     /* 标准当前正在使用的位.(对应的pos位为0表示已经用了.) */
-    BSP_QSPI_Write((uint8_t *)&used_bits, WL_Flash->addr_state1 + sizeof(wl_state_t) + byte_pos, 1);
-    BSP_QSPI_Write((uint8_t *)&used_bits, WL_Flash->addr_state2 + sizeof(wl_state_t) + byte_pos, 1);
+    WL_Flash_Program_RAW(WL_Flash, WL_Flash->addr_state1 + sizeof(wl_state_t) + byte_pos, (uint8_t *)&used_bits, 1);
+    WL_Flash_Program_RAW(WL_Flash, WL_Flash->addr_state2 + sizeof(wl_state_t) + byte_pos, (uint8_t *)&used_bits, 1);
     /* 但是现在用的是新pos位.也就是下一个pos位,每次都挪动一次pos.正常来说只要执行擦除,pos就挪动,使用磨损平衡库依然需要擦除各种,但是这个磨损库不用建FTL对照表. */
     WL_Flash->state.pos++;
+    WL_Flash->state_gen++;
     /* 到最大pos的话当然就要归零,不然就可以直接出去了.所以这个功能不是时间确定性的. */
     if (WL_Flash->state.pos >= WL_Flash->state.max_pos)
     {
@@ -176,14 +1671,17 @@ static void WL_Flash_updateWL(wl_flash_t *WL_Flash)
             WL_Flash->state.move_count = 0;
         }
         /* 更新state结构,因为这个结构已经改了,另外要写两份,因为两个地方. */
+        WL_STAT(WL_Flash, state_rewrites, 2);
         WL_Flash->state.crc = Calculate_CRC((uint8_t *)&WL_Flash->state, sizeof(wl_state_t) - sizeof(uint32_t));
         WL_Flash_Erase_RAW(WL_Flash, WL_Flash->addr_state1, WL_Flash->state_size);
-        BSP_QSPI_Write((uint8_t *)&WL_Flash->state, WL_Flash->addr_state1, sizeof(wl_state_t));
+        WL_Flash_Program_RAW(WL_Flash, WL_Flash->addr_state1, (uint8_t *)&WL_Flash->state, sizeof(wl_state_t));
         /* 再写一份,冗余的. */
         WL_Flash_Erase_RAW(WL_Flash, WL_Flash->addr_state2, WL_Flash->state_size);
-        BSP_QSPI_Write((uint8_t *)&WL_Flash->state, WL_Flash->addr_state2, sizeof(wl_state_t));
+        WL_Flash_Program_RAW(WL_Flash, WL_Flash->addr_state2, (uint8_t *)&WL_Flash->state, sizeof(wl_state_t));
 
     }
+    WL_PROF_END(WL_PROF_MARKER, m);
+    WL_PROF_END(WL_PROF_RELOCATE, t);
 }
 
 /**
@@ -194,16 +1692,41 @@ static void WL_Flash_updateWL(wl_flash_t *WL_Flash)
   */
 void WL_Flash_Erase_Range(wl_flash_t *WL_Flash, uint32_t start_address, uint32_t size)
 {
+    WL_TRACE(WL_TRACE_WL_ERASE, start_address, size);
+    WL_PROF_BEGIN(t);
     uint32_t i = 0;
     /* 需要擦的块数量.用单位块大小来计算. */
     uint32_t erase_count = (size + WL_Flash->cfg.sector_size - 1) / WL_Flash->cfg.sector_size;
     /* 起始块所在地址. */
     uint32_t start_sector = start_address / WL_Flash->cfg.sector_size;
+    WL_STAT(WL_Flash, user_erase, erase_count * WL_Flash->cfg.sector_size);
+    WL_STAT(WL_Flash, user_erase_ops, erase_count);
+    WL_Flash_Poll(WL_Flash);
+    WL_Flash_cacheInvalidate(WL_Flash, start_sector * WL_Flash->cfg.sector_size, erase_count * WL_Flash->cfg.sector_size);
+    WL_Flash_raInvalidate(WL_Flash, start_sector * WL_Flash->cfg.sector_size, erase_count * WL_Flash->cfg.sector_size);
+    /* 写缓冲在要擦的范围里的话,写回去也会被擦掉,直接丢掉.窗口不跨Page,不会一半在里面. */
+    if ((WL_Flash->wb_lo != WL_Flash->wb_hi) && (WL_Flash->wb_addr / WL_Flash->cfg.sector_size >= start_sector) &&
+            (WL_Flash->wb_addr / WL_Flash->cfg.sector_size < start_sector + erase_count))
+    {
+        WL_Flash->wb_lo = WL_Flash->wb_hi = 0;
+    }
     for (i = 0; i < erase_count; i++)
     {
         /* 循环擦除. */
         WL_Flash_Erase_Sector(WL_Flash, start_sector + i);
+        /* 擦过了就又能用了,先擦后改位图,中间掉电还是已丢弃,读出来一样是0xFF. */
+        if ((WL_Flash->trim_count != 0) && (start_sector + i < WL_Flash->trim_blocks))
+        {
+            WL_Flash_trimMark(WL_Flash, start_sector + i, 0);
+        }
+    }
+    /* 攒够了就把擦除次数写回去. */
+    if (WL_Flash->wear_dirty >= WL_FLASH_WEAR_FLUSH)
+    {
+        WL_Flash_FlushWear(WL_Flash);
     }
+    WL_PROF_END(WL_PROF_WL_ERASE, t);
+    WL_TRACE(WL_TRACE_WL_ERASE | WL_TRACE_DONE, start_address, size);
 }
 
 /**
@@ -218,14 +1741,17 @@ void WL_Flash_Erase_Range(wl_flash_t *WL_Flash, uint32_t start_address, uint32_t
   *  WL_Flash.cfg.version = 0x00000001; -- 版本
   *  WL_Flash.cfg.temp_buff_size = 0x00000020; -- 缓冲大小
   *
+  * @retval 1: 挂载成功, 0: Flash上是旧版16位格式的state,但是这个配置下新格式的state比旧的多占sector,
+  *         数据区位置变了没法原地迁移.这时候没有挂载,Flash也没有改,不能调用其他WL_Flash_xxx;
+  *         数据不要了的话调WL_Flash_Format,否则要用旧版程序把数据读出来.
   */
-void WL_Flash_Config(wl_flash_t *WL_Flash)
+uint8_t WL_Flash_Config(wl_flash_t *WL_Flash)
 {
     wl_state_t sa_copy; /* 储存的第二份state结构体. */
     wl_state_t *state_copy = &sa_copy; /* sa_copy对应的指针. */
     uint32_t check_size = 0; /* CRC需要计算的尺寸. */
-    static uint32_t crc1; /* 需要计算的CRC1 */
-    static uint32_t crc2; /* 需要计算的CRC2 */
+    uint32_t crc1; /* 需要计算的CRC1 */
+    uint32_t crc2; /* 需要计算的CRC2 */
 
     /* 计算配置结构体的CRC.最后一个结构体是CRC,所以最后一个结构体不算. */
     WL_Flash->cfg.crc = Calculate_CRC((uint8_t *)(&WL_Flash->cfg), sizeof(wl_config_t) - sizeof(WL_Flash->cfg.crc));
@@ -242,8 +1768,11 @@ void WL_Flash_Config(wl_flash_t *WL_Flash)
         /* 出错原因,Page(一般4K)比Sector(一般64K)还小. */
     }
 
-    /* 申请内存,如果不使用FreeRTOS,那么要移植这个函数. */
-    WL_Flash->temp_buff = (uint8_t *)pvPortMalloc(WL_Flash->cfg.temp_buff_size);
+    /* 记下芯片支持的擦除大小,给擦除规划用. */
+    WL_OPS(WL_Flash)->info(WL_Flash->drv, &WL_Flash->chip_size, WL_Flash->erase_size);
+
+    /* 第一次挂载时申请,重新挂载的话用上次申请的,temp_buff_size变大了重新申请. */
+    WL_Flash->temp_buff = (uint8_t *)WL_Flash_alloc(WL_Flash->temp_buff, &WL_Flash->temp_buff_alloc, WL_Flash->cfg.temp_buff_size);
     /* 使得一个state_size占用一个sector.这样可以先判断是否一个sector能存下这个东西. */
     WL_Flash->state_size = WL_Flash->cfg.sector_size;
 
@@ -264,12 +1793,29 @@ void WL_Flash_Config(wl_flash_t *WL_Flash)
     WL_Flash->addr_state1 = WL_Flash->cfg.start_addr + WL_Flash->cfg.full_mem_size - WL_Flash->state_size * 2 - WL_Flash->cfg_size; /* 同上 */
     WL_Flash->addr_state2 = WL_Flash->cfg.start_addr + WL_Flash->cfg.full_mem_size - WL_Flash->state_size * 1 - WL_Flash->cfg_size; /* 同上 */
 
+    /* 擦除次数区放在state1前面,不统计的话大小是0,布局和以前一样. */
+    WL_Flash->wear_size = WL_Flash->cfg.wear_sectors * WL_Flash->cfg.sector_size;
+    WL_Flash->addr_wear = WL_Flash->addr_state1 - WL_Flash->wear_size;
+    /* 丢弃位图区再往前,不支持的话大小也是0. */
+    WL_Flash->trim_size = WL_Flash->cfg.trim_sectors * WL_Flash->cfg.sector_size;
+    WL_Flash->addr_trim = WL_Flash->addr_wear - WL_Flash->trim_size;
+
     /* 所剩可用 */
-    WL_Flash->flash_size = ((WL_Flash->cfg.full_mem_size - WL_Flash->state_size * 2 - WL_Flash->cfg_size) / WL_Flash->cfg.page_size - 1) * WL_Flash->cfg.page_size; // 再让出一个区(dummy)
+    WL_Flash->flash_size = ((WL_Flash->cfg.full_mem_size - WL_Flash->state_size * 2 - WL_Flash->cfg_size - WL_Flash->wear_size - WL_Flash->trim_size) / WL_Flash->cfg.page_size - 1) * WL_Flash->cfg.page_size; // 再让出一个区(dummy)
+
+    /* 先把擦除次数读回来,下面恢复state时的擦除也要记. */
+    WL_Flash_wearLoad(WL_Flash);
+    /* 丢弃位图也要在挪dummy之前读回来,不然已丢弃的Page会白复制. */
+    WL_Flash_trimLoad(WL_Flash);
+    /* 重新挂载的话Flash可能被别人改过,缓存全部作废. */
+    WL_Flash_cacheInit(WL_Flash);
+    WL_Flash_wbInit(WL_Flash);
+    WL_Flash_raInit(WL_Flash);
 
     /* 进入初始化流程,先把两个都读出来,这里存的就是数据,这两个块磨损很大,所以需要备份,以免其中一个挂掉了. */
-    BSP_QSPI_Read((uint8_t *)&WL_Flash->state, WL_Flash->addr_state1, sizeof(wl_state_t)); /* 读取两个状态寄存器 */
-    BSP_QSPI_Read((uint8_t *)state_copy, WL_Flash->addr_state2, sizeof(wl_state_t));
+    WL_Flash_Read_RAW(WL_Flash, WL_Flash->addr_state1, (uint8_t *)&WL_Flash->state, sizeof(wl_state_t)); /* 读取两个状态寄存器 */
+    WL_Flash->state_gen++;
+    WL_Flash_Read_RAW(WL_Flash, WL_Flash->addr_state2, (uint8_t *)state_copy, sizeof(wl_state_t));
 
     /* CRC计算,确保数据正确(或者区块磨损极限了). */
     check_size = sizeof(wl_state_t) - sizeof(uint32_t);
@@ -292,22 +1838,8 @@ void WL_Flash_Config(wl_flash_t *WL_Flash)
             /* CRC1 不等于 CRC2,但是他们都等于他们各自储存的CRC,所以区块没有坏,只是需要更新第二结构体. */
             if (crc1 != crc2)
             {
-                /* 擦掉第二结构体. */
-                WL_Flash_Erase_RAW(WL_Flash, WL_Flash->addr_state2, WL_Flash->state_size);
-                /* 把第一结构体内容放到第二结构体里面去. */
-                BSP_QSPI_Write((uint8_t *)&WL_Flash->state, WL_Flash->addr_state2, sizeof(wl_state_t));
-                for (size_t i = 0; i < ((WL_Flash->cfg.full_mem_size / WL_Flash->cfg.sector_size)*WL_Flash->cfg.wr_size); i++)
-                {
-                    uint8_t pos_bits = 0;
-                    /* 从1号开始读,然后如果有数据,就写到2号,当然不判断0xFF也行,但是浪费编程时间啊. */
-                    BSP_QSPI_Read(&pos_bits, WL_Flash->addr_state1 + sizeof(wl_state_t) + i, 1);
-                    if (pos_bits != 0xff)
-                    {
-                        /* 从1号有数据,要写到2号的,所以开始写了. */
-                        BSP_QSPI_Write(&pos_bits, WL_Flash->addr_state2 + sizeof(wl_state_t) + i, 1);
-                    }
-                }
-
+                /* 把第一结构体连同坐标整个重写到第二结构体,坐标一段一段写,不用一个字节一个字节复制. */
+                WL_Flash_writeState(WL_Flash, WL_Flash->addr_state2, WL_Flash_countPos(WL_Flash, WL_Flash->addr_state1));
                 /* 把这个执行过后,1和2号的内容就一样了. */
             }
             /* 如果两个都是好的,直接到这里,恢复写指针. */
@@ -317,58 +1849,39 @@ void WL_Flash_Config(wl_flash_t *WL_Flash)
     else if ((crc1 != WL_Flash->state.crc) && (crc2 != state_copy->crc))
     {
         /* 新的Flash.因为两个都是0xFF,所以进入这里,当然也可以是Flash坏得太厉害. */
-        /* 然后进入初始化. */
-        WL_Flash_initSections(WL_Flash);
+        /* 也可能是旧版16位格式的state,能迁移就迁移,没有旧state就进入初始化,有但是迁移不了就不挂载. */
+        uint8_t migrated = WL_Flash_migrateState(WL_Flash);
+        if (migrated == 2)
+        {
+            return 0;
+        }
+        if (migrated == 0)
+        {
+            WL_Flash_initSections(WL_Flash);
+        }
         /* 初始化(恢复)坐标. */
         WL_Flash_recoverPos(WL_Flash);
     }
     else
     {
         /* Flash 老化但是能用,或者数据有点乱. */
+        /*
+         * state总是先写1号再写2号,掉电时正在重写的那份CRC不对,另外一份就是完整的.
+         * 把好的那份连同坐标重写到坏的那份,坐标一段一段写,然后按坐标恢复pos.
+         * 转圈时重写1号之前掉电的话,2号的坐标全部用了,恢复出来是max_pos - 1,和原来一样.
+         */
         if (crc1 == WL_Flash->state.crc)  /* CRC1是对的,证明第一个结构体是没问题的,那么就是第二个结构体有问题. */
         {
-            /* 擦掉第二结构体.因为第二结构体有问题. */
-            WL_Flash_Erase_RAW(WL_Flash, WL_Flash->addr_state2, WL_Flash->state_size);
-            /* 把一号结构体换到二号结构体. */
-            BSP_QSPI_Write((uint8_t *)&WL_Flash->state, WL_Flash->addr_state2, sizeof(wl_state_t));
-            /* 把第一结构体内容放到第二结构体里面去. */
-            for (size_t i = 0; i < ((WL_Flash->cfg.full_mem_size / WL_Flash->cfg.sector_size) * WL_Flash->cfg.wr_size); i++)
-            {
-                uint8_t pos_bits = 0;
-                /* 从1号开始读,然后如果有数据,就写到2号,当然不判断0xFF也行,但是浪费编程时间啊. */
-                BSP_QSPI_Read(&pos_bits, WL_Flash->addr_state1 + sizeof(wl_state_t) + i, 1);
-                if (pos_bits != 0xff)
-                {
-                    /* 从1号有数据,要写到2号的,所以开始写了. */
-                    BSP_QSPI_Write(&pos_bits, WL_Flash->addr_state2 + sizeof(wl_state_t) + i, 1);
-                }
-            }
-            /* 读取,以便后续比较. */
-            BSP_QSPI_Read((uint8_t *)&WL_Flash->state, WL_Flash->addr_state2, sizeof(wl_state_t));
+            WL_Flash_writeState(WL_Flash, WL_Flash->addr_state2, WL_Flash_countPos(WL_Flash, WL_Flash->addr_state1));
         }
         else    /* CRC1是错的,证明第一个结构体是有问题的,那么就是第二个结构体无问题. */
         {
-            /* 擦掉第一结构体,因为第一结构体有问题. */
-            WL_Flash_Erase_RAW(WL_Flash, WL_Flash->addr_state1, WL_Flash->state_size);
-            /* 把第二结构体内容写进去,state_copy在上面判断前已经提起到了. */
-            BSP_QSPI_Write((uint8_t *)state_copy, WL_Flash->addr_state1, sizeof(wl_state_t));
-            /* 把第二结构体内容放到第一结构体里面去. */
-            for (size_t i = 0; i < ((WL_Flash->cfg.full_mem_size / WL_Flash->cfg.sector_size) * WL_Flash->cfg.wr_size); i++)
-            {
-                uint8_t pos_bits = 0;
-                /* 从2号开始读,然后如果有数据,就写到1号,当然不判断0xFF也行,但是浪费编程时间啊. */
-                BSP_QSPI_Read(&pos_bits, WL_Flash->addr_state2 + sizeof(wl_state_t) + i, 1);
-                if (pos_bits != 0xff)
-                {
-                    /* 从2号有数据,要写到1号的,所以开始写了. */
-                    BSP_QSPI_Write(&pos_bits, WL_Flash->addr_state1 + sizeof(wl_state_t) + i, 1);
-                }
-            }
-            /* 读取,以便后续比较. */
-            BSP_QSPI_Read((uint8_t *)&WL_Flash->state, WL_Flash->addr_state1, sizeof(wl_state_t));
-            /* 移动pos坐标,因为第一个有问题,当做是储存芯片被重初始化(坐标). */
-            WL_Flash->state.pos = WL_Flash->state.max_pos - 1;
+            WL_Flash->state = *state_copy;
+            WL_Flash->state_gen++;
+            WL_Flash_writeState(WL_Flash, WL_Flash->addr_state1, WL_Flash_countPos(WL_Flash, WL_Flash->addr_state2));
         }
+        /* 两份已经一样了,恢复写指针. */
+        WL_Flash_recoverPos(WL_Flash);
         /* 判断下配置版本对不对,不对就要更新配置版本了. */
         if (WL_Flash->state.version != WL_Flash->cfg.version)
         {
@@ -376,6 +1889,77 @@ void WL_Flash_Config(wl_flash_t *WL_Flash)
             WL_Flash_initSections(WL_Flash);
         }
     }
+    /* 上次WL_Flash_Program合并到一半掉电的话,接着做完. */
+    WL_Flash_rmwRecover(WL_Flash);
+    return 1;
+}
+
+/**
+  * @brief  格式化整个磨损平衡区域,擦掉所有数据后重新写state和cfg.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经WL_Flash_Config过).
+  * @param  progress: 进度回调,不需要可以传NULL.
+  * @note   区域就是整片Flash的时候用整片擦除,否则按擦除规划用最大的擦除指令.
+  */
+void WL_Flash_Format(wl_flash_t *WL_Flash, wl_progress_cb_t progress)
+{
+    WL_TRACE(WL_TRACE_WL_FORMAT, 0, WL_Flash->cfg.full_mem_size);
+    const wl_flash_ops_t *ops = WL_OPS(WL_Flash);
+
+    if ((ops->erase_chip != NULL) && (WL_Flash->cfg.start_addr == 0) && (WL_Flash->cfg.full_mem_size >= WL_Flash->chip_size))
+    {
+        /* 整片擦除,只是发出指令,然后自己查询状态. */
+        TickType_t start_tick = xTaskGetTickCount();
+        WL_Flash_raFinish(WL_Flash);
+        ops->erase_chip(WL_Flash->drv);
+        while (ops->get_status(WL_Flash->drv) == WL_FLASH_DRV_BUSY)
+        {
+            /* 整片擦除要几分钟,没法知道真实进度,就按典型时间估算,最多报到99. */
+            uint32_t elapsed = (xTaskGetTickCount() - start_tick) * portTICK_PERIOD_MS;
+            if ((progress != NULL) && (ops->chip_erase_time >= 100))
+            {
+                progress((elapsed >= ops->chip_erase_time) ? 99 : (elapsed / (ops->chip_erase_time / 100)));
+            }
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        WL_Flash_wearCount(WL_Flash, WL_Flash->cfg.start_addr, WL_Flash->cfg.full_mem_size);
+        WL_STAT(WL_Flash, flash_erase, WL_Flash->chip_size);
+        WL_STAT(WL_Flash, flash_erase_ops, 1);
+    }
+    else
+    {
+        /* 只是一部分,那就按擦除规划一块一块擦. */
+        uint32_t address = WL_Flash->cfg.start_addr;
+        uint32_t end_address = WL_Flash->cfg.start_addr + WL_Flash->cfg.full_mem_size;
+        while (address < end_address)
+        {
+            uint32_t erase_size = WL_Flash_Erase_Plan(WL_Flash, address, end_address - address);
+            WL_Flash_Erase_Block(WL_Flash, address, erase_size);
+            address += erase_size;
+            if (progress != NULL)
+            {
+                progress((uint32_t)((uint64_t)(address - WL_Flash->cfg.start_addr) * 99 / WL_Flash->cfg.full_mem_size));
+            }
+        }
+    }
+
+    /* 数据区已经是全新的了,重新写state和cfg. */
+    WL_Flash_cacheInvalidate(WL_Flash, 0, WL_Flash->flash_size);
+    WL_Flash_raInvalidate(WL_Flash, 0, WL_Flash->flash_size);
+    WL_Flash->wb_lo = WL_Flash->wb_hi = 0;
+    WL_Flash_initSections(WL_Flash);
+    /* 坐标全部是0xFF,恢复出来就是0. */
+    WL_Flash_recoverPos(WL_Flash);
+
+    /* 擦除次数区也擦掉了,RAM里的次数马上写回去. */
+    WL_Flash_FlushWear(WL_Flash);
+    /* 丢弃位图区也擦掉了,重新读一遍就是全部没丢弃. */
+    WL_Flash_trimLoad(WL_Flash);
+
+    if (progress != NULL)
+    {
+        progress(100);
+    }
+    WL_TRACE(WL_TRACE_WL_FORMAT | WL_TRACE_DONE, 0, WL_Flash->cfg.full_mem_size);
 }
 
 /**
@@ -387,19 +1971,37 @@ void WL_Flash_Config(wl_flash_t *WL_Flash)
   */
 void WL_Flash_Write(wl_flash_t *WL_Flash, uint32_t dest_addr, const uint8_t *src, size_t size)
 {
-    /* 看看要读取的有多少个Page.如果size不足一个Page,那么count是0,下面的for被短路了. */
-    uint32_t count = (size - 1) / WL_Flash->cfg.page_size;
-    for (uint32_t i = 0; i < count; i++)
+    WL_PROF_BEGIN(t);
+    WL_TRACE(WL_TRACE_WL_WRITE, dest_addr, size);
+    WL_STAT(WL_Flash, user_write, size);
+    WL_Flash_Poll(WL_Flash);
+    /* 写到已丢弃的sector要先真的擦掉. */
+    if ((WL_Flash->trim_count != 0) && (size != 0))
     {
-        /* 要计算出虚拟地址,因为VA -> PA转换,才能保证每次写的VA都不会一直磨一个块,而用户不用管VA要不要变. */
-        uint32_t virt_addr = WL_Flash_calcAddr(WL_Flash, dest_addr + i * WL_Flash->cfg.page_size);
-        /* 真正要写入的是VA地址,每次写一个SubSector,然后下次继续轮奸. */
-        BSP_QSPI_Write(&((uint8_t *)src)[i * WL_Flash->cfg.page_size], WL_Flash->cfg.start_addr + virt_addr, WL_Flash->cfg.page_size);
+        WL_Flash_trimRevive(WL_Flash, dest_addr, size);
     }
-    /* 要计算出虚拟地址,因为VA -> PA转换,才能保证每次写的VA都不会一直磨一个块,而用户不用管VA要不要变. */
-    uint32_t virt_addr_last = WL_Flash_calcAddr(WL_Flash, dest_addr + count * WL_Flash->cfg.page_size);
-    /* 要写的大小,这里分两种情况,如果count为0,那么size就是size,因为后面没有减少任何东西,如果count不为0,就要减掉上面写的数据量,传剩下部分. */
-    BSP_QSPI_Write(&((uint8_t *)src)[count * WL_Flash->cfg.page_size], WL_Flash->cfg.start_addr + virt_addr_last, size - count * WL_Flash->cfg.page_size);
+    /* 不跨编程页的小块写先攒起来,Flash没变,读缓存也不用作废. */
+    if (WL_Flash_wbWrite(WL_Flash, dest_addr, src, size))
+    {
+        WL_PROF_END(WL_PROF_WL_WRITE, t);
+        WL_TRACE(WL_TRACE_WL_WRITE | WL_TRACE_DONE, dest_addr, size);
+        return;
+    }
+    /* NOR写入只能1变0,写完的内容不一定是src,直接作废,下次读再从Flash取. */
+    WL_Flash_cacheInvalidate(WL_Flash, dest_addr, size);
+    WL_Flash_raInvalidate(WL_Flash, dest_addr, size);
+    for (uint32_t done = 0; done < size;)
+    {
+        /* 要计算出虚拟地址,因为VA -> PA转换,才能保证每次写的VA都不会一直磨一个块,而用户不用管VA要不要变.
+           物理上连续的一段一次写完,不用按Page拆,也不会把跨Page的写入写到错的地方. */
+        uint32_t run;
+        uint32_t virt_addr = WL_Flash_calcAddr(WL_Flash, dest_addr + done, &run);
+        uint32_t len = (run < size - done) ? run : (uint32_t)(size - done);
+        WL_Flash_Program_RAW(WL_Flash, WL_Flash->cfg.start_addr + virt_addr, &src[done], len);
+        done += len;
+    }
+    WL_PROF_END(WL_PROF_WL_WRITE, t);
+    WL_TRACE(WL_TRACE_WL_WRITE | WL_TRACE_DONE, dest_addr, size);
 }
 
 /**
@@ -411,17 +2013,329 @@ void WL_Flash_Write(wl_flash_t *WL_Flash, uint32_t dest_addr, const uint8_t *src
   */
 void WL_Flash_Read(wl_flash_t *WL_Flash, uint32_t src_addr, uint8_t *dest, size_t size)
 {
-    uint32_t count = (size - 1) / WL_Flash->cfg.page_size;
-    for (uint32_t i = 0; i < count; i++)
+    WL_PROF_BEGIN(t);
+    WL_TRACE(WL_TRACE_WL_READ, src_addr, size);
+    WL_STAT(WL_Flash, user_read, size);
+    WL_Flash_Poll(WL_Flash);
+    /* 碰到已丢弃的sector就不走预读和缓存,直接按段填0xFF或者读Flash. */
+    uint32_t len = (uint32_t)size;
+    uint8_t direct = (WL_Flash->trim_count != 0) && (size != 0) && (WL_Flash_trimRun(WL_Flash, src_addr, &len) || (len < size));
+    /* 顺序读的流从预读缓冲拿,拿完接着预读下一块,用户处理数据的时候DMA在后台读. */
+    if (!direct && (WL_Flash->ra != NULL) && WL_Flash_raRead(WL_Flash, src_addr, dest, size))
+    {
+        WL_Flash_wbMerge(WL_Flash, src_addr, dest, size);
+        WL_Flash_raKick(WL_Flash);
+        WL_PROF_END(WL_PROF_WL_READ, t);
+        WL_TRACE(WL_TRACE_WL_READ | WL_TRACE_DONE, src_addr, size);
+        return;
+    }
+    /* 小块读走缓存,整Page以上的大块读直接读Flash,不要把缓存冲掉. */
+    if (!direct && (WL_Flash->cache_tag != NULL) && (size < WL_Flash->cfg.page_size))
+    {
+        WL_Flash_cacheRead(WL_Flash, src_addr, dest, size);
+        WL_Flash_wbMerge(WL_Flash, src_addr, dest, size);
+        WL_Flash_raKick(WL_Flash);
+        WL_PROF_END(WL_PROF_WL_READ, t);
+        WL_TRACE(WL_TRACE_WL_READ | WL_TRACE_DONE, src_addr, size);
+        return;
+    }
+    WL_Flash_readDirect(WL_Flash, src_addr, dest, size);
+    WL_Flash_raKick(WL_Flash);
+    WL_PROF_END(WL_PROF_WL_READ, t);
+    WL_TRACE(WL_TRACE_WL_READ | WL_TRACE_DONE, src_addr, size);
+}
+
+/**
+  * @brief  比较后写入,不用先擦:和现在的内容一样的部分不写,只要1变0的直接写,有0变1的sector才擦掉重写.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  dest_addr: 目标地址.
+  * @param  src: 需要写入的内容.
+  * @param  size: 需要写的长度(单位:Byte).
+  * @retval 1: 成功, 0: 有sector要擦但只改了一部分,申请不到sector大小的内存来合并,这个sector没有改.
+  * @note   定期保存配置这种大部分时候内容不变的场合用.擦掉重写的时候掉电,这个sector的内容会丢.
+  */
+uint8_t WL_Flash_Update(wl_flash_t *WL_Flash, uint32_t dest_addr, const uint8_t *src, size_t size)
+{
+    uint8_t result = 1;
+
+    WL_TRACE(WL_TRACE_WL_UPDATE, dest_addr, size);
+    WL_Flash_Poll(WL_Flash);
+    for (uint32_t done = 0; done < size;)
+    {
+        uint32_t address = dest_addr + done;
+        uint32_t len = WL_Flash->cfg.sector_size - address % WL_Flash->cfg.sector_size;
+        uint32_t first = 0, last = 0;
+        uint8_t need;
+
+        len = (len < size - done) ? len : (uint32_t)(size - done);
+        need = WL_Flash_checkRange(WL_Flash, address, &src[done], len, &first, &last);
+        if (need == WL_FLASH_UPD_SAME)
+        {
+            WL_STAT(WL_Flash, update_skipped, len);
+        }
+        else if (need == WL_FLASH_UPD_PROGRAM)
+        {
+            /* 从第一个不一样的字节写到最后一个,中间一样的也一起写,NOR写入是1变0,写一样的内容不会改变什么. */
+            WL_Flash_Write(WL_Flash, address + first, &src[done + first], last - first);
+            WL_STAT(WL_Flash, update_skipped, len - (last - first));
+            WL_STAT(WL_Flash, update_in_place, 1);
+        }
+        else if (!WL_Flash_rewriteSector(WL_Flash, address, &src[done], len))
+        {
+            result = 0;
+        }
+        done += len;
+    }
+    WL_TRACE(WL_TRACE_WL_UPDATE | WL_TRACE_DONE, dest_addr, size);
+    return result;
+}
+
+/**
+  * @brief  写到任意位置,不用先擦,要擦的Page在内部合并,不需要Page大小的内存.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  dest_addr: 目标地址.
+  * @param  src: 需要写入的内容.
+  * @param  size: 需要写的长度(单位:Byte).
+  * @retval 1: 成功, 0: cfg.wr_size小于8,放不下合并日志,要擦的Page没有改.
+  * @note   一样的和只有1变0的部分跟WL_Flash_Update一样处理.要擦的Page先挪一次dummy,旧内容拼上新内容
+  *         按temp_buff_size一块一块复制到擦好的dummy,记日志,擦掉原来的Page再复制回来.要擦三次,比先擦再写慢,
+  *         但是只用temp_buff和栈上WL_FLASH_CMP_CHUNK字节,中途掉电的话这个Page要么是旧的要么是新的.
+  */
+uint8_t WL_Flash_Program(wl_flash_t *WL_Flash, uint32_t dest_addr, const uint8_t *src, size_t size)
+{
+    uint8_t result = 1;
+
+    WL_TRACE(WL_TRACE_WL_PROGRAM, dest_addr, size);
+    WL_Flash_Poll(WL_Flash);
+    for (uint32_t done = 0; done < size;)
+    {
+        uint32_t address = dest_addr + done;
+        uint32_t base = address - address % WL_Flash->cfg.page_size;
+        uint32_t len = WL_Flash->cfg.page_size - (address - base);
+        uint32_t first = 0, last = 0;
+        uint8_t need;
+
+        len = (len < size - done) ? len : (uint32_t)(size - done);
+        need = WL_Flash_checkRange(WL_Flash, address, &src[done], len, &first, &last);
+        if (need == WL_FLASH_UPD_SAME)
+        {
+            WL_STAT(WL_Flash, update_skipped, len);
+        }
+        else if (need == WL_FLASH_UPD_PROGRAM)
+        {
+            WL_Flash_Write(WL_Flash, address + first, &src[done + first], last - first);
+            WL_STAT(WL_Flash, update_skipped, len - (last - first));
+            WL_STAT(WL_Flash, update_in_place, 1);
+        }
+        else if (WL_Flash->cfg.wr_size < WL_RMW_LOG)
+        {
+            result = 0;
+        }
+        else
+        {
+            WL_Flash_rmwPage(WL_Flash, base, address - base, address - base + len, &src[done]);
+        }
+        done += len;
+    }
+    WL_TRACE(WL_TRACE_WL_PROGRAM | WL_TRACE_DONE, dest_addr, size);
+    return result;
+}
+
+/**
+  * @brief  看看写入这些内容要不要擦,不写Flash.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  dest_addr: 目标地址.
+  * @param  src: 准备写入的内容.
+  * @param  size: 长度(单位:Byte).
+  * @retval WL_FLASH_UPD_SAME: 一样; WL_FLASH_UPD_PROGRAM: 只有1变0,WL_Flash_Update会直接写;
+  *         WL_FLASH_UPD_ERASE: 有0变1,WL_Flash_Update会擦掉重写.
+  * @note   计数器,位图,只追加的标志字每次只清几位,擦一次能改很多次.位图用完要重置的时候会擦,
+  *         可以先用这个看看,留到空闲的时候再WL_Flash_Update.
+  */
+uint8_t WL_Flash_Check(wl_flash_t *WL_Flash, uint32_t dest_addr, const uint8_t *src, size_t size)
+{
+    uint32_t first, last;
+
+    WL_Flash_Poll(WL_Flash);
+    return WL_Flash_checkRange(WL_Flash, dest_addr, src, size, &first, &last);
+}
+
+/**
+  * @brief  告诉磨损平衡这段数据不要了(TRIM),以后挪dummy时不用复制,读出来是0xFF.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  start_address: 起始地址.
+  * @param  size: 长度.
+  * @retval 1: 成功, 0: 没有丢弃位图(cfg.trim_sectors为0或者太小).
+  * @note   只标记整个落在范围里的sector,头尾不满一个sector的部分不管.
+  *         已丢弃的sector当作擦过的用,再写的时候会先擦掉;WL_Flash_Erase_Range也会把它变回能用.
+  *         标记写在Flash上,掉电重启以后还在.
+  */
+uint8_t WL_Flash_Discard(wl_flash_t *WL_Flash, uint32_t start_address, uint32_t size)
+{
+    if (WL_Flash->trim_map == NULL)
+    {
+        return 0;
+    }
+    WL_TRACE(WL_TRACE_WL_DISCARD, start_address, size);
+    /* 向内取整到sector. */
+    uint32_t first = (start_address + WL_Flash->cfg.sector_size - 1) / WL_Flash->cfg.sector_size;
+    uint32_t end = (start_address + size) / WL_Flash->cfg.sector_size;
+    end = (end > WL_Flash->trim_blocks) ? WL_Flash->trim_blocks : end;
+    WL_Flash_Poll(WL_Flash);
+    if (first < end)
+    {
+        WL_Flash_cacheInvalidate(WL_Flash, first * WL_Flash->cfg.sector_size, (end - first) * WL_Flash->cfg.sector_size);
+        WL_Flash_raInvalidate(WL_Flash, first * WL_Flash->cfg.sector_size, (end - first) * WL_Flash->cfg.sector_size);
+        /* 写缓冲里还没写回的数据也不要了. */
+        if ((WL_Flash->wb_lo != WL_Flash->wb_hi) && (WL_Flash->wb_addr / WL_Flash->cfg.sector_size >= first) &&
+                (WL_Flash->wb_addr / WL_Flash->cfg.sector_size < end))
+        {
+            WL_Flash->wb_lo = WL_Flash->wb_hi = 0;
+        }
+    }
+    for (uint32_t sector = first; sector < end; sector++)
+    {
+        if (!WL_TRIM_TEST(WL_Flash, sector))
+        {
+            WL_Flash_trimMark(WL_Flash, sector, 1);
+            WL_STAT(WL_Flash, discards, 1);
+        }
+    }
+    WL_TRACE(WL_TRACE_WL_DISCARD | WL_TRACE_DONE, start_address, size);
+    return 1;
+}
+
+/**
+  * @brief  擦除次数统计,只用RAM里的次数,不扫描数据区.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @param  stats: 统计结果.
+  * @retval 1: 成功, 0: 没有开启统计(cfg.wear_sectors为0或者太小).
+  */
+uint8_t WL_Flash_GetWearStats(wl_flash_t *WL_Flash, wl_wear_stats_t *stats)
+{
+    if (WL_Flash->wear_count == NULL)
+    {
+        return 0;
+    }
+    memset(stats, 0, sizeof(wl_wear_stats_t));
+    stats->blocks = WL_Flash->wear_blocks;
+    stats->min = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < WL_Flash->wear_blocks; i++)
+    {
+        uint32_t count = WL_Flash->wear_count[i];
+        stats->min = (count < stats->min) ? count : stats->min;
+        stats->max = (count > stats->max) ? count : stats->max;
+        stats->total += count;
+    }
+    stats->mean = (uint32_t)(stats->total / stats->blocks);
+    /* 直方图从min到max平均分. */
+    stats->hist_step = (stats->max - stats->min) / WL_FLASH_WEAR_BUCKETS + 1;
+    for (uint32_t i = 0; i < WL_Flash->wear_blocks; i++)
+    {
+        stats->hist[(WL_Flash->wear_count[i] - stats->min) / stats->hist_step]++;
+    }
+    stats->life_used = (uint32_t)((uint64_t)stats->max * 1000 / WL_FLASH_ENDURANCE);
+    /* 擦除一直按现在的比例分配的话,最多的那个到寿命时总共能擦total * ENDURANCE / max次. */
+    if (stats->max == 0)
+    {
+        stats->remaining = (uint64_t)stats->blocks * WL_FLASH_ENDURANCE;
+    }
+    else if (stats->max < WL_FLASH_ENDURANCE)
+    {
+        stats->remaining = stats->total * (WL_FLASH_ENDURANCE - stats->max) / stats->max;
+    }
+    return 1;
+}
+
+/**
+  * @brief  把RAM里的擦除次数写回Flash,关机前可以调用一次,平时攒够WL_FLASH_WEAR_FLUSH次会自动写.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @note   轮流写下一份,先擦(这次擦除也记进去),写次数,最后写头部,中途掉电上一份还在.
+  */
+void WL_Flash_FlushWear(wl_flash_t *WL_Flash)
+{
+    wl_wear_hdr_t hdr;
+    uint32_t addr;
+
+    if ((WL_Flash->wear_count == NULL) || (WL_Flash->wear_dirty == 0))
+    {
+        return;
+    }
+    WL_Flash->wear_slot = (WL_Flash->wear_slot + 1) % (WL_Flash->wear_size / WL_Flash->wear_snap_size);
+    addr = WL_Flash->addr_wear + WL_Flash->wear_slot * WL_Flash->wear_snap_size;
+    WL_Flash_Erase_RAW(WL_Flash, addr, WL_Flash->wear_snap_size);
+
+    hdr.magic = WL_FLASH_WEAR_MAGIC;
+    hdr.seq = ++WL_Flash->wear_seq;
+    hdr.blocks = WL_Flash->wear_blocks;
+    hdr.crc = Calculate_CRC((uint8_t *)&hdr, sizeof(wl_wear_hdr_t) - sizeof(uint32_t)) ^
+              Calculate_CRC((uint8_t *)WL_Flash->wear_count, WL_Flash->wear_blocks * sizeof(uint32_t));
+    WL_Flash_Program_RAW(WL_Flash, addr + sizeof(wl_wear_hdr_t), (uint8_t *)WL_Flash->wear_count, WL_Flash->wear_blocks * sizeof(uint32_t));
+    WL_Flash_Program_RAW(WL_Flash, addr, (uint8_t *)&hdr, sizeof(wl_wear_hdr_t));
+    WL_Flash->wear_dirty = 0;
+}
+
+/**
+  * @brief  读出运行统计,可以顺便清零,比如每小时读一次算这段时间的写放大.
+  * @param  WL_FLash: 磨损平衡结构体.
+  * @param  stats: 统计结果.
+  * @param  reset: 不为0时读完清零.
+  * @retval 1: 成功, 0: 定义了WL_FLASH_NO_STATS,结果全是0.
+  * @note   不加锁,要和读写擦在同一个任务里调用.
+  */
+uint8_t WL_Flash_GetStats(wl_flash_t *WL_Flash, wl_flash_stats_t *stats, uint8_t reset)
+{
+#ifdef WL_FLASH_NO_STATS
+    (void)WL_Flash;
+    (void)reset;
+    memset(stats, 0, sizeof(wl_flash_stats_t));
+    return 0;
+#else
+    *stats = WL_Flash->stats;
+    if (reset)
     {
-        /* 要计算出虚拟地址,因为地址已经是乱的了. */
-        uint32_t virt_addr = WL_Flash_calcAddr(WL_Flash, src_addr + i * WL_Flash->cfg.page_size);
-        /* 真正要读出的是VA地址,每次读一个SubSector,然后下次继续轮奸. */
-        BSP_QSPI_Read(&((uint8_t *)dest)[i * WL_Flash->cfg.page_size], WL_Flash->cfg.start_addr + virt_addr, WL_Flash->cfg.page_size);
+        memset(&WL_Flash->stats, 0, sizeof(wl_flash_stats_t));
     }
-    /* 要计算出虚拟地址,因为地址已经是乱的了. */
-    uint32_t virt_addr_last = WL_Flash_calcAddr(WL_Flash, src_addr + count * WL_Flash->cfg.page_size);
-    /* 要读的大小,这里分两种情况,如果count为0,那么size就是size,因为后面没有减少任何东西,如果count不为0,就要减掉上面写的数据量,读剩下部分. */
-    BSP_QSPI_Read(&((uint8_t *)dest)[count * WL_Flash->cfg.page_size], WL_Flash->cfg.start_addr + virt_addr_last, size - count * WL_Flash->cfg.page_size);
+    return 1;
+#endif
 }
 
+/**
+  * @brief  把写缓冲里攒下来的数据写回Flash,关机前或者要保证数据落盘时调用.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  * @note   只写实际写过的那一段,中间没写过的字节是0xFF,写进去不改变Flash内容.
+  */
+void WL_Flash_Sync(wl_flash_t *WL_Flash)
+{
+    uint32_t address = WL_Flash->wb_addr + WL_Flash->wb_lo;
+    uint32_t size = WL_Flash->wb_hi - WL_Flash->wb_lo;
+
+    if (size == 0)
+    {
+        return;
+    }
+    WL_TRACE(WL_TRACE_WL_SYNC, address, size);
+    /* 先清空再写,Program_RAW里不会再回到这里. */
+    WL_Flash->wb_lo = WL_Flash->wb_hi = 0;
+    /* 窗口不跨Page,换算一次物理地址就行.挪过dummy也没关系,按现在的位置写. */
+    WL_Flash_Program_RAW(WL_Flash, WL_Flash->cfg.start_addr + WL_Flash_calcAddr(WL_Flash, address, NULL), WL_Flash->wb_data + (address - WL_Flash->wb_addr), size);
+    WL_Flash_cacheInvalidate(WL_Flash, address, size);
+    WL_Flash_raInvalidate(WL_Flash, address, size);
+    WL_STAT(WL_Flash, wb_flushes, 1);
+    WL_TRACE(WL_TRACE_WL_SYNC | WL_TRACE_DONE, address, size);
+}
+
+/**
+  * @brief  写缓冲攒的时间超过wb_timeout就写回,预读的上一块读完了就发下一块.每次WL_Flash_xxx都会检查,
+  *         长时间不调用WL_Flash_xxx的话,在同一个任务里定时调用这个.
+  * @param  WL_FLash: 磨损平衡结构体(必须已经被初始化).
+  */
+void WL_Flash_Poll(wl_flash_t *WL_Flash)
+{
+    if ((WL_Flash->wb_lo != WL_Flash->wb_hi) && (WL_Flash->wb_timeout != 0) &&
+            ((TickType_t)(xTaskGetTickCount() - WL_Flash->wb_since) >= WL_Flash->wb_timeout))
+    {
+        WL_Flash_Sync(WL_Flash);
+    }
+    WL_Flash_raKick(WL_Flash);
+}
@@ -0,0 +1,91 @@
+/**
+    描述: WL_Flash和Flash驱动各阶段的耗时直方图,见WL_Prof.h.
+    文件: WL_Prof.c
+    注意: 导出可以用WL_Prof_Dump,也可以在调试器里把WL_Prof_Buf整个存成文件.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include <string.h>
+#include "stm32l4xx.h" /* DWT,CoreDebug,SystemCoreClock */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "WL_Prof.h"
+
+wl_prof_buf_t WL_Prof_Buf;
+
+/**
+  * @brief  清空直方图,打开DWT周期计数器.
+  */
+void WL_Prof_Init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    memset(&WL_Prof_Buf, 0, sizeof(WL_Prof_Buf));
+    WL_Prof_Buf.magic = WL_PROF_MAGIC;
+    WL_Prof_Buf.version = WL_PROF_VERSION;
+    WL_Prof_Buf.phases = WL_PROF_PHASES;
+    WL_Prof_Buf.buckets = WL_PROF_BUCKETS;
+    WL_Prof_Buf.clock_hz = SystemCoreClock;
+}
+
+/**
+  * @brief  当前周期数,给WL_PROF_BEGIN/WL_PROF_END用.
+  */
+uint32_t WL_Prof_Now(void)
+{
+    return DWT->CYCCNT;
+}
+
+/**
+  * @brief  记一次耗时.
+  * @param  phase: WL_PROF_xxx.
+  * @param  cycles: 周期数.
+  */
+void WL_Prof_Add(uint8_t phase, uint32_t cycles)
+{
+    wl_prof_hist_t *hist = &WL_Prof_Buf.hist[phase];
+    uint32_t bucket = 0;
+
+    /* 最高位的位置就是桶号. */
+    while ((cycles >> bucket) > 1)
+    {
+        bucket++;
+    }
+    taskENTER_CRITICAL();
+    hist->count++;
+    hist->total += cycles;
+    hist->max = (cycles > hist->max) ? cycles : hist->max;
+    hist->bucket[bucket]++;
+    taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  读出直方图,可以顺便清零,比如每次出问题之后读一份再重新统计.
+  * @param  out: 复制到这里.
+  * @param  reset: 不为0时读完清零.
+  */
+void WL_Prof_Get(wl_prof_buf_t *out, uint8_t reset)
+{
+    taskENTER_CRITICAL();
+    *out = WL_Prof_Buf;
+    if (reset)
+    {
+        memset(WL_Prof_Buf.hist, 0, sizeof(WL_Prof_Buf.hist));
+    }
+    taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  把整个WL_Prof_Buf输出,格式就是WL_Prof工具要的文件.
+  * @param  out: 输出函数,比如串口发送.
+  * @note   输出的时候暂停任务切换,不然会混进一半的更新.
+  */
+void WL_Prof_Dump(void (*out)(const uint8_t *data, uint32_t size))
+{
+    vTaskSuspendAll();
+    out((const uint8_t *)&WL_Prof_Buf, sizeof(WL_Prof_Buf));
+    xTaskResumeAll();
+}
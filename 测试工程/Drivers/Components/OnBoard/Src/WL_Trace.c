@@ -0,0 +1,173 @@
+/**
+    描述: WL_Flash和Flash驱动的访问记录,记到环形缓冲区里,导出后可以在PC上用WL_Replay回放.
+    文件: WL_Trace.c
+    注意: 缓冲区满了覆盖最旧的记录.导出可以用WL_Trace_Dump,也可以在调试器里把WL_Trace_Buf整个存成文件.
+
+    @author TaterLi
+    @version 2017/07/06
+*/
+
+#include "stm32l4xx.h" /* DWT,CoreDebug,SystemCoreClock */
+#include "WL_Trace.h"
+
+wl_trace_buf_t WL_Trace_Buf;
+
+/**
+  * @brief  初始化记录缓冲区,打开DWT周期计数器.
+  */
+void WL_Trace_Init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    WL_Trace_Buf.hdr.magic = WL_TRACE_MAGIC;
+    WL_Trace_Buf.hdr.version = WL_TRACE_VERSION;
+    WL_Trace_Buf.hdr.rec_size = sizeof(wl_trace_rec_t);
+    WL_Trace_Buf.hdr.capacity = WL_TRACE_SIZE;
+    WL_Trace_Buf.hdr.head = 0;
+    WL_Trace_Buf.hdr.total = 0;
+    WL_Trace_Buf.hdr.clock_hz = SystemCoreClock;
+}
+
+/**
+  * @brief  记一条.
+  * @param  op: WL_TRACE_xxx,结束时或上WL_TRACE_DONE.
+  * @param  addr: 地址.
+  * @param  size: 长度.
+  */
+void WL_Trace_Record(uint8_t op, uint32_t addr, uint32_t size)
+{
+    wl_trace_rec_t *rec;
+
+    taskENTER_CRITICAL();
+    rec = &WL_Trace_Buf.rec[WL_Trace_Buf.hdr.head];
+    rec->time = DWT->CYCCNT;
+    rec->addr = addr;
+    rec->size = size;
+    rec->op = op;
+    WL_Trace_Buf.hdr.head = (WL_Trace_Buf.hdr.head + 1 >= WL_TRACE_SIZE) ? 0 : (WL_Trace_Buf.hdr.head + 1);
+    WL_Trace_Buf.hdr.total++;
+    taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  把整个缓冲区(头部 + 所有记录)输出,格式就是WL_Replay要的文件.
+  * @param  out: 输出函数,比如串口发送.
+  * @note   输出的时候暂停记录,不然头部和记录会对不上.
+  */
+void WL_Trace_Dump(void (*out)(const uint8_t *data, uint32_t size))
+{
+    vTaskSuspendAll();
+    out((const uint8_t *)&WL_Trace_Buf, sizeof(WL_Trace_Buf));
+    xTaskResumeAll();
+}
+
+/* 下面是套在原来驱动外面的接口,读写擦前后各记一条(后台读也是),其他的直接转过去. */
+
+static void WL_Trace_Read(void *drv, uint32_t addr, uint8_t *dest, uint32_t size)
+{
+    wl_trace_drv_t *Trace = (wl_trace_drv_t *)drv;
+    WL_Trace_Record(WL_TRACE_FLASH_READ, addr, size);
+    Trace->inner_ops->read(Trace->inner_drv, addr, dest, size);
+    WL_Trace_Record(WL_TRACE_FLASH_READ | WL_TRACE_DONE, addr, size);
+}
+
+/* 后台读:发出去记开始,read_done第一次返回读完时记结束,中间查到没读完的不记. */
+static void WL_Trace_Read_Start(void *drv, uint32_t addr, uint8_t *dest, uint32_t size)
+{
+    wl_trace_drv_t *Trace = (wl_trace_drv_t *)drv;
+    WL_Trace_Record(WL_TRACE_FLASH_READ, addr, size);
+    Trace->read_addr = addr;
+    Trace->read_size = size;
+    Trace->read_busy = 1;
+    Trace->inner_ops->read_start(Trace->inner_drv, addr, dest, size);
+}
+
+static uint8_t WL_Trace_Read_Done(void *drv, uint8_t wait)
+{
+    wl_trace_drv_t *Trace = (wl_trace_drv_t *)drv;
+    uint8_t ret = Trace->inner_ops->read_done(Trace->inner_drv, wait);
+    if ((ret != WL_FLASH_DRV_BUSY) && Trace->read_busy)
+    {
+        Trace->read_busy = 0;
+        WL_Trace_Record(WL_TRACE_FLASH_READ | WL_TRACE_DONE, Trace->read_addr, Trace->read_size);
+    }
+    return ret;
+}
+
+static void WL_Trace_Program(void *drv, uint32_t addr, const uint8_t *src, uint32_t size)
+{
+    wl_trace_drv_t *Trace = (wl_trace_drv_t *)drv;
+    WL_Trace_Record(WL_TRACE_FLASH_PROGRAM, addr, size);
+    Trace->inner_ops->program(Trace->inner_drv, addr, src, size);
+    WL_Trace_Record(WL_TRACE_FLASH_PROGRAM | WL_TRACE_DONE, addr, size);
+}
+
+static void WL_Trace_Erase(void *drv, uint32_t addr, uint32_t size)
+{
+    wl_trace_drv_t *Trace = (wl_trace_drv_t *)drv;
+    WL_Trace_Record(WL_TRACE_FLASH_ERASE, addr, size);
+    Trace->inner_ops->erase(Trace->inner_drv, addr, size);
+    WL_Trace_Record(WL_TRACE_FLASH_ERASE | WL_TRACE_DONE, addr, size);
+}
+
+static void WL_Trace_Erase_Chip(void *drv)
+{
+    wl_trace_drv_t *Trace = (wl_trace_drv_t *)drv;
+    WL_Trace_Record(WL_TRACE_FLASH_CHIP, 0, 0);
+    Trace->inner_ops->erase_chip(Trace->inner_drv);
+    WL_Trace_Record(WL_TRACE_FLASH_CHIP | WL_TRACE_DONE, 0, 0);
+}
+
+static uint8_t WL_Trace_GetStatus(void *drv)
+{
+    wl_trace_drv_t *Trace = (wl_trace_drv_t *)drv;
+    return Trace->inner_ops->get_status(Trace->inner_drv);
+}
+
+static void WL_Trace_Suspend(void *drv)
+{
+    wl_trace_drv_t *Trace = (wl_trace_drv_t *)drv;
+    Trace->inner_ops->suspend(Trace->inner_drv);
+}
+
+static void WL_Trace_Resume(void *drv)
+{
+    wl_trace_drv_t *Trace = (wl_trace_drv_t *)drv;
+    Trace->inner_ops->resume(Trace->inner_drv);
+}
+
+static void WL_Trace_Info(void *drv, uint32_t *chip_size, uint32_t *erase_size)
+{
+    wl_trace_drv_t *Trace = (wl_trace_drv_t *)drv;
+    Trace->inner_ops->info(Trace->inner_drv, chip_size, erase_size);
+}
+
+/**
+  * @brief  把记录层套到wl_flash_t的驱动外面,要在WL_Flash_Config之前调用.
+  * @param  Trace: 记录层的数据,要一直有效(不能是局部变量).
+  * @param  WL_Flash: 磨损平衡结构体,ops和drv必须已经填好.
+  */
+void WL_Trace_Attach(wl_trace_drv_t *Trace, wl_flash_t *WL_Flash)
+{
+    Trace->inner_ops = WL_Flash->ops;
+    Trace->inner_drv = WL_Flash->drv;
+    /* caps,chip_erase_time这些保持和原来驱动一样,不支持的接口还是NULL. */
+    Trace->ops = *WL_Flash->ops;
+    Trace->ops.read = WL_Trace_Read;
+    Trace->ops.program = WL_Trace_Program;
+    Trace->ops.erase = WL_Trace_Erase;
+    Trace->ops.erase_chip = (WL_Flash->ops->erase_chip != NULL) ? WL_Trace_Erase_Chip : NULL;
+    Trace->ops.get_status = WL_Trace_GetStatus;
+    Trace->ops.suspend = (WL_Flash->ops->suspend != NULL) ? WL_Trace_Suspend : NULL;
+    Trace->ops.resume = (WL_Flash->ops->resume != NULL) ? WL_Trace_Resume : NULL;
+    Trace->ops.info = WL_Trace_Info;
+    /* 后台读也要换掉,不然内层驱动拿到的drv是Trace. */
+    Trace->ops.read_start = (WL_Flash->ops->read_start != NULL) ? WL_Trace_Read_Start : NULL;
+    Trace->ops.read_done = (WL_Flash->ops->read_done != NULL) ? WL_Trace_Read_Done : NULL;
+    Trace->read_busy = 0;
+
+    WL_Flash->ops = &Trace->ops;
+    WL_Flash->drv = Trace;
+}
@@ -364,6 +364,8 @@ typedef struct
 
 void QSPI_MspInit(uint8_t FifoThreshold, uint8_t ClockPrescaler, uint32_t SampleShifting, uint8_t FlashSize, uint32_t ChipSelectHighTime, uint32_t ClockMode);
 
+void QSPI_SetFlashSize(uint8_t FlashSize);
+
 void     QSPI_Command      (QSPI_CommandTypeDef *cmd); 
 void     QSPI_Transmit     (uint8_t *pData);
 void		 QSPI_Receive			 (uint8_t *pData);
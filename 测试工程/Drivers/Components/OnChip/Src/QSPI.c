@@ -110,6 +110,19 @@ void QSPI_MspInit(uint8_t FifoThreshold, uint8_t ClockPrescaler, uint32_t Sample
     NVIC_EnableIRQ(QUADSPI_IRQn);
 }
 
+/**
+  * @brief Set the Flash Size.
+  * @param FlashSize: Specifies the Flash Size. FlashSize+1 is effectively the number of address bits required to address the flash memory.
+  * @retval None
+  */
+void QSPI_SetFlashSize(uint8_t FlashSize)
+{
+    /* Wait till BUSY flag reset */
+    while((__QSPI_GET_FLAG(QSPI_FLAG_BUSY)) != RESET) {}
+
+    MODIFY_REG(QUADSPI->DCR, QUADSPI_DCR_FSIZE, (FlashSize << POSITION_VAL(QUADSPI_DCR_FSIZE)));
+}
+
 /**
   * @brief Set the command configuration.
   * @param cmd : structure that contains the command configuration information
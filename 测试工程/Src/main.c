@@ -36,6 +36,15 @@
 #include "N25Q128.h"
 
 #include "WL_Flash.h"
+#ifdef WL_FLASH_TRACE
+#include "WL_Trace.h"
+#endif
+#ifdef WL_FLASH_PROF
+#include "WL_Prof.h" /* 调试器里把WL_Prof_Buf存成文件,PC上用wl_prof看各阶段耗时 */
+#endif
+#ifdef WL_FLASH_BENCH
+#include "WL_Bench.h"
+#endif
 
 /** System Clock Configuration
 */
@@ -92,23 +101,114 @@ void SystemClock_Config(void)
 }
 
 wl_flash_t MWL_Flash;
+#ifdef WL_FLASH_TRACE
+wl_trace_drv_t MWL_Trace; /* 调试器里把WL_Trace_Buf存成文件,就可以拿到PC上回放 */
+#endif
 uint8_t pBuf[12 * 1024];
 uint8_t aBuf[12 * 1024];
 
+/* MWL_Main的栈(字).跑WL_Bench时调用层数深(WL_Flash_Program里还有比较块),128字不够. */
+#ifdef WL_FLASH_BENCH
+#define MWL_MAIN_STACK 512
+#else
+#define MWL_MAIN_STACK 128
+#endif
+
+#ifdef WL_FLASH_BENCH
+wl_bench_t MWL_Bench;
+char MWL_Bench_Log[4096]; /* 测试结果(CSV),跑完在调试器里看这个数组 */
+uint32_t MWL_Bench_Len;
+
+/* DWT周期计数器换算成ns,32位80MHz下53秒回绕,这里每次调用都累加差值. */
+static uint64_t MWL_Bench_Now(void)
+{
+    static uint32_t last;
+    static uint64_t cycles;
+    uint32_t now = DWT->CYCCNT;
+
+    cycles += (uint32_t)(now - last);
+    last = now;
+    return cycles * 1000 / (SystemCoreClock / 1000000);
+}
+
+/* 流式读测试里模拟处理数据,空转,DMA照样在后台读. */
+static void MWL_Bench_Work(uint32_t us)
+{
+    uint32_t start = DWT->CYCCNT;
+
+    while ((uint32_t)(DWT->CYCCNT - start) < us * (SystemCoreClock / 1000000))
+    {
+    }
+}
+
+static void MWL_Bench_Out(const char *line)
+{
+    while ((*line != '\0') && (MWL_Bench_Len < sizeof(MWL_Bench_Log) - 2))
+    {
+        MWL_Bench_Log[MWL_Bench_Len++] = *line++;
+    }
+    /* 满了就不再加换行,最后一个字节留给'\0'. */
+    if (MWL_Bench_Len < sizeof(MWL_Bench_Log) - 1)
+    {
+        MWL_Bench_Log[MWL_Bench_Len++] = '\n';
+    }
+}
+#endif
+
 
 void MWL_Main(void)
 {
+    BSP_QSPI_Info_TypeDef info;
+
     BSP_QSPI_Init();
+    /* 容量和擦除大小按SFDP读到的来,换了Flash也不用改这里. */
+    BSP_QSPI_GetInfo(&info);
 
     MWL_Flash.cfg.start_addr = 0x00000000;
-    MWL_Flash.cfg.full_mem_size = 0x01000000;
-    MWL_Flash.cfg.page_size = 0x00001000;
-    MWL_Flash.cfg.sector_size = 0x00001000;
+    MWL_Flash.cfg.full_mem_size = info.FlashSize;
+    MWL_Flash.cfg.page_size = info.EraseSize[0];
+    MWL_Flash.cfg.sector_size = info.EraseSize[0];
     MWL_Flash.cfg.wr_size = 0x00000010;
     MWL_Flash.cfg.version = 0x00000001;
     MWL_Flash.cfg.temp_buff_size = 0x00000020;
+    /* 驱动接口,换芯片只要换这里. */
+    MWL_Flash.ops = &N25Q128_WL_Ops;
+    MWL_Flash.drv = NULL;
+#ifdef WL_FLASH_TRACE
+    WL_Trace_Init();
+    WL_Trace_Attach(&MWL_Trace, &MWL_Flash);
+#endif
+#ifdef WL_FLASH_PROF
+    WL_Prof_Init();
+#endif
+#ifdef WL_FLASH_BENCH
+    /* 挂载测试要把pos走一圈,整片16MB要擦四千多次,只拿前面1MB来测. */
+    MWL_Flash.cfg.full_mem_size = 0x00100000;
+    /* 留两个sector存丢弃位图,才有fs两行. */
+    MWL_Flash.cfg.trim_sectors = 2;
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    MWL_Bench.now_ns = MWL_Bench_Now;
+    MWL_Bench.out = MWL_Bench_Out;
+    MWL_Bench.work = MWL_Bench_Work;
+    MWL_Bench.work_us = 50;
+    MWL_Bench.buf = pBuf;
+    MWL_Bench.buf_size = sizeof(pBuf);
+    WL_Bench_Run(&MWL_Bench, &MWL_Flash);
+    for(;;)
+    {
+        vTaskDelay(1000);
+    }
+#endif
 
-    WL_Flash_Config(&MWL_Flash);
+    if (WL_Flash_Config(&MWL_Flash) == 0)
+    {
+        /* Flash上是迁移不了的旧格式state,不能写,停在这里.数据不要了的话改成WL_Flash_Format. */
+        for(;;)
+        {
+            vTaskDelay(1000);
+        }
+    }
 
 		for(uint16_t i = 0;i<5*1024;i++){
 			pBuf[i] = 0xFF & i;
@@ -131,7 +231,7 @@ int main(void)
     SystemClock_Config();
     LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_CRC);
 
-    xTaskCreate((TaskFunction_t)MWL_Main, "MWL_Main", 128, NULL, 0, NULL);
+    xTaskCreate((TaskFunction_t)MWL_Main, "MWL_Main", MWL_MAIN_STACK, NULL, 0, NULL);
     vTaskStartScheduler();
     while (1)
     {
@@ -17,12 +17,45 @@
 #include "semphr.h"
 #include "event_groups.h"
 
+#define WL_FLASH_ERASE_TYPES 4 /* 芯片最多支持的擦除大小种类 */
+
+/* 驱动能力标志. */
+#define WL_FLASH_CAP_ASYNC   0x01 /* 擦除只是发出指令就返回,完成要靠get_status查询 */
+#define WL_FLASH_CAP_SUSPEND 0x02 /* 支持擦除暂停/恢复 */
+#define WL_FLASH_CAP_READ_DMA 0x04 /* 有read_start/read_done,读可以放到后台(DMA),顺序预读要用 */
+
+/* 擦除次数统计,见WL_Flash_GetWearStats. */
+#ifndef WL_FLASH_WEAR_FLUSH
+#define WL_FLASH_WEAR_FLUSH 64 /* 攒够这么多次擦除才把擦除次数写回Flash,掉电最多丢这么多次 */
+#endif
+#ifndef WL_FLASH_ENDURANCE
+#define WL_FLASH_ENDURANCE 100000 /* 芯片擦写寿命,N25Q128A是10万次 */
+#endif
+#ifndef WL_FLASH_CMP_CHUNK
+#define WL_FLASH_CMP_CHUNK 128 /* WL_Flash_Update每次读出来比较的字节数,放在栈上,要是4的倍数 */
+#endif
+#define WL_FLASH_WEAR_BUCKETS 8 /* 擦除次数直方图的格数 */
+#define WL_FLASH_WEAR_MAGIC 0x52414557 /* "WEAR" */
+#define WL_FLASH_TRIM_MAGIC 0x4D495254 /* "TRIM" */
+
+/* get_status的返回值,和QSPI驱动的返回值一致. */
+#define WL_FLASH_DRV_OK        0x00
+#define WL_FLASH_DRV_ERROR     0x01
+#define WL_FLASH_DRV_BUSY      0x02
+#define WL_FLASH_DRV_SUSPENDED 0x08
+
+/* WL_Flash_Check的结果. */
+#define WL_FLASH_UPD_SAME    0 /* 和Flash里一样,不用写 */
+#define WL_FLASH_UPD_PROGRAM 1 /* 只有1变0,不用擦直接写 */
+#define WL_FLASH_UPD_ERASE   2 /* 有0变1,要擦 */
+
+/* state和cfg都是32位的字段,地址空间最大4GB,16位字段在65536个Page时就溢出了. */
 typedef struct WL_State_s
 {
-    uint16_t pos;           /*!< 当前的dummy_block的地址 */
-    uint16_t max_pos;       /*!< 最大用户可到达尺寸 */
-    uint16_t move_count;    /*!< 已经挪动的写入指针位置 */
-    uint16_t block_size;    /*!< 块大小 */
+    uint32_t pos;           /*!< 当前的dummy_block的地址 */
+    uint32_t max_pos;       /*!< 最大用户可到达尺寸 */
+    uint32_t move_count;    /*!< 已经挪动的写入指针位置 */
+    uint32_t block_size;    /*!< 块大小 */
     uint8_t version;       /*!< 配置版本 */
     uint32_t crc;           /*!< CRC 校验 */
 } wl_state_t;
@@ -31,15 +64,120 @@ typedef struct WL_Config_s
 {
     uint32_t start_addr;      /*!< 储存器的起始地址,如过是整片利用,就是0地址了. */
     uint32_t full_mem_size; /*!< 储存器的结束地址(尺寸),如果是整片,就是整片大小了. */
-    uint16_t page_size;     /*!< Page大小,另外说法是SubSector.*/
-    uint16_t sector_size;   /*!< 一次性擦除大小,通常都支持4K擦,就是page_size = sector_size,不支持时候这两个不相等. */
-    uint16_t wr_size;       /*!< 最小写入大小 */
+    uint32_t page_size;     /*!< Page大小,另外说法是SubSector.*/
+    uint32_t sector_size;   /*!< 一次性擦除大小,通常都支持4K擦,就是page_size = sector_size,不支持时候这两个不相等. */
+    uint32_t wr_size;       /*!< 最小写入大小 */
     uint8_t version;       /*!< 配置版本 */
-    uint16_t temp_buff_size;  /*!< Buffer的大小,与sector_size求余为0.*/
+    uint32_t temp_buff_size;  /*!< Buffer的大小,与sector_size求余为0.*/
+    uint32_t wear_sectors;  /*!< 存擦除次数的sector数,0表示不统计.改了数据区布局就变了,要同时改version. */
+    uint32_t trim_sectors;  /*!< 存丢弃位图的sector数,0表示不支持WL_Flash_Discard.同上,改了要同时改version. */
     uint32_t crc;           /*!< CRC 校验 */
 
 } wl_config_t;
 
+/* 擦除次数记录的头部,后面紧跟每个Page的擦除次数.头部最后写,写完才算数. */
+typedef struct WL_Wear_Hdr_s
+{
+    uint32_t magic; /* WL_FLASH_WEAR_MAGIC */
+    uint32_t seq; /* 第几次保存,恢复时用最大的那份 */
+    uint32_t blocks; /* 后面有多少个擦除次数 */
+    uint32_t crc; /* 头部前三个字段的CRC异或擦除次数的CRC */
+} wl_wear_hdr_t;
+
+/* 丢弃位图一份记录的头部,后面每个逻辑sector一个字节,0的位数是单数表示已丢弃,
+   每次改变状态只清一位,一个字节能改8次,用完了再整份重写到下一份.头部最后写,写完才算数. */
+typedef struct WL_Trim_Hdr_s
+{
+    uint32_t magic; /* WL_FLASH_TRIM_MAGIC */
+    uint32_t seq; /* 第几次整份重写,恢复时用最大的那份,从1开始 */
+    uint32_t sectors; /* 后面有多少个sector */
+    uint32_t crc; /* 头部前三个字段的CRC */
+} wl_trim_hdr_t;
+
+/* WL_Flash_GetWearStats的结果,全部按Page(cfg.page_size)统计,包括state,cfg和擦除次数区. */
+typedef struct WL_Wear_Stats_s
+{
+    uint32_t blocks; /* Page数 */
+    uint32_t min; /* 最少擦除次数 */
+    uint32_t max; /* 最多擦除次数 */
+    uint32_t mean; /* 平均擦除次数 */
+    uint64_t total; /* 擦除次数总和 */
+    uint32_t hist[WL_FLASH_WEAR_BUCKETS]; /* 直方图,第i格是min + i * hist_step到min + (i + 1) * hist_step - 1 */
+    uint32_t hist_step; /* 每格的宽度 */
+    uint32_t life_used; /* 最多的那个Page用掉的寿命,千分比 */
+    uint64_t remaining; /* 照现在的分布,最多的那个Page到寿命之前整个区域还能擦多少次(Page) */
+} wl_wear_stats_t;
+
+/* 运行统计,WL_Flash_GetStats读出.写放大 = flash_program / user_write,擦除放大 = flash_erase / user_erase.
+   一直开着,只是几个加法;定义WL_FLASH_NO_STATS可以整个去掉. */
+typedef struct WL_Flash_Stats_s
+{
+    uint64_t user_read; /* WL_Flash_Read读的字节数 */
+    uint64_t user_write; /* WL_Flash_Write写的字节数 */
+    uint64_t user_erase; /* WL_Flash_Erase_Range擦的字节数(按sector取整) */
+    uint64_t flash_read; /* 驱动读的字节数 */
+    uint64_t flash_program; /* 驱动写的字节数 */
+    uint64_t flash_erase; /* 驱动擦的字节数 */
+    uint64_t reloc; /* 挪动dummy时复制的字节数 */
+    uint64_t update_skipped; /* WL_Flash_Update和Flash里一样,不用写的字节数 */
+    uint64_t discard_skipped; /* 挪动dummy时因为已丢弃没有复制的字节数 */
+    uint64_t discard_read; /* 读到已丢弃的范围,没读Flash直接填0xFF的字节数 */
+    uint32_t user_erase_ops; /* WL_Flash_Erase_Range擦的sector数 */
+    uint32_t flash_program_ops; /* 驱动写入调用次数 */
+    uint32_t flash_erase_ops; /* 驱动擦除指令数 */
+    uint32_t wl_updates; /* dummy挪动次数 */
+    uint32_t state_rewrites; /* state整份擦掉重写的次数(每份算一次) */
+    uint32_t cache_hits; /* 读缓存命中的行数 */
+    uint32_t cache_misses; /* 读缓存没命中,从Flash读进来的行数 */
+    uint32_t wb_absorbed; /* 攒进写缓冲,没有马上写Flash的WL_Flash_Write次数 */
+    uint32_t wb_flushes; /* 写缓冲写回Flash的次数 */
+    uint32_t ra_fetches; /* 预读的块数 */
+    uint32_t ra_hits; /* 直接从预读缓冲拿到数据的WL_Flash_Read次数 */
+    uint32_t ra_stalls; /* 其中要等预读DMA读完的次数 */
+    uint32_t update_in_place; /* WL_Flash_Update只有1变0,没擦直接写的sector数 */
+    uint32_t update_erases; /* WL_Flash_Update有0变1,擦掉重写的sector数 */
+    uint32_t rmw_pages; /* WL_Flash_Program经过dummy合并的Page数 */
+    uint32_t discards; /* WL_Flash_Discard新标记为丢弃的sector数 */
+} wl_flash_stats_t;
+
+/* 格式化进度回调,percent是0~100. */
+typedef void (*wl_progress_cb_t)(uint32_t percent);
+
+/* Flash驱动接口,每个wl_flash_t带一份,这样一个固件里可以同时挂不同的芯片. */
+typedef struct WL_Flash_Ops_s
+{
+    void (*read)(void *drv, uint32_t addr, uint8_t *dest, uint32_t size); /* 物理读取 */
+    void (*program)(void *drv, uint32_t addr, const uint8_t *src, uint32_t size); /* 物理写入,需要自己处理跨Page */
+    void (*erase)(void *drv, uint32_t addr, uint32_t size); /* 物理擦除,size一定是info给出的某个擦除大小,并且对齐 */
+    void (*erase_chip)(void *drv); /* 整片擦除,只发出指令不等待,不支持就填NULL */
+    uint8_t (*get_status)(void *drv); /* 查询状态,返回WL_FLASH_DRV_xxx */
+    void (*suspend)(void *drv); /* 擦除暂停,没有WL_FLASH_CAP_SUSPEND可以填NULL */
+    void (*resume)(void *drv); /* 擦除恢复,同上 */
+    void (*info)(void *drv, uint32_t *chip_size, uint32_t *erase_size); /* 芯片大小和WL_FLASH_ERASE_TYPES个擦除大小(从小到大,0表示没有) */
+    uint32_t caps; /* WL_FLASH_CAP_xxx */
+    uint32_t chip_erase_time; /* 整片擦除典型时间(ms),只用来估算进度 */
+    void (*read_start)(void *drv, uint32_t addr, uint8_t *dest, uint32_t size); /* 发出读指令就返回(DMA),没有WL_FLASH_CAP_READ_DMA可以填NULL */
+    uint8_t (*read_done)(void *drv, uint8_t wait); /* 后台读完了返回WL_FLASH_DRV_OK,没完返回WL_FLASH_DRV_BUSY,wait不为0时等到读完 */
+} wl_flash_ops_t;
+
+/* 顺序预读的一个流,每个流有自己的环形缓冲,存连续的ra_depth块. */
+typedef struct WL_Flash_RA_s
+{
+    uint32_t next; /* 下一次顺序读应该从这里开始(逻辑地址) */
+    uint32_t base; /* 环里第一块的块号(逻辑地址 / ra_size) */
+    uint32_t head; /* 第一块在环里的位置 */
+    uint32_t count; /* 环里排上的块数,含正在DMA的那块 */
+    uint32_t ready; /* 前ready块已经读完,最多比count少1(只有一个DMA) */
+    uint32_t stamp; /* 最后一次用到的时间,换流时换最久没用的 */
+    uint8_t seq; /* 接着上次读完的地方读过,确认是顺序读,才开始预读 */
+} wl_flash_ra_t;
+
+/*
+ * 磨损平衡结构体.第一次WL_Flash_Config之前整个结构体必须是0(全局变量,或者先memset),
+ * 然后填cfg,ops,drv和要用的缓存/写缓冲/预读参数.缓冲区都是Config申请的,指针不是NULL就当作已经申请过.
+ * 重新挂载直接再调WL_Flash_Config,不要清零(清零会把缓冲区漏掉),参数改了缓冲区大小不够的会重新申请,
+ * 不用了的(比如wb_size改成0)会释放.
+ */
 typedef struct WL_Flash
 {
     wl_state_t state; /* 状态配置 */
@@ -51,14 +189,93 @@ typedef struct WL_Flash
 
     uint32_t flash_size; /* flash大小,这是用户能用的,已经扣减了冗余,配置部分. */
     uint32_t state_size; /* state结构大小. */
-    uint16_t cfg_size; /* cfg结构大小 */
+    uint32_t cfg_size; /* cfg结构大小 */
     uint8_t *temp_buff; /* 缓冲区指针 */
+    uint32_t temp_buff_alloc; /* temp_buff申请了多大,下面的xxx_alloc也一样,Config用来判断要不要重新申请 */
     uint32_t dummy_addr; /* dummy数据配置地址 */
+    uint32_t state_gen; /* pos/move_count每变一次加一,地址换算缓存靠它判断过期 */
+    uint32_t xlat_gen; /* 地址换算缓存是哪一代state算出来的 */
+    uint32_t xlat_lo; /* 地址换算缓存:[xlat_lo, xlat_hi)这段逻辑地址对应的物理地址是连续的 */
+    uint32_t xlat_hi;
+    uint32_t xlat_delta; /* 这一段里物理地址(不含start_addr) = 逻辑地址 + xlat_delta */
+    uint32_t erase_size[WL_FLASH_ERASE_TYPES]; /* 芯片支持的擦除大小,从小到大,0表示没有 */
+    uint32_t chip_size; /* 芯片大小 */
+
+    uint32_t *wear_count; /* 每个Page的擦除次数,cfg.wear_sectors为0或者放不下的时候是NULL */
+    uint32_t wear_alloc;
+    uint32_t wear_blocks; /* Page数 */
+    uint32_t addr_wear; /* 擦除次数区的地址,在state1前面 */
+    uint32_t wear_size; /* 擦除次数区大小 */
+    uint32_t wear_snap_size; /* 一份记录占的大小,擦除次数区分成几份轮流写 */
+    uint32_t wear_seq; /* 上次保存的序号 */
+    uint32_t wear_slot; /* 上次保存在第几份 */
+    uint32_t wear_dirty; /* 上次保存之后的擦除次数 */
+
+    /* 丢弃位图,cfg.trim_sectors为0或者放不下两份的时候trim_map是NULL. */
+    uint32_t *trim_map; /* 每个逻辑sector一位,1表示已丢弃 */
+    uint32_t trim_alloc;
+    uint32_t trim_count; /* 已丢弃的sector数,0的时候读写都不用查位图 */
+    uint32_t trim_blocks; /* 逻辑sector数 */
+    uint32_t addr_trim; /* 丢弃位图区的地址,在擦除次数区前面 */
+    uint32_t trim_size; /* 丢弃位图区大小 */
+    uint32_t trim_snap_size; /* 一份记录占的大小,轮流写 */
+    uint32_t trim_seq; /* 现在这份的序号,0表示Flash上还没有 */
+    uint32_t trim_slot; /* 现在这份在第几份 */
+
+    /* 读缓存,按逻辑地址缓存小块读取,下面三个在WL_Flash_Config之前填好,不填(0)就不用缓存. */
+    uint32_t cache_line_size; /* 每行字节数,要能整除page_size */
+    uint32_t cache_sets; /* 组数 */
+    uint32_t cache_ways; /* 每组行数,组内替换最久没用的 */
+    uint8_t *cache_data; /* 缓存的数据,组数 * 行数 * cache_line_size */
+    uint32_t *cache_tag; /* 每行缓存的逻辑行号 + 1,0表示空,没启用缓存时是NULL */
+    uint32_t *cache_stamp; /* 每行最后一次用到的时间 */
+    uint32_t cache_clock; /* 访问计数,给cache_stamp用 */
+    uint32_t cache_data_alloc;
+    uint32_t cache_tag_alloc; /* cache_tag和cache_stamp一样大 */
+
+    /* 写缓冲,把同一个编程页里的小块写入攒起来一次写,下面两个在WL_Flash_Config之前填好,wb_size不填(0)就不用. */
+    uint32_t wb_size; /* 缓冲大小,一般是芯片的编程页(N25Q128A是256),要能整除page_size */
+    TickType_t wb_timeout; /* 攒了这么多Tick还没写回就写回(在下一次调用WL_Flash_xxx或者WL_Flash_Poll时),0表示不按时间写回 */
+    uint8_t *wb_data; /* 攒下来的数据,没写过的字节是0xFF */
+    uint32_t wb_addr; /* 缓冲对应的逻辑地址,按wb_size对齐 */
+    uint32_t wb_lo; /* 写过的范围[wb_lo, wb_hi),相对wb_addr,wb_lo == wb_hi表示空 */
+    uint32_t wb_hi;
+    TickType_t wb_since; /* 第一次攒进来的时间 */
+    uint32_t wb_alloc;
+
+    /* 顺序预读,连续读同一段的时候用DMA在后台读下一块,下面三个在WL_Flash_Config之前填好,ra_depth不填(0)就不用,
+       驱动还要有WL_FLASH_CAP_READ_DMA. */
+    uint32_t ra_size; /* 每块大小,要能整除page_size */
+    uint32_t ra_depth; /* 每个流往前读几块 */
+    uint32_t ra_streams; /* 同时跟踪几个顺序读的流,0按1 */
+    wl_flash_ra_t *ra; /* 每个流的状态,没启用时是NULL */
+    uint8_t *ra_data; /* 环形缓冲,ra_streams * ra_depth * ra_size */
+    uint32_t ra_busy; /* 正在DMA的流号 + 1,0表示没有 */
+    uint32_t ra_clock; /* 访问计数,给stamp用 */
+    uint32_t ra_alloc;
+    uint32_t ra_data_alloc;
+
+#ifndef WL_FLASH_NO_STATS
+    wl_flash_stats_t stats; /* 运行统计 */
+#endif
+
+    const wl_flash_ops_t *ops; /* 驱动接口,WL_Flash_Config之前必须填好 */
+    void *drv; /* 驱动私有数据,原样传给ops */
 } wl_flash_t;
 
-void WL_Flash_Config(wl_flash_t *WL_Flash);
+uint8_t WL_Flash_Config(wl_flash_t *WL_Flash);
+void WL_Flash_Format(wl_flash_t *WL_Flash, wl_progress_cb_t progress);
 void WL_Flash_Erase_Range(wl_flash_t *WL_Flash, uint32_t start_address, uint32_t size);
 void WL_Flash_Write(wl_flash_t *WL_Flash, uint32_t dest_addr, const uint8_t *src, size_t size);
 void WL_Flash_Read(wl_flash_t *WL_Flash, uint32_t src_addr, uint8_t *dest, size_t size);
+uint8_t WL_Flash_Update(wl_flash_t *WL_Flash, uint32_t dest_addr, const uint8_t *src, size_t size);
+uint8_t WL_Flash_Check(wl_flash_t *WL_Flash, uint32_t dest_addr, const uint8_t *src, size_t size);
+uint8_t WL_Flash_Program(wl_flash_t *WL_Flash, uint32_t dest_addr, const uint8_t *src, size_t size);
+uint8_t WL_Flash_Discard(wl_flash_t *WL_Flash, uint32_t start_address, uint32_t size);
+uint8_t WL_Flash_GetWearStats(wl_flash_t *WL_Flash, wl_wear_stats_t *stats);
+void WL_Flash_FlushWear(wl_flash_t *WL_Flash);
+uint8_t WL_Flash_GetStats(wl_flash_t *WL_Flash, wl_flash_stats_t *stats, uint8_t reset);
+void WL_Flash_Sync(wl_flash_t *WL_Flash);
+void WL_Flash_Poll(wl_flash_t *WL_Flash);
 
 #endif